@@ -12,6 +12,10 @@
 #include <fc/io/raw.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <fc/io/varint.hpp>
+#include <fc/io/json.hpp>
+#include <deque>
+#include <mutex>
+#include <ostream>
 
 using namespace boost;
 
@@ -50,14 +54,135 @@ namespace eosio { namespace chain {
       );
    }
 
-   abi_serializer::abi_serializer( const abi_def& abi, const fc::microseconds& max_serialization_time ) {
+   template <typename T>
+   inline T unpack_from_stream(fc::datastream<const char*>& stream) {
+      T temp;
+      fc::raw::unpack( stream, temp );
+      return temp;
+   }
+
+   // true unless the built-in was replaced through add_specialized_unpack_pack
+   template <typename T>
+   bool is_default_unpack( const abi_serializer::unpack_function& f ) {
+      return f.target_type() == pack_unpack<T>().first.target_type();
+   }
+
+   namespace impl {
+      struct compiled_field {
+         type_name             name;        ///< field type as named by the ABI, without the binary extension marker
+         const compiled_type*  type = nullptr;
+         bool                  extension = false;
+         string                json_key;    ///< the field name as a JSON string followed by ':'
+      };
+
+      struct compiled_type {
+         enum kind_type : uint8_t { unknown_kind, built_in_kind, array_kind, optional_kind, variant_kind, struct_kind };
+         /// built-ins the JSON writer formats itself instead of going through an fc::variant
+         enum leaf_type : uint8_t { generic_leaf, int8_leaf, uint8_leaf, int16_leaf, uint16_leaf, int32_leaf, uint32_leaf,
+                                    int64_leaf, uint64_leaf, name_leaf };
+
+         kind_type             kind = unknown_kind;
+         type_name             name;        ///< resolved type name, the fundamental type for built-ins
+
+         const pair<abi_serializer::unpack_function, abi_serializer::pack_function>*  built_in = nullptr;
+         bool                  built_in_array = false;
+         bool                  built_in_optional = false;
+         leaf_type             leaf = generic_leaf;
+
+         type_name             element_name; ///< array and optional element type
+         const compiled_type*  element = nullptr;
+
+         map<type_name, struct_def>::const_iterator   struct_itr;
+         const compiled_type*                         base = nullptr;
+         vector<compiled_field>                       fields;
+         bool                                         duplicate_field_names = false; ///< including the fields of its bases
+
+         map<type_name, variant_def>::const_iterator  variant_itr;
+         vector<const compiled_type*>                 alternatives;
+      };
+
+      struct abi_plan {
+         std::deque<compiled_type>             types;     ///< a deque so that entries never move once they are linked
+         map<type_name, const compiled_type*>  by_name;   ///< keyed by the requested name, typedefs included
+         vector<compiled_type*>                unlinked;  ///< structs and variants whose members are not compiled yet
+         std::mutex                            mutex;     ///< plans grow lazily, also from const serializers shared between threads
+      };
+   }
+
+   abi_serializer::abi_serializer()
+   :plan( std::make_unique<impl::abi_plan>() )
+   {
+      configure_built_in_types();
+   }
+
+   abi_serializer::abi_serializer( const abi_def& abi, const fc::microseconds& max_serialization_time )
+   :plan( std::make_unique<impl::abi_plan>() )
+   {
       configure_built_in_types();
       set_abi(abi, max_serialization_time);
    }
 
+   // the plan points into the definitions it was compiled from, so a copy starts with an empty one
+   abi_serializer::abi_serializer( const abi_serializer& other )
+   :typedefs(other.typedefs)
+   ,structs(other.structs)
+   ,actions(other.actions)
+   ,tables(other.tables)
+   ,error_messages(other.error_messages)
+   ,variants(other.variants)
+   ,built_in_types(other.built_in_types)
+   ,plan( std::make_unique<impl::abi_plan>() )
+   {
+   }
+
+   abi_serializer::abi_serializer( abi_serializer&& other )
+   :typedefs(std::move(other.typedefs))
+   ,structs(std::move(other.structs))
+   ,actions(std::move(other.actions))
+   ,tables(std::move(other.tables))
+   ,error_messages(std::move(other.error_messages))
+   ,variants(std::move(other.variants))
+   ,built_in_types(std::move(other.built_in_types))
+   ,plan(std::move(other.plan))
+   {
+      other.plan = std::make_unique<impl::abi_plan>();
+   }
+
+   abi_serializer::~abi_serializer() = default;
+
+   abi_serializer& abi_serializer::operator=( const abi_serializer& other ) {
+      if( this != &other ) {
+         typedefs       = other.typedefs;
+         structs        = other.structs;
+         actions        = other.actions;
+         tables         = other.tables;
+         error_messages = other.error_messages;
+         variants       = other.variants;
+         built_in_types = other.built_in_types;
+         plan = std::make_unique<impl::abi_plan>();
+      }
+      return *this;
+   }
+
+   abi_serializer& abi_serializer::operator=( abi_serializer&& other ) {
+      if( this != &other ) {
+         typedefs       = std::move(other.typedefs);
+         structs        = std::move(other.structs);
+         actions        = std::move(other.actions);
+         tables         = std::move(other.tables);
+         error_messages = std::move(other.error_messages);
+         variants       = std::move(other.variants);
+         built_in_types = std::move(other.built_in_types);
+         plan = std::move(other.plan);
+         other.plan = std::make_unique<impl::abi_plan>();
+      }
+      return *this;
+   }
+
    void abi_serializer::add_specialized_unpack_pack( const string& name,
                                                      std::pair<abi_serializer::unpack_function, abi_serializer::pack_function> unpack_pack ) {
       built_in_types[name] = std::move( unpack_pack );
+      plan = std::make_unique<impl::abi_plan>();
    }
 
    void abi_serializer::configure_built_in_types() {
@@ -108,6 +233,7 @@ namespace eosio { namespace chain {
 
       EOS_ASSERT(starts_with(abi.version, "eosio::abi/1."), unsupported_abi_version_exception, "ABI has an unsupported version");
 
+      plan = std::make_unique<impl::abi_plan>();
       typedefs.clear();
       structs.clear();
       actions.clear();
@@ -279,24 +405,119 @@ namespace eosio { namespace chain {
       return type;
    }
 
-   void abi_serializer::_binary_to_variant( const type_name& type, fc::datastream<const char *>& stream,
+   const impl::compiled_type* abi_serializer::compile_type( const type_name& type )const {
+      auto itr = plan->by_name.find( type );
+      if( itr != plan->by_name.end() ) return itr->second;
+
+      auto rtype = resolve_type( type );
+      if( rtype != type ) {
+         auto t = compile_type( rtype );
+         plan->by_name.emplace( type, t );
+         return t;
+      }
+
+      plan->types.emplace_back();
+      auto& t = plan->types.back();
+      plan->by_name.emplace( type, &t );
+      t.name = type;
+
+      auto ftype = fundamental_type( type );
+      auto btype = built_in_types.find( ftype );
+      if( btype != built_in_types.end() ) {
+         t.kind = impl::compiled_type::built_in_kind;
+         t.name = ftype;
+         t.built_in = &btype->second;
+         t.built_in_array = is_array( type );
+         t.built_in_optional = is_optional( type );
+         if( !t.built_in_array && !t.built_in_optional ) {
+            const auto& unpack = btype->second.first;
+            if( (ftype == "bool" || ftype == "uint8") && is_default_unpack<uint8_t>( unpack ) ) t.leaf = impl::compiled_type::uint8_leaf;
+            else if( ftype == "int8" && is_default_unpack<int8_t>( unpack ) )     t.leaf = impl::compiled_type::int8_leaf;
+            else if( ftype == "int16" && is_default_unpack<int16_t>( unpack ) )   t.leaf = impl::compiled_type::int16_leaf;
+            else if( ftype == "uint16" && is_default_unpack<uint16_t>( unpack ) ) t.leaf = impl::compiled_type::uint16_leaf;
+            else if( ftype == "int32" && is_default_unpack<int32_t>( unpack ) )   t.leaf = impl::compiled_type::int32_leaf;
+            else if( ftype == "uint32" && is_default_unpack<uint32_t>( unpack ) ) t.leaf = impl::compiled_type::uint32_leaf;
+            else if( ftype == "int64" && is_default_unpack<int64_t>( unpack ) )   t.leaf = impl::compiled_type::int64_leaf;
+            else if( ftype == "uint64" && is_default_unpack<uint64_t>( unpack ) ) t.leaf = impl::compiled_type::uint64_leaf;
+            else if( ftype == "name" && is_default_unpack<name>( unpack ) )       t.leaf = impl::compiled_type::name_leaf;
+         }
+      } else if( is_array( type ) || is_optional( type ) ) {
+         t.kind = is_array( type ) ? impl::compiled_type::array_kind : impl::compiled_type::optional_kind;
+         t.element_name = ftype;
+         t.element = compile_type( ftype );
+      } else if( (t.variant_itr = variants.find( type )) != variants.end() ) {
+         t.kind = impl::compiled_type::variant_kind;
+         plan->unlinked.push_back( &t );
+      } else if( (t.struct_itr = structs.find( type )) != structs.end() ) {
+         t.kind = impl::compiled_type::struct_kind;
+         plan->unlinked.push_back( &t );
+      }
+      return &t;
+   }
+
+   void abi_serializer::compile_members( impl::compiled_type& t )const {
+      if( t.kind == impl::compiled_type::variant_kind ) {
+         t.alternatives.reserve( t.variant_itr->second.types.size() );
+         for( const auto& type : t.variant_itr->second.types )
+            t.alternatives.push_back( compile_type( type ) );
+         return;
+      }
+
+      const auto& st = t.struct_itr->second;
+      if( st.base != type_name() )
+         t.base = compile_type( resolve_type( st.base ) );
+
+      t.fields.reserve( st.fields.size() );
+      for( const auto& field : st.fields ) {
+         impl::compiled_field f;
+         f.extension = ends_with( field.type, "$" );
+         f.name = f.extension ? _remove_bin_extension( field.type ) : field.type;
+         f.type = compile_type( f.name );
+         f.json_key = fc::json::to_string( fc::variant( field.name ) ) + ':';
+         t.fields.push_back( std::move(f) );
+      }
+
+      // a variant object keeps a single value per field name, the JSON writer falls back to it for such structs
+      set<field_name> names;
+      const struct_def* s = &st;
+      for( size_t depth = 0; s != nullptr && depth <= structs.size(); ++depth ) {
+         for( const auto& field : s->fields )
+            t.duplicate_field_names |= !names.insert( field.name ).second;
+         auto itr = s->base == type_name() ? structs.end() : structs.find( resolve_type( s->base ) );
+         s = itr == structs.end() ? nullptr : &itr->second;
+      }
+   }
+
+   const impl::compiled_type& abi_serializer::compiled( const type_name& type, impl::abi_traverse_context& ctx )const {
+      std::lock_guard<std::mutex> g( plan->mutex );
+      auto t = compile_type( type );
+      // struct and variant members are linked iteratively so deeply nested ABIs cannot exhaust the stack
+      while( !plan->unlinked.empty() ) {
+         ctx.check_deadline();
+         auto u = plan->unlinked.back();
+         plan->unlinked.pop_back();
+         compile_members( *u );
+      }
+      return *t;
+   }
+
+   void abi_serializer::_binary_to_variant( const impl::compiled_type& t, fc::datastream<const char *>& stream,
                                             fc::mutable_variant_object& obj, impl::binary_to_variant_context& ctx )const
    {
       auto h = ctx.enter_scope();
-      auto s_itr = structs.find(type);
-      EOS_ASSERT( s_itr != structs.end(), invalid_type_inside_abi, "Unknown type ${type}", ("type",ctx.maybe_shorten(type)) );
-      ctx.hint_struct_type_if_in_array( s_itr );
-      const auto& st = s_itr->second;
-      if( st.base != type_name() ) {
-         _binary_to_variant(resolve_type(st.base), stream, obj, ctx);
+      EOS_ASSERT( t.kind == impl::compiled_type::struct_kind, invalid_type_inside_abi, "Unknown type ${type}", ("type",ctx.maybe_shorten(t.name)) );
+      ctx.hint_struct_type_if_in_array( t.struct_itr );
+      const auto& st = t.struct_itr->second;
+      if( t.base ) {
+         _binary_to_variant(*t.base, stream, obj, ctx);
       }
       bool encountered_extension = false;
       for( uint32_t i = 0; i < st.fields.size(); ++i ) {
          const auto& field = st.fields[i];
-         bool extension = ends_with(field.type, "$");
-         encountered_extension |= extension;
+         const auto& compiled_field = t.fields[i];
+         encountered_extension |= compiled_field.extension;
          if( !stream.remaining() ) {
-            if( extension ) {
+            if( compiled_field.extension ) {
                continue;
             }
             if( encountered_extension ) {
@@ -307,36 +528,34 @@ namespace eosio { namespace chain {
                        ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
 
          }
-         auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = s_itr, .field_ordinal = i } );
-         obj( field.name, _binary_to_variant(resolve_type( extension ? _remove_bin_extension(field.type) : field.type ), stream, ctx) );
+         auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = t.struct_itr, .field_ordinal = i } );
+         obj( field.name, _binary_to_variant(*compiled_field.type, stream, ctx) );
       }
    }
 
-   fc::variant abi_serializer::_binary_to_variant( const type_name& type, fc::datastream<const char *>& stream,
+   fc::variant abi_serializer::_binary_to_variant( const impl::compiled_type& t, fc::datastream<const char *>& stream,
                                                    impl::binary_to_variant_context& ctx )const
    {
       auto h = ctx.enter_scope();
-      type_name rtype = resolve_type(type);
-      auto ftype = fundamental_type(rtype);
-      auto btype = built_in_types.find(ftype );
-      if( btype != built_in_types.end() ) {
+      if( t.kind == impl::compiled_type::built_in_kind ) {
          try {
-            return btype->second.first(stream, is_array(rtype), is_optional(rtype));
+            return t.built_in->first(stream, t.built_in_array, t.built_in_optional);
          } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack ${class} type '${type}' while processing '${p}'",
-                                   ("class", is_array(rtype) ? "array of built-in" : is_optional(rtype) ? "optional of built-in" : "built-in")
-                                   ("type", ftype)("p", ctx.get_path_string()) )
+                                   ("class", t.built_in_array ? "array of built-in" : t.built_in_optional ? "optional of built-in" : "built-in")
+                                   ("type", t.name)("p", ctx.get_path_string()) )
       }
-      if ( is_array(rtype) ) {
+      if ( t.kind == impl::compiled_type::array_kind ) {
          ctx.hint_array_type_if_in_array();
          fc::unsigned_int size;
          try {
             fc::raw::unpack(stream, size);
          } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack size of array '${p}'", ("p", ctx.get_path_string()) )
          vector<fc::variant> vars;
+         vars.reserve( std::min<size_t>( size.value, stream.remaining() ) );
          auto h1 = ctx.push_to_path( impl::array_index_path_item{} );
          for( decltype(size.value) i = 0; i < size; ++i ) {
             ctx.set_array_index_of_path_back(i);
-            auto v = _binary_to_variant(ftype, stream, ctx);
+            auto v = _binary_to_variant(*t.element, stream, ctx);
             // QUESTION: Is it actually desired behavior to require the returned variant to not be null?
             //           This would disallow arrays of optionals in general (though if all optionals in the array were present it would be allowed).
             //           Is there any scenario in which the returned variant would be null other than in the case of an empty optional?
@@ -349,34 +568,163 @@ namespace eosio { namespace chain {
                      "packed size does not match unpacked array size, packed size ${p} actual size ${a}",
                      ("p", size)("a", vars.size()) );
          return fc::variant( std::move(vars) );
-      } else if ( is_optional(rtype) ) {
+      } else if ( t.kind == impl::compiled_type::optional_kind ) {
          char flag;
          try {
             fc::raw::unpack(stream, flag);
          } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack presence flag of optional '${p}'", ("p", ctx.get_path_string()) )
-         return flag ? _binary_to_variant(ftype, stream, ctx) : fc::variant();
-      } else {
-         auto v_itr = variants.find(rtype);
-         if( v_itr != variants.end() ) {
-            ctx.hint_variant_type_if_in_array( v_itr );
-            fc::unsigned_int select;
-            try {
-               fc::raw::unpack(stream, select);
-            } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack tag of variant '${p}'", ("p", ctx.get_path_string()) )
-            EOS_ASSERT( (size_t)select < v_itr->second.types.size(), unpack_exception,
-                        "Unpacked invalid tag (${select}) for variant '${p}'", ("select", select.value)("p",ctx.get_path_string()) );
-            auto h1 = ctx.push_to_path( impl::variant_path_item{ .variant_itr = v_itr, .variant_ordinal = static_cast<uint32_t>(select) } );
-            return vector<fc::variant>{v_itr->second.types[select], _binary_to_variant(v_itr->second.types[select], stream, ctx)};
-         }
+         return flag ? _binary_to_variant(*t.element, stream, ctx) : fc::variant();
+      } else if ( t.kind == impl::compiled_type::variant_kind ) {
+         ctx.hint_variant_type_if_in_array( t.variant_itr );
+         fc::unsigned_int select;
+         try {
+            fc::raw::unpack(stream, select);
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack tag of variant '${p}'", ("p", ctx.get_path_string()) )
+         EOS_ASSERT( (size_t)select < t.alternatives.size(), unpack_exception,
+                     "Unpacked invalid tag (${select}) for variant '${p}'", ("select", select.value)("p",ctx.get_path_string()) );
+         auto h1 = ctx.push_to_path( impl::variant_path_item{ .variant_itr = t.variant_itr, .variant_ordinal = static_cast<uint32_t>(select) } );
+         return vector<fc::variant>{t.variant_itr->second.types[select], _binary_to_variant(*t.alternatives[select], stream, ctx)};
       }
 
       fc::mutable_variant_object mvo;
-      _binary_to_variant(rtype, stream, mvo, ctx);
+      _binary_to_variant(t, stream, mvo, ctx);
       // QUESTION: Is this assert actually desired? It disallows unpacking empty structs from datastream.
       EOS_ASSERT( mvo.size() > 0, unpack_exception, "Unable to unpack '${p}' from stream", ("p", ctx.get_path_string()) );
       return fc::variant( std::move(mvo) );
    }
 
+   fc::variant abi_serializer::_binary_to_variant( const type_name& type, fc::datastream<const char *>& stream,
+                                                   impl::binary_to_variant_context& ctx )const
+   {
+      return _binary_to_variant( compiled(type, ctx), stream, ctx );
+   }
+
+   void abi_serializer::_binary_to_json( const impl::compiled_type& t, fc::datastream<const char *>& stream, std::ostream& out,
+                                         bool& first_field, impl::binary_to_variant_context& ctx )const
+   {
+      auto h = ctx.enter_scope();
+      EOS_ASSERT( t.kind == impl::compiled_type::struct_kind, invalid_type_inside_abi, "Unknown type ${type}", ("type",ctx.maybe_shorten(t.name)) );
+      ctx.hint_struct_type_if_in_array( t.struct_itr );
+      const auto& st = t.struct_itr->second;
+      if( t.base ) {
+         _binary_to_json(*t.base, stream, out, first_field, ctx);
+      }
+      bool encountered_extension = false;
+      for( uint32_t i = 0; i < st.fields.size(); ++i ) {
+         const auto& field = st.fields[i];
+         const auto& compiled_field = t.fields[i];
+         encountered_extension |= compiled_field.extension;
+         if( !stream.remaining() ) {
+            if( compiled_field.extension ) {
+               continue;
+            }
+            if( encountered_extension ) {
+               EOS_THROW( abi_exception, "Encountered field '${f}' without binary extension designation while processing struct '${p}'",
+                          ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
+            }
+            EOS_THROW( unpack_exception, "Stream unexpectedly ended; unable to unpack field '${f}' of struct '${p}'",
+                       ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
+
+         }
+         auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = t.struct_itr, .field_ordinal = i } );
+         if( !first_field ) out << ',';
+         first_field = false;
+         out << compiled_field.json_key;
+         _binary_to_json(*compiled_field.type, stream, out, ctx);
+      }
+   }
+
+   // mirrors the compiled _binary_to_variant, returns false if it wrote null
+   bool abi_serializer::_binary_to_json( const impl::compiled_type& t, fc::datastream<const char *>& stream, std::ostream& out,
+                                         impl::binary_to_variant_context& ctx )const
+   {
+      if( t.duplicate_field_names ) {
+         fc::json::to_stream( out, _binary_to_variant(t, stream, ctx), fc::json::stringify_large_ints_and_doubles );
+         return true;
+      }
+      auto h = ctx.enter_scope();
+      if( t.kind == impl::compiled_type::built_in_kind ) {
+         try {
+            switch( t.leaf ) {
+               case impl::compiled_type::int8_leaf:   out << int64_t( unpack_from_stream<int8_t>(stream) ); return true;
+               case impl::compiled_type::uint8_leaf:  out << uint64_t( unpack_from_stream<uint8_t>(stream) ); return true;
+               case impl::compiled_type::int16_leaf:  out << unpack_from_stream<int16_t>(stream); return true;
+               case impl::compiled_type::uint16_leaf: out << unpack_from_stream<uint16_t>(stream); return true;
+               case impl::compiled_type::int32_leaf:  out << unpack_from_stream<int32_t>(stream); return true;
+               case impl::compiled_type::uint32_leaf: out << unpack_from_stream<uint32_t>(stream); return true;
+               // fc::json quotes 64 bit integers that do not fit in 32 bits
+               case impl::compiled_type::int64_leaf: {
+                  const auto v = unpack_from_stream<int64_t>(stream);
+                  if( v > 0xffffffff ) out << '"' << v << '"';
+                  else out << v;
+                  return true;
+               }
+               case impl::compiled_type::uint64_leaf: {
+                  const auto v = unpack_from_stream<uint64_t>(stream);
+                  if( v > 0xffffffff ) out << '"' << v << '"';
+                  else out << v;
+                  return true;
+               }
+               case impl::compiled_type::name_leaf:   out << '"' << unpack_from_stream<name>(stream).to_string() << '"'; return true;
+               case impl::compiled_type::generic_leaf: break;
+            }
+            const auto v = t.built_in->first(stream, t.built_in_array, t.built_in_optional);
+            fc::json::to_stream( out, v, fc::json::stringify_large_ints_and_doubles );
+            return !v.is_null();
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack ${class} type '${type}' while processing '${p}'",
+                                   ("class", t.built_in_array ? "array of built-in" : t.built_in_optional ? "optional of built-in" : "built-in")
+                                   ("type", t.name)("p", ctx.get_path_string()) )
+      }
+      if ( t.kind == impl::compiled_type::array_kind ) {
+         ctx.hint_array_type_if_in_array();
+         fc::unsigned_int size;
+         try {
+            fc::raw::unpack(stream, size);
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack size of array '${p}'", ("p", ctx.get_path_string()) )
+         auto h1 = ctx.push_to_path( impl::array_index_path_item{} );
+         out << '[';
+         for( decltype(size.value) i = 0; i < size; ++i ) {
+            ctx.set_array_index_of_path_back(i);
+            if( i > 0 ) out << ',';
+            const bool non_null = _binary_to_json(*t.element, stream, out, ctx);
+            EOS_ASSERT( non_null, unpack_exception, "Invalid packed array '${p}'", ("p", ctx.get_path_string()) );
+         }
+         out << ']';
+         return true;
+      } else if ( t.kind == impl::compiled_type::optional_kind ) {
+         char flag;
+         try {
+            fc::raw::unpack(stream, flag);
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack presence flag of optional '${p}'", ("p", ctx.get_path_string()) )
+         if( flag )
+            return _binary_to_json(*t.element, stream, out, ctx);
+         out << "null";
+         return false;
+      } else if ( t.kind == impl::compiled_type::variant_kind ) {
+         ctx.hint_variant_type_if_in_array( t.variant_itr );
+         fc::unsigned_int select;
+         try {
+            fc::raw::unpack(stream, select);
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack tag of variant '${p}'", ("p", ctx.get_path_string()) )
+         EOS_ASSERT( (size_t)select < t.alternatives.size(), unpack_exception,
+                     "Unpacked invalid tag (${select}) for variant '${p}'", ("select", select.value)("p",ctx.get_path_string()) );
+         auto h1 = ctx.push_to_path( impl::variant_path_item{ .variant_itr = t.variant_itr, .variant_ordinal = static_cast<uint32_t>(select) } );
+         out << '[';
+         fc::json::to_stream( out, fc::variant( t.variant_itr->second.types[select] ), fc::json::stringify_large_ints_and_doubles );
+         out << ',';
+         _binary_to_json(*t.alternatives[select], stream, out, ctx);
+         out << ']';
+         return true;
+      }
+
+      out << '{';
+      bool first_field = true;
+      _binary_to_json(t, stream, out, first_field, ctx);
+      EOS_ASSERT( !first_field, unpack_exception, "Unable to unpack '${p}' from stream", ("p", ctx.get_path_string()) );
+      out << '}';
+      return true;
+   }
+
    fc::variant abi_serializer::_binary_to_variant( const type_name& type, const bytes& binary, impl::binary_to_variant_context& ctx )const
    {
       auto h = ctx.enter_scope();
@@ -396,20 +744,24 @@ namespace eosio { namespace chain {
       return _binary_to_variant(type, binary, ctx);
    }
 
-   void abi_serializer::_variant_to_binary( const type_name& type, const fc::variant& var, fc::datastream<char *>& ds, impl::variant_to_binary_context& ctx )const
-   { try {
+   void abi_serializer::binary_to_json( const type_name& type, const bytes& binary, std::ostream& out, const fc::microseconds& max_serialization_time, bool short_path )const {
+      impl::binary_to_variant_context ctx(*this, max_serialization_time, type);
+      ctx.short_path = short_path;
       auto h = ctx.enter_scope();
-      auto rtype = resolve_type(type);
+      fc::datastream<const char*> ds( binary.data(), binary.size() );
+      _binary_to_json( compiled(type, ctx), ds, out, ctx );
+   }
 
-      auto v_itr = variants.end();
-      auto s_itr = structs.end();
+   void abi_serializer::_variant_to_binary( const type_name& type, const impl::compiled_type& t, const fc::variant& var,
+                                            fc::datastream<char *>& ds, impl::variant_to_binary_context& ctx )const
+   { try {
+      auto h = ctx.enter_scope();
 
-      auto btype = built_in_types.find(fundamental_type(rtype));
-      if( btype != built_in_types.end() ) {
-         btype->second.second(var, ds, is_array(rtype), is_optional(rtype));
-      } else if ( is_array(rtype) ) {
+      if( t.kind == impl::compiled_type::built_in_kind ) {
+         t.built_in->second(var, ds, t.built_in_array, t.built_in_optional);
+      } else if ( t.kind == impl::compiled_type::array_kind ) {
          ctx.hint_array_type_if_in_array();
-         vector<fc::variant> vars = var.get_array();
+         const auto& vars = var.get_array();
          fc::raw::pack(ds, (fc::unsigned_int)vars.size());
 
          auto h1 = ctx.push_to_path( impl::array_index_path_item{} );
@@ -418,12 +770,12 @@ namespace eosio { namespace chain {
          int64_t i = 0;
          for (const auto& var : vars) {
             ctx.set_array_index_of_path_back(i);
-           _variant_to_binary(fundamental_type(rtype), var, ds, ctx);
+           _variant_to_binary(t.element_name, *t.element, var, ds, ctx);
            ++i;
          }
-      } else if( (v_itr = variants.find(rtype)) != variants.end() ) {
-         ctx.hint_variant_type_if_in_array( v_itr );
-         auto& v = v_itr->second;
+      } else if( t.kind == impl::compiled_type::variant_kind ) {
+         ctx.hint_variant_type_if_in_array( t.variant_itr );
+         auto& v = t.variant_itr->second;
          EOS_ASSERT( var.is_array() && var.size() == 2, pack_exception,
                     "Expected input to be an array of two items while processing variant '${p}'", ("p", ctx.get_path_string()) );
          EOS_ASSERT( var[size_t(0)].is_string(), pack_exception,
@@ -434,32 +786,34 @@ namespace eosio { namespace chain {
                      "Specified type '${t}' in input array is not valid within the variant '${p}'",
                      ("t", ctx.maybe_shorten(variant_type_str))("p", ctx.get_path_string()) );
          fc::raw::pack(ds, fc::unsigned_int(it - v.types.begin()));
-         auto h1 = ctx.push_to_path( impl::variant_path_item{ .variant_itr = v_itr, .variant_ordinal = static_cast<uint32_t>(it - v.types.begin()) } );
-         _variant_to_binary( *it, var[size_t(1)], ds, ctx );
-      } else if( (s_itr = structs.find(rtype)) != structs.end() ) {
-         ctx.hint_struct_type_if_in_array( s_itr );
-         const auto& st = s_itr->second;
+         auto h1 = ctx.push_to_path( impl::variant_path_item{ .variant_itr = t.variant_itr, .variant_ordinal = static_cast<uint32_t>(it - v.types.begin()) } );
+         _variant_to_binary( *it, *t.alternatives[it - v.types.begin()], var[size_t(1)], ds, ctx );
+      } else if( t.kind == impl::compiled_type::struct_kind ) {
+         ctx.hint_struct_type_if_in_array( t.struct_itr );
+         const auto& st = t.struct_itr->second;
 
          if( var.is_object() ) {
             const auto& vo = var.get_object();
 
-            if( st.base != type_name() ) {
+            if( t.base ) {
                auto h2 = ctx.disallow_extensions_unless(false);
-               _variant_to_binary(resolve_type(st.base), var, ds, ctx);
+               _variant_to_binary(t.base->name, *t.base, var, ds, ctx);
             }
             bool disallow_additional_fields = false;
             for( uint32_t i = 0; i < st.fields.size(); ++i ) {
                const auto& field = st.fields[i];
-               if( vo.contains( string(field.name).c_str() ) ) {
+               const auto& compiled_field = t.fields[i];
+               auto value = vo.find( field.name );
+               if( value != vo.end() ) {
                   if( disallow_additional_fields )
                      EOS_THROW( pack_exception, "Unexpected field '${f}' found in input object while processing struct '${p}'",
                                 ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
                   {
-                     auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = s_itr, .field_ordinal = i } );
+                     auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = t.struct_itr, .field_ordinal = i } );
                      auto h2 = ctx.disallow_extensions_unless( &field == &st.fields.back() );
-                     _variant_to_binary(_remove_bin_extension(field.type), vo[field.name], ds, ctx);
+                     _variant_to_binary(compiled_field.name, *compiled_field.type, value->value(), ds, ctx);
                   }
-               } else if( ends_with(field.type, "$") && ctx.extensions_allowed() ) {
+               } else if( compiled_field.extension && ctx.extensions_allowed() ) {
                   disallow_additional_fields = true;
                } else if( disallow_additional_fields ) {
                   EOS_THROW( abi_exception, "Encountered field '${f}' without binary extension designation while processing struct '${p}'",
@@ -476,11 +830,12 @@ namespace eosio { namespace chain {
                         ("p",ctx.get_path_string()) );
             for( uint32_t i = 0; i < st.fields.size(); ++i ) {
                const auto& field = st.fields[i];
+               const auto& compiled_field = t.fields[i];
                if( va.size() > i ) {
-                  auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = s_itr, .field_ordinal = i } );
+                  auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = t.struct_itr, .field_ordinal = i } );
                   auto h2 = ctx.disallow_extensions_unless( &field == &st.fields.back() );
-                  _variant_to_binary(_remove_bin_extension(field.type), va[i], ds, ctx);
-               } else if( ends_with(field.type, "$") && ctx.extensions_allowed() ) {
+                  _variant_to_binary(compiled_field.name, *compiled_field.type, va[i], ds, ctx);
+               } else if( compiled_field.extension && ctx.extensions_allowed() ) {
                   break;
                } else {
                   EOS_THROW( pack_exception, "Early end to input array specifying the fields of struct '${p}'; require input for field '${f}'",
@@ -495,6 +850,11 @@ namespace eosio { namespace chain {
       }
    } FC_CAPTURE_AND_RETHROW( (type)(var) ) }
 
+   void abi_serializer::_variant_to_binary( const type_name& type, const fc::variant& var, fc::datastream<char *>& ds, impl::variant_to_binary_context& ctx )const
+   {
+      _variant_to_binary( type, compiled(type, ctx), var, ds, ctx );
+   }
+
    bytes abi_serializer::_variant_to_binary( const type_name& type, const fc::variant& var, impl::variant_to_binary_context& ctx )const
    { try {
       auto h = ctx.enter_scope();
@@ -0,0 +1,167 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#include <eosio/chain/abi_serializer_cache.hpp>
+#include <eosio/chain/account_object.hpp>
+
+#include <mutex>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+
+namespace eosio { namespace chain {
+
+using namespace boost::multi_index;
+
+namespace {
+
+   struct cached_abi {
+      account_name                       account;
+      abi_serializer_cache::entry_ptr    abi;
+   };
+   struct by_account{};
+
+   typedef multi_index_container<
+      cached_abi,
+      indexed_by<
+         sequenced<>,
+         hashed_unique<
+            tag<by_account>,
+            member<cached_abi,
+                   account_name,
+                   &cached_abi::account>,
+            std::hash<account_name>
+         >
+      >
+   > abi_cache_type;
+
+} // anonymous namespace
+
+/// least recently used entries are at the front
+struct abi_serializer_cache::impl {
+   mutable std::mutex mtx;
+   abi_cache_type     entries;
+   uint32_t           capacity = 0;
+   uint64_t           memory_size = 0;
+   uint64_t           hits = 0;
+   uint64_t           misses = 0;
+   uint64_t           invalidations = 0;
+   uint64_t           evictions = 0;
+
+   void trim() {
+      while( entries.size() > capacity ) {
+         memory_size -= entries.front().abi->memory_size;
+         entries.pop_front();
+         ++evictions;
+      }
+   }
+};
+
+abi_serializer_cache::abi_serializer_cache( uint32_t capacity )
+:my( new impl() )
+{
+   set_capacity( capacity );
+}
+
+abi_serializer_cache::~abi_serializer_cache() = default;
+
+void abi_serializer_cache::set_capacity( uint32_t capacity ) {
+   std::lock_guard<std::mutex> g( my->mtx );
+   my->capacity = capacity;
+   my->trim();
+}
+
+abi_serializer_cache::entry_ptr abi_serializer_cache::get( const chainbase::database& db, const account_name& account,
+                                                          const fc::microseconds& max_serialization_time ) {
+   const auto* seq = db.find<account_sequence_object, by_name>( account );
+   if( seq == nullptr )
+      return entry_ptr();
+
+   {
+      std::lock_guard<std::mutex> g( my->mtx );
+      auto& by_account_idx = my->entries.get<by_account>();
+      auto it = by_account_idx.find( account );
+      if( it != by_account_idx.end() && it->abi->abi_sequence == seq->abi_sequence ) {
+         my->entries.relocate( my->entries.end(), my->entries.project<0>( it ) );
+         ++my->hits;
+         return it->abi;
+      }
+      ++my->misses;
+   }
+
+   // parsing and validating the ABI is the expensive part, keep it outside the lock
+   entry_ptr result = make_entry( db, account, max_serialization_time );
+   if( !result )
+      return result;
+
+   std::lock_guard<std::mutex> g( my->mtx );
+   if( my->capacity == 0 )
+      return result;
+   auto r = my->entries.emplace_back( cached_abi{account, result} );
+   if( !r.second ) {
+      // another request cached it meanwhile or the ABI was replaced, keep the one just built
+      my->memory_size -= r.first->abi->memory_size;
+      my->entries.modify( r.first, [&]( cached_abi& e ) { e.abi = result; } );
+      my->entries.relocate( my->entries.end(), r.first );
+   }
+   my->memory_size += result->memory_size;
+   my->trim();
+   return result;
+}
+
+void abi_serializer_cache::invalidate( const account_name& account ) {
+   std::lock_guard<std::mutex> g( my->mtx );
+   auto& by_account_idx = my->entries.get<by_account>();
+   auto it = by_account_idx.find( account );
+   if( it == by_account_idx.end() )
+      return;
+   my->memory_size -= it->abi->memory_size;
+   by_account_idx.erase( it );
+   ++my->invalidations;
+}
+
+void abi_serializer_cache::clear() {
+   std::lock_guard<std::mutex> g( my->mtx );
+   my->invalidations += my->entries.size();
+   my->entries.clear();
+   my->memory_size = 0;
+}
+
+abi_serializer_cache::cache_stats abi_serializer_cache::get_stats()const {
+   std::lock_guard<std::mutex> g( my->mtx );
+   cache_stats stats;
+   stats.hits = my->hits;
+   stats.misses = my->misses;
+   stats.invalidations = my->invalidations;
+   stats.evictions = my->evictions;
+   stats.entries = my->entries.size();
+   stats.capacity = my->capacity;
+   stats.memory_size = my->memory_size;
+   return stats;
+}
+
+abi_serializer_cache::entry_ptr abi_serializer_cache::make_entry( const chainbase::database& db, const account_name& account,
+                                                                 const fc::microseconds& max_serialization_time ) {
+   const auto* accnt = db.find<account_object, by_name>( account );
+   const auto* seq = db.find<account_sequence_object, by_name>( account );
+   if( accnt == nullptr || seq == nullptr )
+      return entry_ptr();
+
+   abi_def abi;
+   if( !abi_serializer::to_abi( accnt->abi, abi ) )
+      return entry_ptr();
+
+   auto result = std::make_shared<entry>();
+   result->serializer.set_abi( abi, max_serialization_time );
+   result->abi = std::move( abi );
+   result->abi_sequence = seq->abi_sequence;
+   // rough estimate: the unpacked abi_def, the serializer's type maps and its compiled plan each take
+   // about as much as the packed ABI
+   result->memory_size = sizeof(entry) + 3 * accnt->abi.size();
+   return result;
+}
+
+} } /// eosio::chain
@@ -50,6 +50,11 @@ void apply_context::exec_one( action_trace& trace )
          const auto& a = control.get_account( receiver );
          privileged = a.privileged;
          auto native = control.find_apply_handler( receiver, act.account, act.name );
+         if( trx_context.access_set ) {
+            trx_context.access_set->add_read( receiver );
+            // native handlers and privileged contracts modify state that is not tracked per table
+            if( native || privileged ) trx_context.access_set->exclusive = true;
+         }
          if( native ) {
             if( trx_context.enforce_whiteblacklist && control.is_producing_block() ) {
                control.check_contract_list( receiver );
@@ -290,6 +295,7 @@ void apply_context::schedule_deferred_transaction( const uint128_t& sender_id, a
    EOS_ASSERT( trx.context_free_actions.size() == 0, cfa_inside_generated_tx, "context free actions are not currently allowed in generated transactions" );
    trx.expiration = control.pending_block_time() + fc::microseconds(999'999); // Rounds up to nearest second (makes expiration check unnecessary)
    trx.set_reference_block(control.head_block_id()); // No TaPoS check necessary
+   if( trx_context.access_set ) trx_context.access_set->add_write( receiver );
 
    bool enforce_actor_whitelist_blacklist = trx_context.enforce_whiteblacklist && control.is_producing_block()
                                              && !control.sender_avoids_whitelist_blacklist_enforcement( receiver );
@@ -400,6 +406,7 @@ void apply_context::schedule_deferred_transaction( const uint128_t& sender_id, a
 }
 
 bool apply_context::cancel_deferred_transaction( const uint128_t& sender_id, account_name sender ) {
+   if( trx_context.access_set ) trx_context.access_set->add_write( sender );
    auto& generated_transaction_idx = db.get_mutable_index<generated_transaction_multi_index>();
    const auto* gto = db.find<generated_transaction_object,by_sender_id>(boost::make_tuple(sender, sender_id));
    if ( gto ) {
@@ -410,10 +417,12 @@ bool apply_context::cancel_deferred_transaction( const uint128_t& sender_id, acc
 }
 
 const table_id_object* apply_context::find_table( name code, name scope, name table ) {
+   if( trx_context.access_set ) trx_context.access_set->add_read( code, scope, table );
    return db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
 }
 
 const table_id_object& apply_context::find_or_create_table( name code, name scope, name table, const account_name &payer ) {
+   if( trx_context.access_set ) trx_context.access_set->add_write( code, scope, table );
    const auto* existing_tid =  db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
    if (existing_tid != nullptr) {
       return *existing_tid;
@@ -429,6 +438,10 @@ const table_id_object& apply_context::find_or_create_table( name code, name scop
    });
 }
 
+void apply_context::record_table_write( const table_id_object& tid ) {
+   if( trx_context.access_set ) trx_context.access_set->add_write( tid.code, tid.scope, tid.table );
+}
+
 void apply_context::remove_table( const table_id_object& tid ) {
    update_db_usage(tid.payer, - config::billable_size_v<table_id_object>);
    db.remove(tid);
@@ -543,6 +556,7 @@ void apply_context::db_update_i64( int iterator, account_name payer, const char*
    EOS_ASSERT( table_obj.code == receiver, table_access_violation, "db access violation" );
 
 //   require_write_lock( table_obj.scope );
+   record_table_write( table_obj );
 
    const int64_t overhead = config::billable_size_v<key_value_object>;
    int64_t old_size = (int64_t)(obj.value.size() + overhead);
@@ -573,6 +587,7 @@ void apply_context::db_remove_i64( int iterator ) {
    EOS_ASSERT( table_obj.code == receiver, table_access_violation, "db access violation" );
 
 //   require_write_lock( table_obj.scope );
+   record_table_write( table_obj );
 
    update_db_usage( obj.payer,  -(obj.value.size() + config::billable_size_v<key_value_object>) );
 
@@ -727,6 +742,7 @@ uint64_t apply_context::next_auth_sequence( account_name actor ) {
 
 void apply_context::add_ram_usage( account_name account, int64_t ram_delta ) {
    trx_context.add_ram_usage( account, ram_delta );
+   if( trx_context.access_set ) trx_context.access_set->add_write( account );
 
    auto p = _account_ram_deltas.emplace( account, ram_delta );
    if( !p.second ) {
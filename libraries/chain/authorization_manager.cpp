@@ -18,6 +18,9 @@
 
 namespace eosio { namespace chain {
 
+   /// satisfied checks memoized per block, beyond this new ones are not remembered until the next block
+   static const size_t max_satisfied_authorities = 10000;
+
    using authorization_index_set = index_set<
       permission_index,
       permission_usage_index,
@@ -113,6 +116,19 @@ namespace eosio { namespace chain {
       });
    }
 
+   void authorization_manager::add_snapshot_parts( uint64_t rows_per_part, std::vector<snapshot_part>& parts ) const {
+      authorization_index_set::walk_indices([this, rows_per_part, &parts]( auto utils ){
+         using section_t = typename decltype(utils)::index_t::value_type;
+
+         // skip the permission_usage_index as its inlined with permission_index
+         if (std::is_same<section_t, permission_usage_object>::value) {
+            return;
+         }
+
+         add_index_snapshot_parts<decltype(utils)>(_db, rows_per_part, parts);
+      });
+   }
+
    void authorization_manager::read_from_snapshot( const snapshot_reader_ptr& snapshot ) {
       authorization_index_set::walk_indices([this, &snapshot]( auto utils ){
          using section_t = typename decltype(utils)::index_t::value_type;
@@ -157,6 +173,7 @@ namespace eosio { namespace chain {
          p.last_updated = creation_time;
          p.auth         = auth;
       });
+      permission_changed();
       return perm;
    }
 
@@ -184,6 +201,7 @@ namespace eosio { namespace chain {
          p.last_updated = creation_time;
          p.auth         = std::move(auth);
       });
+      permission_changed();
       return perm;
    }
 
@@ -192,6 +210,7 @@ namespace eosio { namespace chain {
          po.auth = auth;
          po.last_updated = _control.pending_block_time();
       });
+      permission_changed();
    }
 
    void authorization_manager::remove_permission( const permission_object& permission ) {
@@ -202,6 +221,31 @@ namespace eosio { namespace chain {
 
       _db.get_mutable_index<permission_usage_index>().remove_object( permission.usage_id._id );
       _db.remove( permission );
+      permission_changed();
+   }
+
+   void authorization_manager::clear_authority_cache() {
+      forget_authorities();
+      _permissions_changed = false;
+   }
+
+   void authorization_manager::permission_changed() {
+      forget_authorities();
+      _permissions_changed = true;
+   }
+
+   void authorization_manager::forget_authorities()const {
+      _flat_authorities.clear();
+      if( !_satisfied_authorities.empty() ) {
+         _satisfied_authorities.clear();
+         ++_authority_cache_stats.invalidations;
+      }
+   }
+
+   authorization_manager::authority_cache_stats authorization_manager::get_authority_cache_stats()const {
+      auto stats = _authority_cache_stats;
+      stats.entries = _satisfied_authorities.size();
+      return stats;
    }
 
    void authorization_manager::update_permission_usage( const permission_object& permission ) {
@@ -227,6 +271,30 @@ namespace eosio { namespace chain {
       return _db.get<permission_object, by_owner>( boost::make_tuple(level.actor,level.permission) );
    } EOS_RETHROW_EXCEPTIONS( chain::permission_query_exception, "Failed to retrieve permission: ${level}", ("level", level) ) }
 
+   /// whether a permission still has the authority a cached flat_authority was built from
+   static bool same_authority( const shared_authority& current, const authority& cached ) {
+      return current.threshold == cached.threshold
+          && std::equal( current.keys.begin(), current.keys.end(), cached.keys.begin(), cached.keys.end() )
+          && std::equal( current.accounts.begin(), current.accounts.end(), cached.accounts.begin(), cached.accounts.end() )
+          && std::equal( current.waits.begin(), current.waits.end(), cached.waits.begin(), cached.waits.end() );
+   }
+
+   const flat_authority& authorization_manager::get_flat_authority( const permission_level& level )const {
+      auto itr = _flat_authorities.find( level );
+      if( itr != _flat_authorities.end() && !_permissions_changed )
+         return itr->second.flat;
+
+      // after a permission change an entry may have been built from a change that a failed transaction undid
+      const auto& permission = get_permission( level );
+      if( itr != _flat_authorities.end() ) {
+         if( same_authority( permission.auth, itr->second.auth ) )
+            return itr->second.flat;
+         itr->second = cached_flat_authority{ permission.auth.to_authority(), flat_authority( permission.auth ) };
+         return itr->second.flat;
+      }
+      return _flat_authorities.emplace( level, cached_flat_authority{ permission.auth.to_authority(), flat_authority( permission.auth ) } ).first->second.flat;
+   }
+
    optional<permission_name> authorization_manager::lookup_linked_permission( account_name authorizer_account,
                                                                               account_name scope,
                                                                               action_name act_name
@@ -441,14 +509,57 @@ namespace eosio { namespace chain {
 
       auto effective_provided_delay =  (provided_delay >= delay_max_limit) ? fc::microseconds::maximum() : provided_delay;
 
-      auto checker = make_auth_checker( [&](const permission_level& p){ return get_permission(p).auth; },
-                                        _control.get_global_properties().configuration.max_authority_depth,
+      const uint16_t max_authority_depth = _control.get_global_properties().configuration.max_authority_depth;
+
+      auto checker = make_auth_checker( [&](const permission_level& p) -> const flat_authority& { return get_flat_authority(p); },
+                                        max_authority_depth,
                                         provided_keys,
                                         provided_permissions,
                                         effective_provided_delay,
                                         checktime
                                       );
 
+      if( max_authority_depth != _satisfied_authorities_depth ) {
+         forget_authorities();
+         _satisfied_authorities_depth = max_authority_depth;
+      }
+
+      // Checks with only keys and a delay are memoized until the next block or permission change. Each miss is
+      // evaluated on its own checker so that the keys it uses are known exactly, not only the ones new to this trx.
+      // After a permission change nothing is memoized for the rest of the block, a check could otherwise remember
+      // an authority that a failing transaction undoes.
+      auto satisfied = [&]( const permission_level& level, fc::microseconds delay ) {
+         if( !provided_permissions.empty() || _permissions_changed )
+            return checker.satisfied( level, delay );
+
+         auto key = std::make_tuple( level, provided_keys, delay );
+         auto itr = _satisfied_authorities.find( key );
+         if( itr != _satisfied_authorities.end() ) {
+            ++_authority_cache_stats.hits;
+            _authority_cache_stats.cpu_saved_us += itr->second.cpu_usage.count();
+            checker.use_keys( itr->second.used_keys );
+            return true;
+         }
+
+         ++_authority_cache_stats.misses;
+         auto start = fc::time_point::now();
+         auto single_checker = make_auth_checker( [&](const permission_level& p) -> const flat_authority& { return get_flat_authority(p); },
+                                                  max_authority_depth,
+                                                  provided_keys,
+                                                  provided_permissions,
+                                                  effective_provided_delay,
+                                                  checktime
+                                                );
+         if( !single_checker.satisfied( level, delay ) )
+            return false;
+
+         auto used_keys = single_checker.used_keys();
+         checker.use_keys( used_keys );
+         if( _satisfied_authorities.size() < max_satisfied_authorities )
+            _satisfied_authorities.emplace( std::move(key), satisfied_authority{ std::move(used_keys), fc::time_point::now() - start } );
+         return true;
+      };
+
       map<permission_level, fc::microseconds> permissions_to_satisfy;
 
       for( const auto& act : actions ) {
@@ -507,7 +618,7 @@ namespace eosio { namespace chain {
       // ascending order of the actor name with ties broken by ascending order of the permission name.
       for( const auto& p : permissions_to_satisfy ) {
          checktime(); // TODO: this should eventually move into authority_checker instead
-         EOS_ASSERT( checker.satisfied( p.first, p.second ), unsatisfied_authorization,
+         EOS_ASSERT( satisfied( p.first, p.second ), unsatisfied_authorization,
                      "transaction declares authority '${auth}', "
                      "but does not have signatures for it under a provided delay of ${provided_delay} ms, "
                      "provided permissions ${provided_permissions}, provided keys ${provided_keys}, "
@@ -542,7 +653,7 @@ namespace eosio { namespace chain {
 
       auto delay_max_limit = fc::seconds( _control.get_global_properties().configuration.max_transaction_delay );
 
-      auto checker = make_auth_checker( [&](const permission_level& p){ return get_permission(p).auth; },
+      auto checker = make_auth_checker( [&](const permission_level& p) -> const flat_authority& { return get_flat_authority(p); },
                                         _control.get_global_properties().configuration.max_authority_depth,
                                         provided_keys,
                                         provided_permissions,
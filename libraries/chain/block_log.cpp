@@ -4,8 +4,15 @@
  */
 #include <eosio/chain/block_log.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <fstream>
+#include <atomic>
+#include <thread>
 #include <fc/io/raw.hpp>
+#include <fc/scoped_exit.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 #define LOG_READ  (std::ios::in | std::ios::binary)
 #define LOG_WRITE (std::ios::out | std::ios::binary | std::ios::app)
@@ -22,20 +29,418 @@ namespace eosio { namespace chain {
     */
    const uint32_t block_log::max_supported_version = 2;
 
+   uint64_t block_log::index_scan_chunk_size = 64*1024*1024;
+
    namespace detail {
+      namespace bip = boost::interprocess;
+
+      /// bytes of a mapped file, the mapping stays alive as long as a copy of this does
+      struct mapped_bytes {
+         std::shared_ptr<const void> owner;
+         const char*                 data = nullptr;
+         uint64_t                    size = 0;
+      };
+
+      /**
+       *  Read only memory mapping of an append only file, maintained by the writer.
+       *
+       *  The file is mapped with spare capacity so appends usually become visible without remapping; the writer
+       *  publishes how much of the file is valid after it has been flushed. When the file outgrows the mapping a
+       *  larger one replaces it. Readers never use the view itself, they get mapped_bytes through published_log
+       *  or an immutable log_segment, and each mapping is unmapped once the last mapped_bytes referring to it is
+       *  gone. retire() and close() therefore never pull memory out from under a reader.
+       */
+      class mapped_log_view {
+         public:
+            void open( const fc::path& file ) {
+               retire();
+               _file = file;
+               publish( fc::file_size( file ) );
+            }
+
+            /// stops serving the file, readers still holding its bytes keep the mapping alive
+            void retire() {
+               _current.reset();
+               _size = 0;
+               _file = fc::path();
+            }
+
+            void close() {
+               retire();
+            }
+
+            /// makes the first size bytes of the file part of view()
+            void publish( uint64_t size ) {
+               if( _file.empty() )
+                  return;
+               if( !_current || _current->capacity < size ) {
+                  const uint64_t capacity = std::max<uint64_t>( size * 2, min_capacity );
+                  auto m = std::make_shared<mapping>( bip::file_mapping( _file.generic_string().c_str(), bip::read_only ) );
+                  m->region = bip::mapped_region( m->file, bip::read_only, 0, capacity );
+                  m->data = static_cast<const char*>( m->region.get_address() );
+                  m->capacity = capacity;
+                  _current = std::move( m );
+               }
+               _size = size;
+            }
+
+            /// the published part of the file
+            mapped_bytes view()const {
+               if( !_current )
+                  return mapped_bytes();
+               return mapped_bytes{ _current, _current->data, _size };
+            }
+
+         private:
+            static constexpr uint64_t min_capacity = 64*1024*1024;
+
+            struct mapping {
+               explicit mapping( bip::file_mapping&& f ) : file( std::move( f ) ) {}
+
+               bip::file_mapping  file;
+               bip::mapped_region region;
+               const char*        data = nullptr;
+               uint64_t           capacity = 0; ///< may exceed the file size, bytes past the end of the file are never read
+            };
+
+            fc::path                       _file;
+            std::shared_ptr<const mapping> _current;
+            uint64_t                       _size = 0;
+      };
+
+      struct log_header {
+         uint32_t      version = 0;
+         uint32_t      first_block_num = 1;
+         genesis_state gs;
+         uint64_t      first_block_start = 0; ///< file position of the first block
+      };
+
+      /// parses the header of a block log whose version was already checked
+      static log_header read_log_header( const char* data, uint64_t size ) {
+         fc::datastream<const char*> ds( data, size );
+         log_header header;
+         fc::raw::unpack( ds, header.version );
+         if( header.version > 1 )
+            fc::raw::unpack( ds, header.first_block_num );
+         fc::raw::unpack( ds, header.gs );
+         // version 2 and later separate the header from the blocks with a totem
+         header.first_block_start = ds.tellp() + (header.version > 1 ? sizeof(uint64_t) : 0);
+         return header;
+      }
+
+      static std::pair<signed_block_ptr, uint64_t> read_block_at( const mapped_bytes& log, uint64_t pos ) {
+         EOS_ASSERT(pos < log.size, block_log_exception, "Block position ${pos} is past the end of the block log",
+                    ("pos", pos)("size", log.size));
+
+         fc::datastream<const char*> ds(log.data + pos, log.size - pos);
+         std::pair<signed_block_ptr,uint64_t> result;
+         result.first = std::make_shared<signed_block>();
+         fc::raw::unpack(ds, *result.first);
+         result.second = pos + ds.tellp() + 8;
+         return result;
+      }
+
+      /**
+       *  Finds the start of every block of a block log from its trailing position markers, scanning chunks of
+       *  chunk_size bytes of the file concurrently.
+       *
+       *  Every block is followed by the position it starts at. Each worker looks for the last trailer in its chunk,
+       *  accepting it only if the block it points at unpacks to exactly that trailer, and then follows the markers
+       *  backwards; a block is collected by the worker whose chunk holds its trailer. The stitched list is checked
+       *  against the markers as a whole, an empty optional is returned if it does not hold together.
+       */
+      class block_position_scanner {
+         public:
+            block_position_scanner( const char* data, uint64_t size, uint64_t first_block_start, uint64_t chunk_size )
+            :_data(data), _size(size), _first_block_start(first_block_start), _chunk_size(std::max<uint64_t>(chunk_size, 1)) {}
+
+            optional<vector<uint64_t>> scan( uint32_t threads ) {
+               if( _size < _first_block_start + sizeof(uint64_t) )
+                  return vector<uint64_t>();
+
+               boost::asio::thread_pool pool( threads );
+               vector<std::future<vector<uint64_t>>> chunks;
+               for( uint64_t begin = _first_block_start; begin < _size; begin += _chunk_size ) {
+                  const uint64_t end = std::min( begin + _chunk_size, _size );
+                  chunks.emplace_back( async_thread_pool( pool, [this, begin, end]() { return scan_chunk( begin, end ); } ) );
+               }
+
+               for( auto& c : chunks ) {
+                  while( c.wait_for( std::chrono::seconds(5) ) != std::future_status::ready ) {
+                     ilog( "Scanned ${p}% of block log", ("p", _finished_chunks * 100 / chunks.size()) );
+                  }
+               }
+
+               vector<uint64_t> positions;
+               for( auto& c : chunks ) {
+                  auto chunk = c.get();
+                  positions.insert( positions.end(), chunk.begin(), chunk.end() );
+               }
+               pool.join();
+
+               if( !is_consistent( positions ) )
+                  return optional<vector<uint64_t>>();
+               return positions;
+            }
+
+         private:
+            static constexpr uint64_t max_block_size = 16*1024*1024; ///< bound for plausible trailers, well above any block
+
+            uint64_t read_pos( uint64_t offset )const {
+               uint64_t pos;
+               memcpy( &pos, _data + offset, sizeof(pos) );
+               return pos;
+            }
+
+            bool is_trailer( uint64_t trailer )const {
+               const uint64_t start = read_pos( trailer );
+               if( start < _first_block_start || start >= trailer || trailer - start > max_block_size )
+                  return false;
+               if( start != _first_block_start && read_pos( start - sizeof(uint64_t) ) >= start - sizeof(uint64_t) )
+                  return false;
+               try {
+                  fc::datastream<const char*> ds( _data + start, trailer - start );
+                  signed_block tmp;
+                  fc::raw::unpack( ds, tmp );
+                  return ds.remaining() == 0;
+               } catch( ... ) {
+                  return false;
+               }
+            }
+
+            /// block starts, in order, of the blocks whose trailer lies in [begin, end)
+            vector<uint64_t> scan_chunk( uint64_t begin, uint64_t end ) {
+               auto finished = fc::make_scoped_exit( [this]() { ++_finished_chunks; } );
+               vector<uint64_t> starts;
+
+               // begin is past the first block start, so this never wraps
+               uint64_t trailer = std::min( end, _size - sizeof(uint64_t) + 1 );
+               while( trailer-- > begin ) {
+                  if( is_trailer( trailer ) )
+                     break;
+               }
+               if( trailer < begin )
+                  return starts; // a chunk without trailers only holds part of a block
+
+               for( ;; ) {
+                  const uint64_t start = read_pos( trailer );
+                  if( start < _first_block_start || start >= trailer )
+                     break; // corrupted marker, the gap it leaves fails is_consistent()
+                  starts.push_back( start );
+                  if( start == _first_block_start || start - sizeof(uint64_t) < begin )
+                     break;
+                  trailer = start - sizeof(uint64_t);
+               }
+               std::reverse( starts.begin(), starts.end() );
+               return starts;
+            }
+
+            bool is_consistent( const vector<uint64_t>& positions )const {
+               if( positions.empty() )
+                  return false;
+               if( positions.front() != _first_block_start || read_pos( _size - sizeof(uint64_t) ) != positions.back() )
+                  return false;
+               for( size_t i = 1; i < positions.size(); ++i ) {
+                  if( positions[i] <= positions[i-1] || read_pos( positions[i] - sizeof(uint64_t) ) != positions[i-1] )
+                     return false;
+               }
+               return true;
+            }
+
+            const char*           _data;
+            const uint64_t        _size;
+            const uint64_t        _first_block_start;
+            const uint64_t        _chunk_size;
+            std::atomic<uint32_t> _finished_chunks{0};
+      };
+
+      /**
+       *  A completed part of a split block log, blocks-<first>-<last>.log with its index blocks-<first>-<last>.index.
+       *  Segments never change once they are split off, so readers only need to hold on to them.
+       */
+      struct log_segment {
+         uint32_t        first_block_num = 0;
+         uint32_t        last_block_num = 0;
+         fc::path        block_file;
+         fc::path        index_file;
+         mapped_log_view block_view;
+         mapped_log_view index_view;
+
+         static fc::path file_name( uint32_t first, uint32_t last, const char* ext ) {
+            return fc::path( "blocks-" + std::to_string(first) + "-" + std::to_string(last) + ext );
+         }
+
+         void open( const fc::path& data_dir, uint32_t first, uint32_t last ) {
+            first_block_num = first;
+            last_block_num = last;
+            block_file = data_dir / file_name( first, last, ".log" );
+            index_file = data_dir / file_name( first, last, ".index" );
+            block_view.open( block_file );
+            if( fc::exists( index_file ) && fc::file_size( index_file ) == sizeof(uint64_t) * (last - first + 1) ) {
+               index_view.open( index_file );
+               return;
+            }
+
+            ilog( "Reconstructing index of ${f}", ("f", block_file.generic_string()) );
+            auto log = block_view.view();
+            const auto header = read_log_header( log.data, log.size );
+            EOS_ASSERT( header.first_block_num == first, block_log_exception, "${f} does not start at block ${n}",
+                        ("f", block_file.generic_string())("n", first) );
+            const uint32_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+            auto positions = block_position_scanner( log.data, log.size, header.first_block_start, block_log::index_scan_chunk_size ).scan( threads );
+            EOS_ASSERT( positions && positions->size() == last - first + 1, block_log_exception,
+                        "${f} is corrupted, its blocks do not match its name", ("f", block_file.generic_string()) );
+            {
+               std::ofstream index( index_file.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+               index.exceptions( std::fstream::failbit | std::fstream::badbit );
+               index.write( (const char*)positions->data(), positions->size() * sizeof(uint64_t) );
+            }
+            index_view.open( index_file );
+         }
+
+         uint64_t block_pos( uint32_t block_num )const {
+            auto index = index_view.view();
+            const uint64_t offset = sizeof(uint64_t) * (block_num - first_block_num);
+            EOS_ASSERT( block_num >= first_block_num && offset + sizeof(uint64_t) <= index.size, block_log_exception,
+                        "Block ${n} is not in ${f}", ("n", block_num)("f", block_file.generic_string()) );
+            uint64_t pos;
+            memcpy( &pos, index.data + offset, sizeof(pos) );
+            return pos;
+         }
+
+         signed_block_ptr read_block_by_num( uint32_t block_num )const {
+            return read_block_at( block_view.view(), block_pos( block_num ) ).first;
+         }
+
+         signed_block_ptr read_head()const {
+            return read_block_by_num( last_block_num );
+         }
+      };
+
+      using log_segments = vector<std::shared_ptr<log_segment>>;
+
+      /**
+       *  What readers see of blocks.log. The writer replaces it as a whole whenever it publishes appends or switches
+       *  to a new file, so a reader that loads it once gets an index, first block number and block data that belong
+       *  together even while split_log() runs. It shares ownership of the mappings, which stay valid for as long as
+       *  a reader holds on to it, across any number of splits, reset() or close().
+       */
+      struct published_log {
+         uint32_t      first_block_num = 0;
+         mapped_bytes  blocks;
+         mapped_bytes  index;
+
+         /// position of block_num in blocks, npos if it is not in this log
+         uint64_t block_pos( uint32_t block_num )const {
+            // the published index ends at the head block, so it bounds block_num without touching the head
+            if( block_num < first_block_num )
+               return block_log::npos;
+            const uint64_t offset = sizeof(uint64_t) * (block_num - first_block_num);
+            if( offset + sizeof(uint64_t) > index.size )
+               return block_log::npos;
+            uint64_t pos;
+            memcpy( &pos, index.data + offset, sizeof(pos) );
+            return pos;
+         }
+      };
+
       class block_log_impl {
          public:
             signed_block_ptr         head;
             block_id_type            head_id;
             std::fstream             block_stream;
             std::fstream             index_stream;
+            fc::path                 data_dir;
             fc::path                 block_file;
             fc::path                 index_file;
             bool                     block_write;
             bool                     index_write;
             bool                     genesis_written_to_block_log = false;
             uint32_t                 version = 0;
-            uint32_t                 first_block_num = 0;
+            uint32_t                 first_block_num = 0; ///< of blocks.log, readers use published instead
+            mapped_log_view          block_view;
+            mapped_log_view          index_view;
+            /// replaced as a whole and read with std::atomic_load
+            std::shared_ptr<const published_log> published = std::make_shared<const published_log>();
+
+            uint32_t                 stride = 0;
+            uint32_t                 max_retained_files = 0;
+            fc::path                 archive_dir;
+            /// split off parts of the log, oldest first; replaced as a whole and read with std::atomic_load
+            std::shared_ptr<const log_segments> segments = std::make_shared<const log_segments>();
+
+            std::shared_ptr<log_segment> find_segment( uint32_t block_num )const {
+               auto segs = std::atomic_load( &segments );
+               auto itr = std::upper_bound( segs->begin(), segs->end(), block_num,
+                                            []( uint32_t n, const std::shared_ptr<log_segment>& s ) { return n < s->first_block_num; } );
+               if( itr == segs->begin() || (*--itr)->last_block_num < block_num )
+                  return {};
+               return *itr;
+            }
+
+            void open_segments() {
+               auto segs = std::make_shared<log_segments>();
+               for( boost::filesystem::directory_iterator itr( data_dir ), end; itr != end; ++itr ) {
+                  const auto name = itr->path().filename().generic_string();
+                  unsigned first = 0, last = 0;
+                  int consumed = 0;
+                  if( sscanf( name.c_str(), "blocks-%u-%u.log%n", &first, &last, &consumed ) != 2 || consumed != (int)name.size() )
+                     continue;
+                  EOS_ASSERT( first > 0 && first <= last, block_log_exception, "Unexpected block log file ${f}", ("f", name) );
+                  segs->push_back( std::make_shared<log_segment>() );
+                  segs->back()->open( data_dir, first, last );
+               }
+               std::sort( segs->begin(), segs->end(), []( const auto& a, const auto& b ) { return a->first_block_num < b->first_block_num; } );
+               for( size_t i = 1; i < segs->size(); ++i ) {
+                  EOS_ASSERT( (*segs)[i-1]->last_block_num + 1 == (*segs)[i]->first_block_num, block_log_exception,
+                              "Block log files ${a} and ${b} are not contiguous",
+                              ("a", (*segs)[i-1]->block_file.generic_string())("b", (*segs)[i]->block_file.generic_string()) );
+               }
+               std::atomic_store( &segments, std::shared_ptr<const log_segments>( segs ) );
+            }
+
+            /// moves a segment that is no longer retained out of data_dir, or deletes it without an archive_dir
+            void archive_segment( const log_segment& s ) {
+               for( const auto& file : { s.block_file, s.index_file } ) {
+                  if( archive_dir.empty() ) {
+                     fc::remove( file );
+                     continue;
+                  }
+                  const auto target = archive_dir / file.filename();
+                  try {
+                     fc::rename( file, target );
+                  } catch( ... ) {
+                     // archive_dir may be on another file system
+                     fc::copy( file, target );
+                     fc::remove( file );
+                  }
+               }
+               if( archive_dir.empty() )
+                  ilog( "Removed ${f}", ("f", s.block_file.generic_string()) );
+               else
+                  ilog( "Moved ${f} to ${d}", ("f", s.block_file.generic_string())("d", archive_dir.generic_string()) );
+            }
+
+            /// maps both files again, e.g. after they were recreated
+            void remap() {
+               block_stream.flush();
+               index_stream.flush();
+               block_view.open(block_file);
+               index_view.open(index_file);
+               publish_views();
+            }
+
+            /// makes flushed appends visible to readers
+            void publish() {
+               block_view.publish(fc::file_size(block_file));
+               index_view.publish(fc::file_size(index_file));
+               publish_views();
+            }
+
+            void publish_views() {
+               std::atomic_store(&published, std::make_shared<const published_log>(
+                                                published_log{first_block_num, block_view.view(), index_view.view()}));
+            }
 
             inline void check_block_read() {
                if (block_write) {
@@ -74,10 +479,15 @@ namespace eosio { namespace chain {
       };
    }
 
-   block_log::block_log(const fc::path& data_dir)
+   block_log::block_log(const fc::path& data_dir, uint32_t stride, uint32_t max_retained_files, const fc::path& archive_dir)
    :my(new detail::block_log_impl()) {
       my->block_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
       my->index_stream.exceptions(std::fstream::failbit | std::fstream::badbit);
+      my->stride = stride;
+      my->max_retained_files = max_retained_files;
+      my->archive_dir = archive_dir;
+      if (!archive_dir.empty() && !fc::is_directory(archive_dir))
+         fc::create_directories(archive_dir);
       open(data_dir);
    }
 
@@ -100,14 +510,17 @@ namespace eosio { namespace chain {
 
       if (!fc::is_directory(data_dir))
          fc::create_directories(data_dir);
+      my->data_dir = data_dir;
       my->block_file = data_dir / "blocks.log";
       my->index_file = data_dir / "blocks.index";
+      my->open_segments();
 
       //ilog("Opening block log at ${path}", ("path", my->block_file.generic_string()));
       my->block_stream.open(my->block_file.generic_string().c_str(), LOG_WRITE);
       my->index_stream.open(my->index_file.generic_string().c_str(), LOG_WRITE);
       my->block_write = true;
       my->index_write = true;
+      my->remap();
 
       /* On startup of the block log, there are several states the log file and the index file can be
        * in relation to each other.
@@ -144,15 +557,22 @@ namespace eosio { namespace chain {
 
          my->genesis_written_to_block_log = true; // Assume it was constructed properly.
          if (my->version > 1){
-            my->first_block_num = 0;
-            my->block_stream.read( (char*)&my->first_block_num, sizeof(my->first_block_num) );
-            EOS_ASSERT(my->first_block_num > 0, block_log_exception, "Block log is malformed, first recorded block number is 0 but must be greater than or equal to 1");
+            uint32_t first_block_num = 0;
+            my->block_stream.read( (char*)&first_block_num, sizeof(first_block_num) );
+            EOS_ASSERT(first_block_num > 0, block_log_exception, "Block log is malformed, first recorded block number is 0 but must be greater than or equal to 1");
+            my->first_block_num = first_block_num;
          } else {
             my->first_block_num = 1;
          }
 
+         auto segments = std::atomic_load(&my->segments);
+         EOS_ASSERT(segments->empty() || segments->back()->last_block_num + 1 == my->first_block_num, block_log_exception,
+                    "Block log starts at block ${n} but ${f} ends at block ${l}",
+                    ("n", my->first_block_num)("f", segments->back()->block_file.generic_string())("l", segments->back()->last_block_num));
+
          my->head = read_head();
-         my->head_id = my->head->id();
+         if (my->head)
+            my->head_id = my->head->id();
 
          if (index_size) {
             my->check_block_read();
@@ -178,13 +598,27 @@ namespace eosio { namespace chain {
             ilog("Index is empty");
             construct_index();
          }
-      } else if (index_size) {
-         ilog("Index is nonempty, remove and recreate it");
-         my->index_stream.close();
-         fc::remove_all(my->index_file);
-         my->index_stream.open(my->index_file.generic_string().c_str(), LOG_WRITE);
-         my->index_write = true;
+      } else {
+         if (index_size) {
+            ilog("Index is nonempty, remove and recreate it");
+            my->index_stream.close();
+            fc::remove_all(my->index_file);
+            my->index_stream.open(my->index_file.generic_string().c_str(), LOG_WRITE);
+            my->index_write = true;
+         }
+
+         auto segments = std::atomic_load(&my->segments);
+         if (!segments->empty()) {
+            // interrupted while splitting, continue after the newest split off file
+            const auto& newest = *segments->back();
+            ilog("Starting new block log after ${f}", ("f", newest.block_file.generic_string()));
+            auto log = newest.block_view.view();
+            start_log(detail::read_log_header(log.data, log.size).gs, signed_block_ptr(), newest.last_block_num + 1);
+            my->head = newest.read_head();
+            my->head_id = my->head->id();
+         }
       }
+      my->remap();
    }
 
    uint64_t block_log::append(const signed_block_ptr& b) {
@@ -208,18 +642,73 @@ namespace eosio { namespace chain {
          my->head_id = b->id();
 
          flush();
+         my->publish();
+
+         // version stays 0 while start_log() appends the first block of a new log, which is never split off alone
+         if (my->stride && b->block_num() % my->stride == 0 && my->version > 0)
+            split_log();
 
          return pos;
       }
       FC_LOG_AND_RETHROW()
    }
 
+   void block_log::split_log() {
+      const uint32_t first = my->first_block_num;
+      const uint32_t last = my->head->block_num();
+      auto log = my->block_view.view();
+      const auto gs = detail::read_log_header(log.data, log.size).gs;
+
+      my->block_stream.close();
+      my->index_stream.close();
+      auto segment = std::make_shared<detail::log_segment>();
+      fc::rename(my->index_file, my->data_dir / detail::log_segment::file_name(first, last, ".index"));
+      fc::rename(my->block_file, my->data_dir / detail::log_segment::file_name(first, last, ".log"));
+      segment->open(my->data_dir, first, last);
+
+      auto segments = std::make_shared<detail::log_segments>(*std::atomic_load(&my->segments));
+      segments->push_back(segment);
+      detail::log_segments expired;
+      while (segments->size() > my->max_retained_files) {
+         expired.push_back(segments->front());
+         segments->erase(segments->begin());
+      }
+
+      // readers find the split off blocks before blocks.log stops serving them
+      std::atomic_store(&my->segments, std::shared_ptr<const detail::log_segments>(segments));
+      my->block_view.retire();
+      my->index_view.retire();
+      my->publish_views();
+      ilog("Split off blocks ${first} to ${last} into ${f}", ("first", first)("last", last)("f", segment->block_file.generic_string()));
+
+      start_log(gs, signed_block_ptr(), last + 1);
+
+      for (const auto& s : expired)
+         my->archive_segment(*s);
+   }
+
    void block_log::flush() {
       my->block_stream.flush();
       my->index_stream.flush();
    }
 
    void block_log::reset( const genesis_state& gs, const signed_block_ptr& first_block, uint32_t first_block_num ) {
+      my->block_view.close();
+      my->index_view.close();
+      my->publish_views();
+
+      // split off files end before the new first block, they do not belong to the new log
+      auto segments = std::atomic_load(&my->segments);
+      std::atomic_store(&my->segments, std::make_shared<const detail::log_segments>());
+      for (const auto& s : *segments) {
+         fc::remove(s->block_file);
+         fc::remove(s->index_file);
+      }
+
+      start_log(gs, first_block, first_block_num);
+   }
+
+   void block_log::start_log( const genesis_state& gs, const signed_block_ptr& first_block, uint32_t first_block_num ) {
       if (my->block_stream.is_open())
          my->block_stream.close();
       if (my->index_stream.is_open())
@@ -237,7 +726,7 @@ namespace eosio { namespace chain {
       my->version = 0; // version of 0 is invalid; it indicates that the genesis was not properly written to the block log
       my->first_block_num = first_block_num;
       my->block_stream.write((char*)&my->version, sizeof(my->version));
-      my->block_stream.write((char*)&my->first_block_num, sizeof(my->first_block_num));
+      my->block_stream.write((char*)&first_block_num, sizeof(first_block_num));
       my->block_stream.write(data.data(), data.size());
       my->genesis_written_to_block_log = true;
 
@@ -263,25 +752,24 @@ namespace eosio { namespace chain {
 
       my->block_write = false;
       my->check_block_write(); // Reset to append-only writing.
+      my->remap();
    }
 
    std::pair<signed_block_ptr, uint64_t> block_log::read_block(uint64_t pos)const {
-      my->check_block_read();
-
-      my->block_stream.seekg(pos);
-      std::pair<signed_block_ptr,uint64_t> result;
-      result.first = std::make_shared<signed_block>();
-      fc::raw::unpack(my->block_stream, *result.first);
-      result.second = uint64_t(my->block_stream.tellg()) + 8;
-      return result;
+      return detail::read_block_at(std::atomic_load(&my->published)->blocks, pos);
    }
 
    signed_block_ptr block_log::read_block_by_num(uint32_t block_num)const {
       try {
          signed_block_ptr b;
-         uint64_t pos = get_block_pos(block_num);
-         if (pos != npos) {
-            b = read_block(pos).first;
+         auto log = std::atomic_load(&my->published);
+         uint64_t pos = log->block_pos(block_num);
+         if (pos == npos) {
+            // checked after blocks.log, which only stops serving blocks once they can be found here
+            if (auto segment = my->find_segment(block_num))
+               b = segment->read_block_by_num(block_num);
+         } else {
+            b = detail::read_block_at(log->blocks, pos).first;
             EOS_ASSERT(b->block_num() == block_num, reversible_blocks_exception,
                       "Wrong block was read from block log.", ("returned", b->block_num())("expected", block_num));
          }
@@ -290,32 +778,30 @@ namespace eosio { namespace chain {
    }
 
    uint64_t block_log::get_block_pos(uint32_t block_num) const {
-      my->check_index_read();
-      if (!(my->head && block_num <= block_header::num_from_id(my->head_id) && block_num >= my->first_block_num))
-         return npos;
-      my->index_stream.seekg(sizeof(uint64_t) * (block_num - my->first_block_num));
-      uint64_t pos;
-      my->index_stream.read((char*)&pos, sizeof(pos));
+      uint64_t pos = std::atomic_load(&my->published)->block_pos(block_num);
+      if (pos == npos) {
+         if (auto segment = my->find_segment(block_num))
+            pos = segment->block_pos(block_num);
+      }
       return pos;
    }
 
    signed_block_ptr block_log::read_head()const {
-      my->check_block_read();
+      auto log = my->block_view.view();
 
-      uint64_t pos;
+      uint64_t pos = npos;
 
       // Check that the file is not empty
-      my->block_stream.seekg(0, std::ios::end);
-      if (my->block_stream.tellg() <= sizeof(pos))
-         return {};
-
-      my->block_stream.seekg(-sizeof(pos), std::ios::end);
-      my->block_stream.read((char*)&pos, sizeof(pos));
-      if (pos != npos) {
+      if (log.size > sizeof(pos))
+         memcpy(&pos, log.data + log.size - sizeof(pos), sizeof(pos));
+      if (pos != npos)
          return read_block(pos).first;
-      } else {
-         return {};
-      }
+
+      // blocks.log has no blocks right after it was split
+      auto segments = std::atomic_load(&my->segments);
+      if (!segments->empty())
+         return segments->back()->read_head();
+      return {};
    }
 
    const signed_block_ptr& block_log::head()const {
@@ -323,7 +809,8 @@ namespace eosio { namespace chain {
    }
 
    uint32_t block_log::first_block_num() const {
-      return my->first_block_num;
+      auto segments = std::atomic_load(&my->segments);
+      return segments->empty() ? std::atomic_load(&my->published)->first_block_num : segments->front()->first_block_num;
    }
 
    void block_log::construct_index() {
@@ -333,11 +820,29 @@ namespace eosio { namespace chain {
       my->index_stream.open(my->index_file.generic_string().c_str(), LOG_WRITE);
       my->index_write = true;
 
-      uint64_t end_pos;
+      const auto start_time = fc::time_point::now();
+      auto log = my->block_view.view();
+
+      const uint64_t first_block_start = detail::read_log_header(log.data, log.size).first_block_start;
+
+      const uint32_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+      auto positions = detail::block_position_scanner(log.data, log.size, first_block_start, index_scan_chunk_size).scan(threads);
+      if (positions) {
+         my->index_stream.write((const char*)positions->data(), positions->size() * sizeof(uint64_t));
+         my->index_stream.flush();
+
+         const auto elapsed = std::max<int64_t>((fc::time_point::now() - start_time).count(), 1);
+         ilog("Reconstructed index of ${n} blocks using ${t} threads in ${ms} ms (${mbps} MiB/s)",
+              ("n", positions->size())("t", threads)("ms", elapsed / 1000)
+              ("mbps", log.size * 1000000 / elapsed / (1024*1024)));
+         return;
+      }
+      wlog("Block log trailers are inconsistent, reconstructing index sequentially");
+
+      // the trailers cannot be trusted, positions are taken from where each block is actually read
+      const uint64_t end_pos = log.size;
       my->check_block_read();
 
-      my->block_stream.seekg(-sizeof( uint64_t), std::ios::end);
-      my->block_stream.read((char*)&end_pos, sizeof(end_pos));
       signed_block tmp;
 
       uint64_t pos = 0;
@@ -357,11 +862,14 @@ namespace eosio { namespace chain {
          my->block_stream.read((char*) &totem, sizeof(totem));
       }
 
+      pos = my->block_stream.tellg();
       while( pos < end_pos ) {
          fc::raw::unpack(my->block_stream, tmp);
-         my->block_stream.read((char*)&pos, sizeof(pos));
          my->index_stream.write((char*)&pos, sizeof(pos));
+         my->block_stream.seekg(sizeof(uint64_t), std::ios::cur);
+         pos = my->block_stream.tellg();
       }
+      my->index_stream.flush();
    } // construct_index
 
    fc::path block_log::repair_log( const fc::path& data_dir, uint32_t truncate_at_block ) {
@@ -0,0 +1,259 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#include <eosio/chain/compressed_block_log.hpp>
+#include <eosio/chain/block_log.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <fstream>
+#include <mutex>
+#include <fc/io/raw.hpp>
+#include <fc/scoped_exit.hpp>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+
+namespace eosio { namespace chain {
+
+   const uint32_t compressed_block_log::version = 1;
+   const uint32_t compressed_block_log::default_blocks_per_chunk = 256;
+
+   namespace detail {
+      namespace bio = boost::iostreams;
+      namespace bip = boost::interprocess;
+
+      static const uint64_t footer_size = sizeof(uint64_t) + sizeof(uint32_t);
+
+      static bytes zlib_compress_chunk( const bytes& data ) {
+         bytes out;
+         bio::filtering_ostream comp;
+         comp.push(bio::zlib_compressor(bio::zlib::best_compression));
+         comp.push(bio::back_inserter(out));
+         bio::write(comp, data.data(), data.size());
+         bio::close(comp);
+         return out;
+      }
+
+      static bytes zlib_decompress_chunk( const char* data, size_t size ) {
+         bytes out;
+         bio::filtering_ostream decomp;
+         decomp.push(bio::zlib_decompressor());
+         decomp.push(bio::back_inserter(out));
+         bio::write(decomp, data, size);
+         bio::close(decomp);
+         return out;
+      }
+
+      class compressed_block_log_impl {
+         public:
+            bip::file_mapping  file;
+            bip::mapped_region region;
+            const char*        data = nullptr;
+            uint64_t           size = 0;
+
+            uint32_t           first_block_num = 0;
+            uint32_t           blocks_per_chunk = 0;
+            uint32_t           num_blocks = 0;
+            genesis_state      genesis;
+            vector<uint64_t>   chunk_positions;
+            uint64_t           index_pos = 0;
+
+            /// the most recently decompressed chunk, which makes sequential reads cheap
+            std::mutex                    cache_lock;
+            uint32_t                      cached_chunk = std::numeric_limits<uint32_t>::max();
+            std::shared_ptr<const bytes>  cached_data;
+
+            std::shared_ptr<const bytes> get_chunk( uint32_t chunk ) {
+               {
+                  std::lock_guard<std::mutex> g(cache_lock);
+                  if( chunk == cached_chunk )
+                     return cached_data;
+               }
+               const uint64_t begin = chunk_positions[chunk];
+               const uint64_t end = chunk + 1 < chunk_positions.size() ? chunk_positions[chunk + 1] : index_pos;
+               EOS_ASSERT( begin < end && end <= index_pos, block_log_exception, "Compressed block log chunk ${c} is malformed", ("c", chunk) );
+               auto result = std::make_shared<const bytes>( zlib_decompress_chunk( data + begin, end - begin ) );
+
+               std::lock_guard<std::mutex> g(cache_lock);
+               cached_chunk = chunk;
+               cached_data = result;
+               return result;
+            }
+      };
+   }
+
+   compressed_block_log::compressed_block_log( const fc::path& file )
+   :my( new detail::compressed_block_log_impl() ) {
+      EOS_ASSERT( fc::is_regular_file(file), block_log_not_found, "Compressed block log ${f} not found", ("f", file.generic_string()) );
+      my->size = fc::file_size(file);
+      EOS_ASSERT( my->size > detail::footer_size, block_log_exception, "Compressed block log ${f} is too small", ("f", file.generic_string()) );
+
+      my->file = detail::bip::file_mapping( file.generic_string().c_str(), detail::bip::read_only );
+      my->region = detail::bip::mapped_region( my->file, detail::bip::read_only );
+      my->data = static_cast<const char*>( my->region.get_address() );
+
+      fc::datastream<const char*> header( my->data, my->size );
+      uint32_t file_version = 0;
+      fc::raw::unpack( header, file_version );
+      EOS_ASSERT( file_version == version, block_log_unsupported_version,
+                  "Unsupported version of compressed block log. Version is ${v} while code supports version ${s}",
+                  ("v", file_version)("s", version) );
+      fc::raw::unpack( header, my->first_block_num );
+      fc::raw::unpack( header, my->blocks_per_chunk );
+      fc::raw::unpack( header, my->genesis );
+      EOS_ASSERT( my->blocks_per_chunk > 0, block_log_exception, "Compressed block log has no blocks per chunk" );
+
+      fc::datastream<const char*> footer( my->data + my->size - detail::footer_size, detail::footer_size );
+      fc::raw::unpack( footer, my->index_pos );
+      fc::raw::unpack( footer, my->num_blocks );
+      EOS_ASSERT( my->index_pos >= header.tellp() && my->index_pos < my->size - detail::footer_size, block_log_exception,
+                  "Compressed block log chunk index is out of range" );
+
+      fc::datastream<const char*> index( my->data + my->index_pos, my->size - detail::footer_size - my->index_pos );
+      fc::raw::unpack( index, my->chunk_positions );
+      EOS_ASSERT( my->chunk_positions.size() == (my->num_blocks + my->blocks_per_chunk - 1) / my->blocks_per_chunk,
+                  block_log_exception, "Compressed block log chunk index does not match its number of blocks" );
+   }
+
+   compressed_block_log::compressed_block_log( compressed_block_log&& other ) {
+      my = std::move(other.my);
+   }
+
+   compressed_block_log::~compressed_block_log() {}
+
+   signed_block_ptr compressed_block_log::read_block_by_num( uint32_t block_num )const {
+      try {
+         if( block_num < my->first_block_num || block_num - my->first_block_num >= my->num_blocks )
+            return signed_block_ptr();
+
+         const uint32_t n = block_num - my->first_block_num;
+         auto chunk = my->get_chunk( n / my->blocks_per_chunk );
+         const uint32_t i = n % my->blocks_per_chunk;
+
+         fc::datastream<const char*> ds( chunk->data(), chunk->size() );
+         uint32_t count = 0;
+         fc::raw::unpack( ds, count );
+         EOS_ASSERT( i < count, block_log_exception, "Block ${n} is missing from its compressed chunk", ("n", block_num) );
+         ds.skip( sizeof(uint32_t) * i );
+         uint32_t offset = 0;
+         fc::raw::unpack( ds, offset );
+         EOS_ASSERT( offset < chunk->size(), block_log_exception, "Block ${n} is outside of its compressed chunk", ("n", block_num) );
+
+         fc::datastream<const char*> block_ds( chunk->data() + offset, chunk->size() - offset );
+         auto b = std::make_shared<signed_block>();
+         fc::raw::unpack( block_ds, *b );
+         EOS_ASSERT( b->block_num() == block_num, block_log_exception,
+                     "Wrong block was read from compressed block log.", ("returned", b->block_num())("expected", block_num) );
+         return b;
+      } FC_LOG_AND_RETHROW()
+   }
+
+   uint32_t compressed_block_log::first_block_num()const {
+      return my->first_block_num;
+   }
+
+   uint32_t compressed_block_log::last_block_num()const {
+      return my->first_block_num + my->num_blocks - 1;
+   }
+
+   const genesis_state& compressed_block_log::genesis()const {
+      return my->genesis;
+   }
+
+   void compressed_block_log::construct( const fc::path& blocks_dir, const fc::path& file, uint32_t blocks_per_chunk ) {
+      EOS_ASSERT( blocks_per_chunk > 0, block_log_exception, "blocks_per_chunk must be greater than 0" );
+      const auto gs = block_log::extract_genesis_state( blocks_dir );
+      block_log log( blocks_dir );
+      const auto head = log.head();
+      EOS_ASSERT( head, block_log_exception, "No blocks found in block log" );
+      const uint32_t first = log.first_block_num();
+      const uint32_t last = head->block_num();
+
+      // written next to the target and renamed once complete, so an interrupted run never leaves a partial archive
+      const fc::path tmp_file = file.generic_string() + ".tmp";
+      bool complete = false;
+      auto remove_tmp = fc::make_scoped_exit( [&]() {
+         if( !complete ) {
+            try { fc::remove( tmp_file ); } catch( ... ) {}
+         }
+      } );
+
+      std::ofstream out( tmp_file.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+      out.exceptions( std::fstream::failbit | std::fstream::badbit );
+
+      auto header = fc::raw::pack( version );
+      out.write( header.data(), header.size() );
+      header = fc::raw::pack( first );
+      out.write( header.data(), header.size() );
+      header = fc::raw::pack( blocks_per_chunk );
+      out.write( header.data(), header.size() );
+      header = fc::raw::pack( gs );
+      out.write( header.data(), header.size() );
+
+      vector<uint64_t> chunk_positions;
+      uint32_t chunk_first = first;
+      while( chunk_first <= last ) {
+         const uint32_t count = std::min( blocks_per_chunk, last - chunk_first + 1 );
+         vector<vector<char>> packed_blocks;
+         packed_blocks.reserve( count );
+         size_t blocks_size = 0;
+         for( uint32_t num = chunk_first; num < chunk_first + count; ++num ) {
+            auto b = log.read_block_by_num( num );
+            EOS_ASSERT( b, block_log_exception, "Block ${n} is missing from block log", ("n", num) );
+            packed_blocks.emplace_back( fc::raw::pack( *b ) );
+            blocks_size += packed_blocks.back().size();
+         }
+
+         bytes plain( sizeof(uint32_t) * (count + 1) + blocks_size );
+         fc::datastream<char*> ds( plain.data(), plain.size() );
+         fc::raw::pack( ds, count );
+         uint32_t offset = sizeof(uint32_t) * (count + 1);
+         for( const auto& p : packed_blocks ) {
+            fc::raw::pack( ds, offset );
+            offset += p.size();
+         }
+         for( const auto& p : packed_blocks )
+            ds.write( p.data(), p.size() );
+
+         chunk_positions.push_back( out.tellp() );
+         auto compressed = detail::zlib_compress_chunk( plain );
+         out.write( compressed.data(), compressed.size() );
+
+         chunk_first += count;
+         if( chunk_positions.size() % 1000 == 0 )
+            ilog( "Compressed block log up to block ${n} of ${last}", ("n", chunk_first - 1)("last", last) );
+         if( count < blocks_per_chunk )
+            break;
+      }
+
+      const uint64_t index_pos = out.tellp();
+      auto index = fc::raw::pack( chunk_positions );
+      out.write( index.data(), index.size() );
+      auto footer = fc::raw::pack( index_pos );
+      out.write( footer.data(), footer.size() );
+      footer = fc::raw::pack( last - first + 1 );
+      out.write( footer.data(), footer.size() );
+      out.close();
+
+      fc::rename( tmp_file, file );
+      complete = true;
+   }
+
+   void compressed_block_log::extract( const fc::path& file, const fc::path& blocks_dir ) {
+      EOS_ASSERT( !fc::exists( blocks_dir / "blocks.log" ), block_log_exception,
+                  "Block log already exists in '${blocks_dir}'", ("blocks_dir", blocks_dir) );
+
+      compressed_block_log archive( file );
+      block_log log( blocks_dir );
+      log.reset( archive.genesis(), archive.read_block_by_num( archive.first_block_num() ), archive.first_block_num() );
+      for( uint32_t num = archive.first_block_num() + 1; num <= archive.last_block_num(); ++num ) {
+         auto b = archive.read_block_by_num( num );
+         EOS_ASSERT( b, block_log_exception, "Block ${n} is missing from compressed block log", ("n", num) );
+         log.append( b );
+      }
+   }
+
+} } /// eosio::chain
@@ -13,11 +13,14 @@
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/transaction_object.hpp>
 #include <eosio/chain/reversible_block_object.hpp>
+#include <eosio/chain/database_header_object.hpp>
 
 #include <eosio/chain/authorization_manager.hpp>
 #include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/chain_snapshot.hpp>
+#include <eosio/chain/contract_table_snapshot.hpp>
 #include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/signature_recovery_cache.hpp>
 
 #include <chainbase/chainbase.hpp>
 #include <fc/io/json.hpp>
@@ -55,7 +58,7 @@ class maybe_session
    maybe_session() = default;
 
    maybe_session(maybe_session &&other)
-       : _session(move(other._session))
+       : _session(move(other._session)), _usage_session(move(other._usage_session))
    {
    }
 
@@ -64,24 +67,37 @@ class maybe_session
       _session = db.start_undo_session(true);
    }
 
+   /// also scopes the account usage that resource_limits_manager accumulates in memory
+   maybe_session(database &db, resource_limits_manager &rl)
+   {
+      _session = db.start_undo_session(true);
+      _usage_session = rl.start_usage_session();
+   }
+
    maybe_session(const maybe_session &) = delete;
 
    void squash()
    {
       if (_session)
          _session->squash();
+      if (_usage_session)
+         _usage_session->squash();
    }
 
    void undo()
    {
       if (_session)
          _session->undo();
+      if (_usage_session)
+         _usage_session->undo();
    }
 
    void push()
    {
       if (_session)
          _session->push();
+      if (_usage_session)
+         _usage_session->squash();
    }
 
    maybe_session &operator=(maybe_session &&mv)
@@ -96,11 +112,22 @@ class maybe_session
          _session.reset();
       }
 
+      if (mv._usage_session)
+      {
+         _usage_session = move(*mv._usage_session);
+         mv._usage_session.reset();
+      }
+      else
+      {
+         _usage_session.reset();
+      }
+
       return *this;
    };
 
  private:
    optional<database::session> _session;
+   optional<resource_limits_manager::usage_session> _usage_session;
 };
 
 struct pending_state
@@ -114,6 +141,8 @@ struct pending_state
 
    vector<action_receipt> _actions;
 
+   vector<transaction_access_set> _access_sets; ///< parallel to the block's transaction receipts, only filled when analyzing conflicts
+
    controller::block_status _block_status = controller::block_status::incomplete;
 
    optional<block_id_type> _producer_block_id;
@@ -147,6 +176,18 @@ struct controller_impl
    uint32_t snapshot_head_block = 0;
    boost::asio::thread_pool thread_pool;  // 线程池
 
+   /**
+    *  Transactions of blocks that have been received or read ahead but not yet applied. Unpacking, id calculation
+    *  and signature recovery for these run on the thread pool while the current head block is executed, apply_block
+    *  consumes the prepared entry for its block (if any) instead of doing that work inline.
+    */
+   struct prepared_block
+   {
+      std::shared_future<void>                             signee_validated; ///< not valid when the signee is not checked
+      std::shared_future<vector<transaction_metadata_ptr>> transactions;
+   };
+   map<block_id_type, prepared_block> prepared_block_transactions;
+
    typedef pair<scope_name, action_name> handler_key;
    map<account_name, map<handler_key, apply_handler>> apply_handlers;  
 
@@ -175,6 +216,8 @@ struct controller_impl
       }
       head = prev;
       db.undo();
+      authorization.clear_authority_cache();
+      resource_limits.clear_pending_usage();
    }
 
    void set_apply_handler(account_name receiver, account_name contract, action_name action, apply_handler v)
@@ -190,9 +233,9 @@ struct controller_impl
          reversible_blocks(cfg.blocks_dir / config::reversible_blocks_dir_name,
                            cfg.read_only ? database::read_only : database::read_write,
                            cfg.reversible_cache_size),
-         blog(cfg.blocks_dir),
+         blog(cfg.blocks_dir, cfg.blocks_log_stride, cfg.max_retained_block_files, cfg.blocks_archive_dir),
          fork_db(cfg.state_dir),
-         wasmif(cfg.wasm_runtime),
+         wasmif(cfg.wasm_runtime, cfg.wasm_cache_max_modules, cfg.wasm_cache_max_size),
          resource_limits(db),
          authorization(s, db),
          conf(cfg),
@@ -222,6 +265,8 @@ struct controller_impl
       fork_db.irreversible.connect([&](auto b) {
          on_irreversible(b);
       });
+
+      signature_recovery_cache::instance().set_capacity(cfg.sig_cache_size);
    }
 
    /**
@@ -294,6 +339,15 @@ struct controller_impl
 
       db.commit(s->block_num);
 
+      // drop prepared transactions of blocks that can no longer be applied
+      for (auto itr = prepared_block_transactions.begin(); itr != prepared_block_transactions.end();)
+      {
+         if (block_header::num_from_id(itr->first) <= s->block_num && !(read_mode == db_read_mode::IRREVERSIBLE && itr->first == s->id))
+            itr = prepared_block_transactions.erase(itr);
+         else
+            ++itr;
+      }
+
       if (append_to_blog)
       {
          blog.append(s->block);
@@ -349,8 +403,30 @@ struct controller_impl
            ("s", start_block_num)("n", blog_head->block_num()));
 
       auto start = fc::time_point::now();
-      while (auto next = blog.read_block_by_num(head->block_num + 1))
+
+      // keep the next few blocks read ahead so their transactions are prepared on the thread pool
+      // while the current block is being executed on this thread
+      std::deque<signed_block_ptr> lookahead;
+      uint32_t next_read_num = start_block_num;
+      auto fill_lookahead = [&]() {
+         while (lookahead.size() <= config::replay_block_lookahead)
+         {
+            auto b = blog.read_block_by_num(next_read_num);
+            if (!b)
+               break;
+            ++next_read_num;
+            prepare_block_transactions(b, conf.force_all_checks);
+            lookahead.emplace_back(std::move(b));
+         }
+      };
+
+      fill_lookahead();
+      while (!lookahead.empty())
       {
+         auto next = lookahead.front();
+         lookahead.pop_front();
+         fill_lookahead();
+
          replay_push_block(next, controller::block_status::irreversible);
          if (next->block_num() % 100 == 0)
          {
@@ -360,6 +436,7 @@ struct controller_impl
          }
       }
       std::cerr << "\n";
+      prepared_block_transactions.clear();
       ilog("${n} blocks replayed", ("n", head->block_num - start_block_num));
 
       // if the irreverible log is played without undo sessions enabled, we need to sync the
@@ -415,6 +492,9 @@ struct controller_impl
             initialize_fork_db(); // set head to genesis state
          }
 
+         // nothing may read the state before it is known to have the layout of this build
+         validate_database_version();
+
          auto end = blog.read_head();
          if (!end)
          {
@@ -479,6 +559,7 @@ struct controller_impl
    {
       reversible_blocks.add_index<reversible_block_index>();
 
+      db.add_index<database_header_multi_index>();
       controller_index_set::add_indices(db);
       contract_database_index_set::add_indices(db);
 
@@ -499,35 +580,168 @@ struct controller_impl
       });
    }
 
+   template<typename Section>
+   void add_contract_table_to_snapshot(Section &section, const table_id_object &table_row) const
+   {
+      // add a row for the table
+      section.add_row(table_row, db);
+
+      // followed by a size row and then N data rows for each type of table
+      contract_database_index_set::walk_indices([this, &section, &table_row](auto utils) {
+         using utils_t = decltype(utils);
+         using value_t = typename decltype(utils)::index_t::value_type;
+         using by_table_id = object_to_table_id_tag_t<value_t>;
+
+         auto tid_key = boost::make_tuple(table_row.id);
+         auto next_tid_key = boost::make_tuple(table_id_object::id_type(table_row.id._id + 1));
+
+         unsigned_int size = utils_t::template size_range<by_table_id>(db, tid_key, next_tid_key);
+         section.add_row(size, db);
+
+         utils_t::template walk_range<by_table_id>(db, tid_key, next_tid_key, [this, &section](const auto &row) {
+            section.add_row(row, db);
+         });
+      });
+   }
+
+   /**
+    *  Contract tables are cut into sections of whole tables holding about this many primary rows, which are
+    *  serialized and decoded on the thread pool
+    */
+   static constexpr uint64_t snapshot_contract_table_shard_rows = 64 * 1024;
+
+   using contract_table_shard = std::pair<table_id_object::id_type, table_id_object::id_type>;
+
+   vector<contract_table_shard> contract_table_shards() const
+   {
+      vector<contract_table_shard> shards;
+      uint64_t shard_rows = 0;
+      index_utils<table_id_multi_index>::walk(db, [&shards, &shard_rows](const table_id_object &table_row) {
+         if (shards.empty() || shard_rows >= snapshot_contract_table_shard_rows)
+         {
+            shards.emplace_back(table_row.id, table_row.id);
+            shard_rows = 0;
+         }
+         shards.back().second = table_id_object::id_type(table_row.id._id + 1);
+         shard_rows += table_row.count + 1;
+      });
+      return shards;
+   }
+
+   template<typename Section>
+   void add_contract_table_shard_to_snapshot(Section &section, const contract_table_shard &shard) const
+   {
+      index_utils<table_id_multi_index>::walk_range<by_id>(db, shard.first, shard.second, [this, &section](const table_id_object &table_row) {
+         add_contract_table_to_snapshot(section, table_row);
+      });
+   }
+
    void add_contract_tables_to_snapshot(const snapshot_writer_ptr &snapshot) const
    {
-      snapshot->write_section("contract_tables", [this](auto &section) {
-         index_utils<table_id_multi_index>::walk(db, [this, &section](const table_id_object &table_row) {
-            // add a row for the table
-            section.add_row(table_row, db);
+      auto shards = contract_table_shards();
 
-            // followed by a size row and then N data rows for each type of table
-            contract_database_index_set::walk_indices([this, &section, &table_row](auto utils) {
-               using utils_t = decltype(utils);
-               using value_t = typename decltype(utils)::index_t::value_type;
-               using by_table_id = object_to_table_id_tag_t<value_t>;
+      vector<string> section_names;
+      for (size_t i = 0; i < shards.size(); ++i)
+      {
+         section_names.emplace_back(contract_table_shard_name(i));
+      }
+
+      // sections are serialized concurrently, only reading the database
+      const size_t max_pending = 2 * std::max<uint32_t>(conf.thread_pool_size, 1);
+      snapshot->write_sections(section_names, [this, &shards](size_t i, auto &section) {
+         add_contract_table_shard_to_snapshot(section, shards[i]);
+      }, thread_pool, max_pending);
+   }
 
-               auto tid_key = boost::make_tuple(table_row.id);
-               auto next_tid_key = boost::make_tuple(table_id_object::id_type(table_row.id._id + 1));
+   using snapshot_contract_tables = vector<snapshot_contract_table<contract_database_index_set>>;
 
-               unsigned_int size = utils_t::template size_range<by_table_id>(db, tid_key, next_tid_key);
-               section.add_row(size, db);
+   static snapshot_contract_tables decode_contract_tables(snapshot_reader::section_reader &section)
+   {
+      snapshot_contract_tables tables;
+      bool more = !section.empty();
+      while (more)
+      {
+         // read the row for the table
+         tables.emplace_back();
+         auto &table = tables.back();
+         section.read_row(table.table);
+
+         // read the size and data rows for each type of table
+         contract_database_index_set::walk_indices([&section, &table, &more](auto utils) {
+            using value_t = typename decltype(utils)::index_t::value_type;
+            auto &rows = std::get<vector<snapshot_contract_row<value_t>>>(table.rows);
+
+            unsigned_int size;
+            more = section.read_row(size);
+
+            for (size_t idx = 0; idx < size.value; idx++)
+            {
+               rows.emplace_back();
+               more = section.read_row(rows.back());
+            }
+         });
+      }
+      return tables;
+   }
+
+   uint64_t create_contract_tables(const snapshot_contract_tables &tables)
+   {
+      uint64_t created = 0;
+      for (const auto &table : tables)
+      {
+         table_id_object::id_type t_id;
+         index_utils<table_id_multi_index>::create(db, [&table, &t_id](auto &row) {
+            row.code = table.table.code;
+            row.scope = table.table.scope;
+            row.table = table.table.table;
+            row.payer = table.table.payer;
+            row.count = table.table.count;
+            t_id = row.id;
+         });
+
+         contract_database_index_set::walk_indices([this, &table, &t_id, &created](auto utils) {
+            using utils_t = decltype(utils);
+            using value_t = typename utils_t::index_t::value_type;
 
-               utils_t::template walk_range<by_table_id>(db, tid_key, next_tid_key, [this, &section](const auto &row) {
-                  section.add_row(row, db);
+            const auto &rows = std::get<vector<snapshot_contract_row<value_t>>>(table.rows);
+            for (const auto &value : rows)
+            {
+               utils_t::create(db, [&value, &t_id](auto &row) {
+                  row.t_id = t_id;
+                  assign_snapshot_row(row, value);
                });
-            });
+            }
+            created += rows.size();
          });
-      });
+      }
+      return created;
    }
 
    void read_contract_tables_from_snapshot(const snapshot_reader_ptr &snapshot)
    {
+      if (!snapshot->has_section("contract_tables"))
+      {
+         vector<string> section_names;
+         while (snapshot->has_section(contract_table_shard_name(section_names.size())))
+         {
+            section_names.emplace_back(contract_table_shard_name(section_names.size()));
+         }
+
+         // sections are decoded on the thread pool while the previous ones are created in the database
+         const size_t max_pending = 2 * std::max<uint32_t>(conf.thread_pool_size, 1);
+         snapshot->read_sections(section_names, [](size_t, auto &section) {
+            return decode_contract_tables(section);
+         }, [this, &section_names](size_t i, snapshot_contract_tables tables) {
+            auto start = fc::time_point::now();
+            auto rows = create_contract_tables(tables);
+            ilog("Loaded snapshot section ${name}: ${tables} tables, ${rows} rows in ${ms} ms",
+                 ("name", section_names[i])("tables", tables.size())("rows", rows)
+                 ("ms", (fc::time_point::now() - start).count() / 1000));
+         }, thread_pool, max_pending);
+         return;
+      }
+
+      // version 1 snapshots hold every contract table in a single section
       snapshot->read_section("contract_tables", [this](auto &section) {
          bool more = !section.empty();
          while (more)
@@ -558,7 +772,7 @@ struct controller_impl
       });
    }
 
-   void add_to_snapshot(const snapshot_writer_ptr &snapshot) const
+   void add_chain_state_to_snapshot(const snapshot_writer_ptr &snapshot) const
    {
       snapshot->write_section<chain_snapshot_header>([this](auto &section) {
          section.add_row(chain_snapshot_header(), db);
@@ -571,6 +785,23 @@ struct controller_impl
       snapshot->write_section<block_state>([this](auto &section) {
          section.template add_row<block_header_state>(*fork_db.head(), db);
       });
+   }
+
+   template<typename Utils>
+   void add_index_to_snapshot(const snapshot_writer_ptr &snapshot) const
+   {
+      using value_t = typename Utils::index_t::value_type;
+
+      snapshot->write_section<value_t>([this](auto &section) {
+         Utils::walk(db, [this, &section](const auto &row) {
+            section.add_row(row, db);
+         });
+      });
+   }
+
+   void add_to_snapshot(const snapshot_writer_ptr &snapshot) const
+   {
+      add_chain_state_to_snapshot(snapshot);
 
       controller_index_set::walk_indices([this, &snapshot](auto utils) {
          using value_t = typename decltype(utils)::index_t::value_type;
@@ -581,11 +812,7 @@ struct controller_impl
             return;
          }
 
-         snapshot->write_section<value_t>([this](auto &section) {
-            decltype(utils)::walk(db, [this, &section](const auto &row) {
-               section.add_row(row, db);
-            });
-         });
+         add_index_to_snapshot<decltype(utils)>(snapshot);
       });
 
       add_contract_tables_to_snapshot(snapshot);
@@ -639,6 +866,9 @@ struct controller_impl
       authorization.read_from_snapshot(snapshot);
       resource_limits.read_from_snapshot(snapshot);
 
+      // the header is not part of snapshots, the state now has the layout of this build
+      db.create<database_header_object>([](auto &) {});
+
       db.set_revision(head->block_num);
    }
 
@@ -652,6 +882,74 @@ struct controller_impl
       return enc.result();
    }
 
+   /**
+    *  Version 2 of the integrity hash: the sections of a snapshot, with indexes larger than
+    *  snapshot_contract_table_shard_rows cut into several, hashed independently on the thread pool while only reading
+    *  the database, and combined in snapshot order into a merkle root
+    */
+   sha256 calculate_integrity_tree_hash() const
+   {
+      vector<snapshot_part> parts;
+
+      parts.emplace_back([this](const snapshot_writer_ptr &snapshot) {
+         add_chain_state_to_snapshot(snapshot);
+      });
+
+      controller_index_set::walk_indices([this, &parts](auto utils) {
+         using value_t = typename decltype(utils)::index_t::value_type;
+
+         // skip the table_id_object as its inlined with contract tables section
+         if (std::is_same<value_t, table_id_object>::value)
+         {
+            return;
+         }
+
+         add_index_snapshot_parts<decltype(utils)>(db, snapshot_contract_table_shard_rows, parts);
+      });
+
+      auto shards = contract_table_shards();
+      for (size_t i = 0; i < shards.size(); ++i)
+      {
+         parts.emplace_back([this, i, shard = shards[i]](const snapshot_writer_ptr &snapshot) {
+            snapshot->write_section(contract_table_shard_name(i), [this, &shard](auto &section) {
+               add_contract_table_shard_to_snapshot(section, shard);
+            });
+         });
+      }
+
+      authorization.add_snapshot_parts(snapshot_contract_table_shard_rows, parts);
+      resource_limits.add_snapshot_parts(snapshot_contract_table_shard_rows, parts);
+
+      vector<std::future<vector<digest_type>>> pending;
+
+      // never leave while a part still references the database or parts
+      auto wait_pending = fc::make_scoped_exit([&pending]() {
+         for (auto &p : pending)
+         {
+            if (p.valid()) p.wait();
+         }
+      });
+
+      pending.reserve(parts.size());
+      for (const auto &part : parts)
+      {
+         pending.emplace_back(async_thread_pool(thread_pool, [&part]() {
+            auto writer = std::make_shared<section_digest_snapshot_writer>();
+            part(writer);
+            return writer->section_digests();
+         }));
+      }
+
+      vector<digest_type> digests;
+      for (auto &p : pending)
+      {
+         auto part_digests = p.get();
+         digests.insert(digests.end(), part_digests.begin(), part_digests.end());
+      }
+
+      return merkle(std::move(digests), thread_pool);
+   }
+
    /**
     *  Sets fork database head to the genesis state.
     */
@@ -709,8 +1007,18 @@ struct controller_impl
       resource_limits.verify_account_ram_usage(name);
    }
 
+   void validate_database_version() const
+   {
+      const auto &header_idx = db.get_index<database_header_multi_index>().indices();
+      EOS_ASSERT(header_idx.begin() != header_idx.end(), bad_database_version_exception,
+                 "state database version pre-dates versioning, please restore from a compatible snapshot or replay");
+      header_idx.begin()->validate();
+   }
+
    void initialize_database()
    {
+      db.create<database_header_object>([](auto &) {});
+
       // Initialize block summary index
       for (int i = 0; i < 0x10000; i++)
          db.create<block_summary_object>([&](block_summary_object &) {});
@@ -799,14 +1107,17 @@ struct controller_impl
       auto orig_block_transactions_size = pending->_pending_block_state->block->transactions.size();
       auto orig_state_transactions_size = pending->_pending_block_state->trxs.size();
       auto orig_state_actions_size = pending->_actions.size();
+      auto orig_access_sets_size = pending->_access_sets.size();
 
       std::function<void()> callback = [this,
                                         orig_block_transactions_size,
                                         orig_state_transactions_size,
-                                        orig_state_actions_size]() {
+                                        orig_state_actions_size,
+                                        orig_access_sets_size]() {
          pending->_pending_block_state->block->transactions.resize(orig_block_transactions_size);
          pending->_pending_block_state->trxs.resize(orig_state_transactions_size);
          pending->_actions.resize(orig_state_actions_size);
+         pending->_access_sets.resize(orig_access_sets_size);
       };
 
       return fc::make_scoped_exit(std::move(callback));
@@ -843,7 +1154,7 @@ struct controller_impl
 
          auto restore = make_block_restore_point();
          trace->receipt = push_receipt(gtrx.trx_id, transaction_receipt::soft_fail,
-                                       trx_context.billed_cpu_time_us, trace->net_usage);
+                                       trx_context.billed_cpu_time_us, trace->net_usage, trx_context.access_set);
          fc::move_append(pending->_actions, move(trx_context.executed));
 
          trx_context.squash();
@@ -895,7 +1206,7 @@ struct controller_impl
       {
          maybe_session undo_session;
          if (!self.skip_db_sessions())
-            undo_session = maybe_session(db);
+            undo_session = maybe_session(db, resource_limits);
 
          auto gtrx = generated_transaction(gto);
 
@@ -965,7 +1276,8 @@ struct controller_impl
             trace->receipt = push_receipt(gtrx.trx_id,
                                           transaction_receipt::executed,
                                           trx_context.billed_cpu_time_us,
-                                          trace->net_usage);
+                                          trace->net_usage,
+                                          trx_context.access_set);
 
             fc::move_append(pending->_actions, move(trx_context.executed));
 
@@ -1061,13 +1373,29 @@ struct controller_impl
 
    /**
     *  Adds the transaction receipt to the pending block and returns it.
+    *
+    *  Receipts pushed without a recorded access set (expired, failed) are treated as conflicting with every
+    *  other transaction of the block when analyzing conflicts.
     */
    template <typename T>
    const transaction_receipt &push_receipt(const T &trx, transaction_receipt_header::status_enum status,
-                                           uint64_t cpu_usage_us, uint64_t net_usage)
+                                           uint64_t cpu_usage_us, uint64_t net_usage,
+                                           const optional<transaction_access_set> &access_set = optional<transaction_access_set>())
    {
       uint64_t net_usage_words = net_usage / 8;
       EOS_ASSERT(net_usage_words * 8 == net_usage, transaction_exception, "net_usage is not divisible by 8");
+      if (conf.analyze_transaction_conflicts)
+      {
+         if (access_set)
+         {
+            pending->_access_sets.emplace_back(*access_set);
+         }
+         else
+         {
+            pending->_access_sets.emplace_back();
+            pending->_access_sets.back().exclusive = true;
+         }
+      }
       pending->_pending_block_state->block->transactions.emplace_back(trx);
       transaction_receipt &r = pending->_pending_block_state->block->transactions.back();
       r.cpu_usage_us = cpu_usage_us;
@@ -1156,7 +1484,7 @@ struct controller_impl
                transaction_receipt::status_enum s = (trx_context.delay == fc::seconds(0))
                                                         ? transaction_receipt::executed
                                                         : transaction_receipt::delayed;
-               trace->receipt = push_receipt(*trx->packed_trx, s, trx_context.billed_cpu_time_us, trace->net_usage);
+               trace->receipt = push_receipt(*trx->packed_trx, s, trx_context.billed_cpu_time_us, trace->net_usage, trx_context.access_set);
                pending->_pending_block_state->trxs.emplace_back(trx);      // pending中添加trx
             }
             else
@@ -1221,7 +1549,12 @@ struct controller_impl
    {
       EOS_ASSERT(!pending, block_validate_exception, "pending block already exists");
 
-      auto guard_pending = fc::make_scoped_exit([this]() {pending.reset();});
+      auto guard_pending = fc::make_scoped_exit([this]() {
+         pending.reset();
+         resource_limits.clear_pending_usage();
+      });
+      authorization.clear_authority_cache();
+      resource_limits.clear_pending_usage();
 
       if (!self.skip_db_sessions(s))
       {
@@ -1323,19 +1656,15 @@ struct controller_impl
             start_block(b->timestamp, b->confirmed, s, producer_block_id);
 
             std::vector<transaction_metadata_ptr> packed_transactions;
-            packed_transactions.reserve(b->transactions.size());
-            for (const auto &receipt : b->transactions)
+            auto prepared = prepared_block_transactions.find(producer_block_id);
+            if (prepared != prepared_block_transactions.end())
             {
-               if (receipt.trx.contains<packed_transaction>())
-               {
-                  auto &pt = receipt.trx.get<packed_transaction>();
-                  auto mtrx = std::make_shared<transaction_metadata>(std::make_shared<packed_transaction>(pt));
-                  if (!self.skip_auth_check())
-                  {
-                     transaction_metadata::create_signing_keys_future(mtrx, thread_pool, chain_id, microseconds::maximum());
-                  }
-                  packed_transactions.emplace_back(std::move(mtrx));
-               }
+               packed_transactions = prepared->second.transactions.get();
+               prepared_block_transactions.erase(prepared);
+            }
+            else
+            {
+               packed_transactions = create_block_transactions(b, thread_pool, conf.thread_pool_size, chain_id, !self.skip_auth_check());
             }
 
             transaction_trace_ptr trace;
@@ -1407,6 +1736,104 @@ struct controller_impl
       FC_CAPTURE_AND_RETHROW()
    } /// apply_block
 
+   /**
+    *  Creates the transaction_metadata for every input transaction of the block and, if requested, recovers the
+    *  keys of all their signatures as one batch split across the thread pool.
+    */
+   static vector<transaction_metadata_ptr> create_block_transactions(const signed_block_ptr &b, boost::asio::thread_pool &pool, uint32_t threads,
+                                                                     const chain_id_type &chain_id, bool recover_keys)
+   {
+      vector<transaction_metadata_ptr> packed_transactions;
+      packed_transactions.reserve(b->transactions.size());
+      for (const auto &receipt : b->transactions)
+      {
+         if (receipt.trx.contains<packed_transaction>())
+         {
+            auto &pt = receipt.trx.get<packed_transaction>();
+            packed_transactions.emplace_back(std::make_shared<transaction_metadata>(std::make_shared<packed_transaction>(pt)));
+         }
+      }
+      if (recover_keys)
+      {
+         transaction_metadata::recover_keys_batch(packed_transactions, pool, threads, chain_id, microseconds::maximum());
+      }
+      return packed_transactions;
+   }
+
+   /**
+    *  Queues preparation of the code deployed by setcode actions of the given transactions, so that code from
+    *  incoming blocks is ready by the time it is first executed.
+    */
+   static void queue_code_preparations(const vector<transaction_metadata_ptr> &trxs, wasm_interface &wasmif, boost::asio::thread_pool &pool)
+   {
+      for (const auto &mtrx : trxs)
+      {
+         for (const auto &act : mtrx->packed_trx->get_transaction().actions)
+         {
+            if (act.account != config::system_account_name || act.name != setcode::get_name())
+               continue;
+            try
+            {
+               auto sc = act.data_as<setcode>();
+               if (sc.code.size() > 0)
+                  wasmif.queue_preparation(fc::sha256::hash(sc.code.data(), (uint32_t)sc.code.size()), sc.code, pool);
+            }
+            catch (...)
+            {
+               // malformed actions are rejected when the block is applied
+            }
+         }
+      }
+   }
+
+   /**
+    *  Starts preparing the transactions of a block that is expected to be applied soon. The work is done on the
+    *  thread pool, apply_block picks up the result. When signee_validated is valid the work only starts once it
+    *  is satisfied, so a block with a bad producer signature never gets its transactions unpacked or recovered.
+    *  Entries of rejected blocks are dropped by push_block, those of blocks that never get applied once they
+    *  become irreversible.
+    */
+   void prepare_block_transactions(const signed_block_ptr &b, bool recover_keys, std::shared_future<void> signee_validated = {})
+   {
+      auto id = b->id();
+      if (prepared_block_transactions.count(id))
+         return;
+
+      auto trxs = async_thread_pool(thread_pool, [b, &pool = thread_pool, threads = conf.thread_pool_size, &wasmif = wasmif, chain_id = chain_id, recover_keys, signee_validated]() {
+         if (signee_validated.valid())
+            signee_validated.get();
+         auto trxs = create_block_transactions(b, pool, threads, chain_id, recover_keys);
+         queue_code_preparations(trxs, wasmif, pool);
+         return trxs;
+      });
+      prepared_block_transactions.emplace(id, prepared_block{std::move(signee_validated), trxs.share()});
+   }
+
+   /// drops the prepared transactions of blocks whose signee failed validation
+   void drop_unvalidated_preparations()
+   {
+      for (auto itr = prepared_block_transactions.begin(); itr != prepared_block_transactions.end();)
+      {
+         const auto &validated = itr->second.signee_validated;
+         bool failed = false;
+         if (validated.valid() && validated.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+         {
+            try
+            {
+               validated.get();
+            }
+            catch (...)
+            {
+               failed = true;
+            }
+         }
+         if (failed)
+            itr = prepared_block_transactions.erase(itr);
+         else
+            ++itr;
+      }
+   }
+
    std::future<block_state_ptr> create_block_state_future(const signed_block_ptr &b)
    {
       // 不能是空的区块
@@ -1422,11 +1849,32 @@ struct controller_impl
       auto prev = fork_db.get_block(b->previous);
       EOS_ASSERT(prev, unlinkable_block_exception, "unlinkable block ${id}", ("id", id)("previous", b->previous));
 
+      // the block state is queued first so preparation, which waits on its signee validation, cannot hold the
+      // only pool thread while the validation itself is still queued behind it
+      auto signee_valid = std::make_shared<std::promise<void>>();
+      std::shared_future<void> signee_validated = signee_valid->get_future().share();
+
       // 异步线程池async_thread_pool。传入task，由当前同步的待验证区块以及前一个区块组成，返回的是block_state对象。
-      return async_thread_pool(thread_pool, [b, prev]() { // 传入具体task到异步线程池
+      auto block_state_future = async_thread_pool(thread_pool, [b, prev, signee_valid]() { // 传入具体task到异步线程池
          const bool skip_validate_signee = false;
-         return std::make_shared<block_state>(*prev, move(b), skip_validate_signee);
+         try
+         {
+            auto bsp = std::make_shared<block_state>(*prev, b, skip_validate_signee);
+            signee_valid->set_value();
+            return bsp;
+         }
+         catch (...)
+         {
+            signee_valid->set_exception(std::current_exception());
+            throw;
+         }
       });
+
+      // keys are only needed if this block will be fully validated
+      bool recover_keys = conf.block_validation_mode == validation_mode::FULL && !conf.trusted_producers.count(b->producer);
+      prepare_block_transactions(b, recover_keys, std::move(signee_validated));
+
+      return block_state_future;
    }
 
    // controler
@@ -1438,9 +1886,17 @@ struct controller_impl
       auto reset_prod_light_validation = fc::make_scoped_exit([old_value = trusted_producer_light_validation, this]() {
          trusted_producer_light_validation = old_value;
       });
+      block_state_ptr new_header_state;
+      auto drop_rejected = fc::make_scoped_exit([this, &new_header_state]() {
+         // transactions prepared for a block that did not make it into the fork database are never applied
+         if (!new_header_state)
+            drop_unvalidated_preparations();
+         else if (!fork_db.get_block(new_header_state->id))
+            prepared_block_transactions.erase(new_header_state->id);
+      });
       try
       {
-         block_state_ptr new_header_state = block_state_future.get();
+         new_header_state = block_state_future.get();
          auto &b = new_header_state->block;
          // 使用checkpoint校验区块id，checkpoint是什么？emit最后由谁来接收信号？
          emit(self.pre_accepted_block, b);
@@ -1533,7 +1989,7 @@ struct controller_impl
                apply_block((*ritr)->block, (*ritr)->validated ? controller::block_status::validated : controller::block_status::complete);
                head = *ritr;
                fork_db.mark_in_current_chain(*ritr, true);
-               (*ritr)->validated = true;
+               fork_db.set_validity(*ritr, true);
             }
             catch (const fc::exception &e)
             {
@@ -1582,6 +2038,8 @@ struct controller_impl
                unapplied_transactions[t->signed_id] = t;
          }
          pending.reset();
+         authorization.clear_authority_cache();
+         resource_limits.clear_pending_usage();
       }
    }
 
@@ -1597,7 +2055,7 @@ struct controller_impl
       for (const auto &a : pending->_actions)
          action_digests.emplace_back(a.digest());
 
-      pending->_pending_block_state->header.action_mroot = merkle(move(action_digests));
+      pending->_pending_block_state->header.action_mroot = merkle(move(action_digests), thread_pool);
    }
 
    void set_trx_merkle()
@@ -1608,7 +2066,7 @@ struct controller_impl
       for (const auto &a : trxs)
          trx_digests.emplace_back(a.digest());
 
-      pending->_pending_block_state->header.transaction_mroot = merkle(move(trx_digests));
+      pending->_pending_block_state->header.transaction_mroot = merkle(move(trx_digests), thread_pool);
    }
 
    void finalize_block()
@@ -1644,6 +2102,9 @@ struct controller_impl
          set_action_merkle();
          set_trx_merkle();
 
+         if (conf.analyze_transaction_conflicts)
+            report_transaction_conflicts();
+
          auto p = pending->_pending_block_state;
          p->id = p->header.id();
 
@@ -1652,6 +2113,29 @@ struct controller_impl
       FC_CAPTURE_AND_RETHROW()
    }
 
+   /**
+    *  Logs the conflict structure of the pending block: how many conflict-free waves its transactions fall into
+    *  given the read/write sets recorded while executing them serially. This is analysis only, transactions are
+    *  still executed one after another.
+    */
+   void report_transaction_conflicts() const
+   {
+      const auto &sets = pending->_access_sets;
+      if (sets.empty())
+         return;
+
+      auto waves = schedule_access_waves(sets);
+      vector<uint32_t> wave_sizes(*std::max_element(waves.begin(), waves.end()) + 1, 0);
+      for (auto w : waves)
+         ++wave_sizes[w];
+
+      auto exclusive = std::count_if(sets.begin(), sets.end(), [](const auto &s) { return s.exclusive; });
+
+      ilog("block ${n}: ${t} transactions in ${w} conflict-free waves, largest wave ${l}, ${e} conflicting with all",
+           ("n", pending->_pending_block_state->block_num)("t", sets.size())("w", wave_sizes.size())
+           ("l", *std::max_element(wave_sizes.begin(), wave_sizes.end()))("e", exclusive));
+   }
+
    void update_producers_authority()
    {
       const auto &producers = pending->_pending_block_state->active_schedule.producers;
@@ -1668,6 +2152,7 @@ struct controller_impl
             db.modify(permission, [&](auto &po) {
                po.auth = auth;
             });
+            authorization.clear_authority_cache();
          }
       };
 
@@ -1703,13 +2188,7 @@ struct controller_impl
    void clear_expired_input_transactions()
    {
       //Look for expired transactions in the deduplication list, and remove them.
-      auto &transaction_idx = db.get_mutable_index<transaction_multi_index>();
-      const auto &dedupe_index = transaction_idx.indices().get<by_expiration>();
-      auto now = self.pending_block_time();
-      while ((!dedupe_index.empty()) && (now > fc::time_point(dedupe_index.begin()->expiration)))
-      {
-         transaction_idx.remove(*dedupe_index.begin());
-      }
+      remove_expired_transactions(db, self.pending_block_time());
    }
 
    bool sender_avoids_whitelist_blacklist_enforcement(account_name sender) const
@@ -2215,11 +2694,13 @@ block_id_type controller::get_block_id_for_num(uint32_t block_num) const
    FC_CAPTURE_AND_RETHROW((block_num))
 }
 
-sha256 controller::calculate_integrity_hash() const
+sha256 controller::calculate_integrity_hash(uint32_t version) const
 {
    try
    {
-      return my->calculate_integrity_hash();
+      EOS_ASSERT(version == 1 || version == 2, unsupported_feature,
+                 "Unsupported integrity hash version ${v}", ("v", version));
+      return version == 1 ? my->calculate_integrity_hash() : my->calculate_integrity_tree_hash();
    }
    FC_LOG_AND_RETHROW()
 }
@@ -2359,6 +2840,11 @@ bool controller::contracts_console() const
    return my->conf.contracts_console;
 }
 
+bool controller::analyze_transaction_conflicts() const
+{
+   return my->conf.analyze_transaction_conflicts;
+}
+
 chain_id_type controller::get_chain_id() const
 {
    return my->chain_id;
@@ -2390,6 +2876,11 @@ wasm_interface &controller::get_wasm_interface()
    return my->wasmif;
 }
 
+const wasm_interface &controller::get_wasm_interface() const
+{
+   return my->wasmif;
+}
+
 const account_object &controller::get_account(account_name name) const
 {
    try
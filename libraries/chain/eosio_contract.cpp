@@ -140,6 +140,7 @@ void apply_eosio_setcode(apply_context& context) {
    if( act.code.size() > 0 ) {
      code_id = fc::sha256::hash( act.code.data(), (uint32_t)act.code.size() );
      wasm_interface::validate(context.control, act.code);
+     context.control.get_wasm_interface().queue_preparation( code_id, act.code, context.control.get_thread_pool() );
    }
 
    const auto& account = db.get<account_object,by_name>(act.account);
@@ -7,6 +7,7 @@
 #include <boost/multi_index/mem_fun.hpp>
 #include <boost/multi_index/composite_key.hpp>
 #include <fc/io/fstream.hpp>
+#include <boost/filesystem.hpp>
 #include <fstream>
 
 namespace eosio { namespace chain {
@@ -42,10 +43,198 @@ namespace eosio { namespace chain {
    > fork_multi_index_type;
 
 
+   /**
+    *  The fork database is persisted as a journal of the changes made to it, appended to as they happen, so it
+    *  survives a crash and shutting down does not have to write it out. Each record is its size, a checksum and
+    *  the operation followed by its argument; a torn record at the end is dropped when the journal is replayed.
+    *  Once the journal holds many more records than there are blocks it is rewritten with one record per block.
+    */
+   enum class journal_op : uint8_t {
+      put    = 1, ///< block_state, inserted or replacing the one with the same id
+      erase  = 2, ///< block_id_type
+      update  = 3, ///< journal_update
+      head    = 4, ///< block_id_type
+      confirm = 5  ///< header_confirmation, already verified and appended to the confirmations of its block
+   };
+
+   struct journal_update {
+      block_id_type id;
+      bool          validated = false;
+      bool          in_current_chain = false;
+      uint32_t      bft_irreversible_blocknum = 0;
+   };
+
+} }
+
+FC_REFLECT( eosio::chain::journal_update, (id)(validated)(in_current_chain)(bft_irreversible_blocknum) )
+
+namespace eosio { namespace chain {
+
+   static const uint32_t journal_version = 1;
+   static const uint64_t min_journal_records_before_compaction = 10000;
+
    struct fork_database_impl {
       fork_multi_index_type index;
       block_state_ptr       head;
       fc::path              datadir;
+
+      std::ofstream         journal;
+      uint64_t              journal_records = 0;
+      block_id_type         journaled_head;
+
+      fc::path journal_file()const { return datadir / config::forkdb_journal_filename; }
+
+      template<typename T>
+      static void write_record( std::ostream& out, journal_op op, const T& arg ) {
+         bytes payload( 1 + fc::raw::pack_size( arg ) );
+         fc::datastream<char*> ds( payload.data(), payload.size() );
+         fc::raw::pack( ds, static_cast<uint8_t>(op) );
+         fc::raw::pack( ds, arg );
+         const uint32_t size = payload.size();
+         const uint64_t checksum = fc::sha256::hash( payload.data(), size )._hash[0];
+         out.write( (const char*)&size, sizeof(size) );
+         out.write( (const char*)&checksum, sizeof(checksum) );
+         out.write( payload.data(), payload.size() );
+      }
+
+      template<typename T>
+      void append( journal_op op, const T& arg ) {
+         if( !journal.is_open() )
+            return;
+         write_record( journal, op, arg );
+         // reaches the OS right away so the record survives the process
+         journal.flush();
+         ++journal_records;
+      }
+
+      void journal_update_of( const block_state& s ) {
+         append( journal_op::update, journal_update{ s.id, s.validated, s.in_current_chain, s.bft_irreversible_blocknum } );
+      }
+
+      /// records a change of head, called once the index is consistent again after every change
+      void journal_head() {
+         const block_id_type head_id = head ? head->id : block_id_type();
+         if( head_id != journaled_head ) {
+            append( journal_op::head, head_id );
+            journaled_head = head_id;
+         }
+         if( journal.is_open() && journal_records > std::max<uint64_t>( min_journal_records_before_compaction, index.size() * 8 ) )
+            compact_journal();
+      }
+
+      void erase( fork_multi_index_type::iterator itr ) {
+         append( journal_op::erase, (*itr)->id );
+         index.erase( itr );
+      }
+
+      /// replaces the journal with one holding the current content of the index
+      void compact_journal() {
+         const auto tmp_file = datadir / (string(config::forkdb_journal_filename) + ".tmp");
+         {
+            std::ofstream out( tmp_file.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+            out.exceptions( std::ofstream::failbit | std::ofstream::badbit );
+            out.write( (const char*)&journal_version, sizeof(journal_version) );
+            for( const auto& s : index )
+               write_record( out, journal_op::put, *s );
+            write_record( out, journal_op::head, head ? head->id : block_id_type() );
+         }
+         if( journal.is_open() )
+            journal.close();
+         fc::rename( tmp_file, journal_file() );
+         open_journal();
+         journal_records = index.size() + 1;
+         journaled_head = head ? head->id : block_id_type();
+      }
+
+      void open_journal() {
+         journal.open( journal_file().generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::app );
+         journal.exceptions( std::ofstream::failbit | std::ofstream::badbit );
+      }
+
+      /// rebuilds the index from the journal, returns the number of valid bytes in it
+      uint64_t replay_journal() {
+         string content;
+         fc::read_file_contents( journal_file(), content );
+         if( content.size() < sizeof(journal_version) )
+            return 0;
+
+         uint32_t version = 0;
+         memcpy( &version, content.data(), sizeof(version) );
+         EOS_ASSERT( version == journal_version, fork_database_exception,
+                     "Unsupported version of fork database journal. Version is ${v} while code supports version ${s}",
+                     ("v", version)("s", journal_version) );
+
+         uint64_t pos = sizeof(version);
+         while( content.size() - pos >= sizeof(uint32_t) + sizeof(uint64_t) ) {
+            uint32_t size;
+            uint64_t checksum;
+            memcpy( &size, content.data() + pos, sizeof(size) );
+            memcpy( &checksum, content.data() + pos + sizeof(size), sizeof(checksum) );
+            const uint64_t payload_pos = pos + sizeof(size) + sizeof(checksum);
+            if( size == 0 || content.size() - payload_pos < size ||
+                fc::sha256::hash( content.data() + payload_pos, size )._hash[0] != checksum )
+               break;
+
+            fc::datastream<const char*> ds( content.data() + payload_pos, size );
+            uint8_t op;
+            fc::raw::unpack( ds, op );
+            switch( static_cast<journal_op>(op) ) {
+               case journal_op::put: {
+                  auto s = std::make_shared<block_state>();
+                  fc::raw::unpack( ds, *s );
+                  auto itr = index.find( s->id );
+                  if( itr != index.end() )
+                     index.erase( itr );
+                  index.insert( s );
+                  break;
+               }
+               case journal_op::erase: {
+                  block_id_type id;
+                  fc::raw::unpack( ds, id );
+                  auto itr = index.find( id );
+                  if( itr != index.end() )
+                     index.erase( itr );
+                  break;
+               }
+               case journal_op::update: {
+                  journal_update u;
+                  fc::raw::unpack( ds, u );
+                  auto itr = index.find( u.id );
+                  if( itr != index.end() ) {
+                     index.modify( itr, [&]( auto& bsp ) {
+                        bsp->validated = u.validated;
+                        bsp->in_current_chain = u.in_current_chain;
+                        bsp->bft_irreversible_blocknum = u.bft_irreversible_blocknum;
+                     });
+                  }
+                  break;
+               }
+               case journal_op::confirm: {
+                  header_confirmation c;
+                  fc::raw::unpack( ds, c );
+                  auto itr = index.find( c.block_id );
+                  if( itr != index.end() ) {
+                     index.modify( itr, [&]( auto& bsp ) {
+                        bsp->confirmations.emplace_back( std::move(c) );
+                     });
+                  }
+                  break;
+               }
+               case journal_op::head: {
+                  block_id_type id;
+                  fc::raw::unpack( ds, id );
+                  auto itr = index.find( id );
+                  head = itr != index.end() ? *itr : block_state_ptr();
+                  break;
+               }
+               default:
+                  EOS_THROW( fork_database_exception, "Unknown fork database journal operation ${op}", ("op", op) );
+            }
+            pos = payload_pos + size;
+            ++journal_records;
+         }
+         return pos;
+      }
    };
 
 
@@ -55,8 +244,18 @@ namespace eosio { namespace chain {
       if (!fc::is_directory(my->datadir))
          fc::create_directories(my->datadir);
 
+      const auto start = fc::time_point::now();
       auto fork_db_dat = my->datadir / config::forkdb_filename;
-      if( fc::exists( fork_db_dat ) ) {
+      if( fc::exists( my->journal_file() ) ) {
+         const auto valid_size = my->replay_journal();
+         if( valid_size < fc::file_size( my->journal_file() ) ) {
+            wlog( "Dropping incomplete record at the end of the fork database journal" );
+            boost::filesystem::resize_file( my->journal_file(), valid_size );
+         }
+         my->journaled_head = my->head ? my->head->id : block_id_type();
+         ilog( "Loaded ${n} blocks from fork database journal in ${ms} ms",
+               ("n", my->index.size())("ms", (fc::time_point::now() - start).count() / 1000) );
+      } else if( fc::exists( fork_db_dat ) ) {
          string content;
          fc::read_file_contents( fork_db_dat, content );
 
@@ -71,25 +270,22 @@ namespace eosio { namespace chain {
          fc::raw::unpack( ds, head_id );
 
          my->head = get_block( head_id );
+      }
 
+      if( my->journal_records == 0 || my->journal_records > std::max<uint64_t>( min_journal_records_before_compaction, my->index.size() * 8 ) )
+         my->compact_journal();
+      else
+         my->open_journal();
+      if( fc::exists( fork_db_dat ) )
          fc::remove( fork_db_dat );
-      }
    }
 
    void fork_database::close() {
-      if( my->index.size() == 0 ) return;
+      // the journal is already complete, the lib pruned below stays in it as the root to build on after restart
+      if( my->journal.is_open() )
+         my->journal.close();
 
-      auto fork_db_dat = my->datadir / config::forkdb_filename;
-      std::ofstream out( fork_db_dat.generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc );
-      uint32_t num_blocks_in_fork_db = my->index.size();
-      fc::raw::pack( out, unsigned_int{num_blocks_in_fork_db} );
-      for( const auto& s : my->index ) {
-         fc::raw::pack( out, *s );
-      }
-      if( my->head )
-         fc::raw::pack( out, my->head->id );
-      else
-         fc::raw::pack( out, block_id_type() );
+      if( my->index.size() == 0 ) return;
 
       /// we don't normally indicate the head block as irreversible
       /// we cannot normally prune the lib if it is the head block because
@@ -116,11 +312,13 @@ namespace eosio { namespace chain {
          //FC_ASSERT( s->block_num == s->header.block_num() );
 
       EOS_ASSERT( result.second, fork_database_exception, "unable to insert block state, duplicate state detected" );
+      my->append( journal_op::put, *s );
       if( !my->head ) {
          my->head =  s;
       } else if( my->head->block_num < s->block_num ) {
          my->head =  s;
       }
+      my->journal_head();
    }
 
    block_state_ptr fork_database::add( const block_state_ptr& n, bool skip_validate_previous ) {
@@ -135,6 +333,7 @@ namespace eosio { namespace chain {
 
       auto inserted = my->index.insert(n);
       EOS_ASSERT( inserted.second, fork_database_exception, "duplicate block added?" );
+      my->append( journal_op::put, *n );
 
       my->head = *my->index.get<by_lib_block_num>().begin();
 
@@ -144,6 +343,7 @@ namespace eosio { namespace chain {
       if( oldest->block_num < lib ) {
          prune( oldest );
       }
+      my->journal_head();
 
       return n;
    }
@@ -216,7 +416,7 @@ namespace eosio { namespace chain {
       for( uint32_t i = 0; i < remove_queue.size(); ++i ) {
          auto itr = my->index.find( remove_queue[i] );
          if( itr != my->index.end() )
-            my->index.erase(itr);
+            my->erase(itr);
 
          auto& previdx = my->index.get<by_prev>();
          auto  previtr = previdx.lower_bound(remove_queue[i]);
@@ -227,6 +427,7 @@ namespace eosio { namespace chain {
       }
       //wdump((my->index.size()));
       my->head = *my->index.get<by_lib_block_num>().begin();
+      my->journal_head();
    }
 
    void fork_database::set_validity( const block_state_ptr& h, bool valid ) {
@@ -234,7 +435,10 @@ namespace eosio { namespace chain {
          remove( h->id );
       } else {
          /// remove older than irreversible and mark block as valid
-         h->validated = true;
+         if( !h->validated ) {
+            h->validated = true;
+            my->journal_update_of( *h );
+         }
       }
    }
 
@@ -249,6 +453,7 @@ namespace eosio { namespace chain {
       by_id_idx.modify( itr, [&]( auto& bsp ) { // Need to modify this way rather than directly so that Boost MultiIndex can re-sort
          bsp->in_current_chain = in_current_chain;
       });
+      my->journal_update_of( **itr );
    }
 
    void fork_database::prune( const block_state_ptr& h ) {
@@ -264,7 +469,7 @@ namespace eosio { namespace chain {
       auto itr = my->index.find( h->id );
       if( itr != my->index.end() ) {
          irreversible(*itr);
-         my->index.erase(itr);
+         my->erase(itr);
       }
 
       auto& numidx = my->index.get<by_block_num>();
@@ -301,6 +506,7 @@ namespace eosio { namespace chain {
       auto b = get_block( c.block_id );
       EOS_ASSERT( b, fork_db_block_not_found, "unable to find block id ${id}", ("id",c.block_id));
       b->add_confirmation( c );
+      my->append( journal_op::confirm, c );
 
       if( b->bft_irreversible_blocknum < b->block_num &&
          b->confirmations.size() >= ((b->active_schedule.producers.size() * 2) / 3 + 1) ) {
@@ -322,6 +528,7 @@ namespace eosio { namespace chain {
       idx.modify( itr, [&]( auto& bsp ) {
            bsp->bft_irreversible_blocknum = bsp->block_num;
       });
+      my->journal_update_of( **itr );
 
       /** to prevent stack-overflow, we perform a bredth-first traversal of the
        * fork database. At each stage we iterate over the leafs from the prior stage
@@ -341,6 +548,7 @@ namespace eosio { namespace chain {
                  if( bsp->bft_irreversible_blocknum < block_num ) {
                     bsp->bft_irreversible_blocknum = block_num;
                     updated.push_back( bsp->id );
+                    my->journal_update_of( *bsp );
                  }
                });
                ++pitr;
@@ -8,6 +8,8 @@
 #include <eosio/chain/exceptions.hpp>
 #include <fc/variant_object.hpp>
 #include <fc/scoped_exit.hpp>
+#include <memory>
+#include <iosfwd>
 
 namespace eosio { namespace chain {
 
@@ -25,6 +27,9 @@ namespace impl {
    struct abi_traverse_context_with_path;
    struct binary_to_variant_context;
    struct variant_to_binary_context;
+
+   struct compiled_type;
+   struct abi_plan;
 }
 
 /**
@@ -32,8 +37,15 @@ namespace impl {
  *  be converted to and from JSON.
  */
 struct abi_serializer {
-   abi_serializer(){ configure_built_in_types(); }
+   abi_serializer();
    abi_serializer( const abi_def& abi, const fc::microseconds& max_serialization_time );
+   abi_serializer( const abi_serializer& other );
+   abi_serializer( abi_serializer&& other );
+   ~abi_serializer();
+
+   abi_serializer& operator=( const abi_serializer& other );
+   abi_serializer& operator=( abi_serializer&& other );
+
    void set_abi(const abi_def& abi, const fc::microseconds& max_serialization_time);
 
    type_name resolve_type(const type_name& t)const;
@@ -56,6 +68,9 @@ struct abi_serializer {
    fc::variant binary_to_variant( const type_name& type, const bytes& binary, const fc::microseconds& max_serialization_time, bool short_path = false )const;
    fc::variant binary_to_variant( const type_name& type, fc::datastream<const char*>& binary, const fc::microseconds& max_serialization_time, bool short_path = false )const;
 
+   /// writes the same JSON as fc::json::to_string( binary_to_variant(...) ) without building the variant
+   void        binary_to_json( const type_name& type, const bytes& binary, std::ostream& out, const fc::microseconds& max_serialization_time, bool short_path = false )const;
+
    bytes       variant_to_binary( const type_name& type, const fc::variant& var, const fc::microseconds& max_serialization_time, bool short_path = false )const;
    void        variant_to_binary( const type_name& type, const fc::variant& var, fc::datastream<char*>& ds, const fc::microseconds& max_serialization_time, bool short_path = false )const;
 
@@ -101,14 +116,32 @@ private:
    map<type_name, pair<unpack_function, pack_function>> built_in_types;
    void configure_built_in_types();
 
+   /**
+    *  Types are compiled on first use into a plan whose entries point directly at their built-in
+    *  pack/unpack functions, struct and variant definitions and nested types, so serialization no
+    *  longer resolves type names while it walks the data.
+    */
+   std::unique_ptr<impl::abi_plan> plan;
+   const impl::compiled_type& compiled( const type_name& type, impl::abi_traverse_context& ctx )const;
+   const impl::compiled_type* compile_type( const type_name& type )const;
+   void                       compile_members( impl::compiled_type& t )const;
+
    fc::variant _binary_to_variant( const type_name& type, const bytes& binary, impl::binary_to_variant_context& ctx )const;
    fc::variant _binary_to_variant( const type_name& type, fc::datastream<const char*>& binary, impl::binary_to_variant_context& ctx )const;
-   void        _binary_to_variant( const type_name& type, fc::datastream<const char*>& stream,
+   fc::variant _binary_to_variant( const impl::compiled_type& t, fc::datastream<const char*>& stream, impl::binary_to_variant_context& ctx )const;
+   void        _binary_to_variant( const impl::compiled_type& t, fc::datastream<const char*>& stream,
                                    fc::mutable_variant_object& obj, impl::binary_to_variant_context& ctx )const;
 
+   bool        _binary_to_json( const impl::compiled_type& t, fc::datastream<const char*>& stream, std::ostream& out,
+                                impl::binary_to_variant_context& ctx )const;
+   void        _binary_to_json( const impl::compiled_type& t, fc::datastream<const char*>& stream, std::ostream& out,
+                                bool& first_field, impl::binary_to_variant_context& ctx )const;
+
    bytes       _variant_to_binary( const type_name& type, const fc::variant& var, impl::variant_to_binary_context& ctx )const;
    void        _variant_to_binary( const type_name& type, const fc::variant& var,
                                    fc::datastream<char*>& ds, impl::variant_to_binary_context& ctx )const;
+   void        _variant_to_binary( const type_name& type, const impl::compiled_type& t, const fc::variant& var,
+                                   fc::datastream<char*>& ds, impl::variant_to_binary_context& ctx )const;
 
    static type_name _remove_bin_extension(const type_name& type);
    bool _is_type( const type_name& type, impl::abi_traverse_context& ctx )const;
@@ -380,7 +413,7 @@ namespace impl {
 
          try {
             auto abi = resolver(act.account);
-            if (abi.valid()) {
+            if (abi) {
                auto type = abi->get_action_type(act.name);
                if (!type.empty()) {
                   try {
@@ -545,7 +578,7 @@ namespace impl {
                valid_empty_data = act.data.empty();
             } else if ( data.is_object() ) {
                auto abi = resolver(act.account);
-               if (abi.valid()) {
+               if (abi) {
                   auto type = abi->get_action_type(act.name);
                   if (!type.empty()) {
                      variant_to_binary_context _ctx(*abi, ctx, type);
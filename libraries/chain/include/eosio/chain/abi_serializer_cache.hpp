@@ -0,0 +1,68 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <eosio/chain/abi_serializer.hpp>
+
+#include <memory>
+
+namespace chainbase { class database; }
+
+namespace eosio { namespace chain {
+
+   /**
+    *  Ready abi_serializers of contract accounts, shared by every read API request that needs one.
+    *
+    *  An entry is keyed by the account and its abi_sequence, so an entry left behind by a replaced ABI is never
+    *  returned; setabi additionally drops it right away through invalidate(). Entries are handed out as shared
+    *  pointers and stay valid for the request holding them even if they are evicted meanwhile.
+    */
+   class abi_serializer_cache {
+      public:
+         struct entry {
+            abi_def        abi;
+            abi_serializer serializer;
+            uint64_t       abi_sequence = 0;
+            uint64_t       memory_size = 0;
+         };
+         using entry_ptr = std::shared_ptr<const entry>;
+
+         struct cache_stats {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t invalidations = 0;
+            uint64_t evictions = 0;
+            uint32_t entries = 0;
+            uint32_t capacity = 0;
+            uint64_t memory_size = 0; ///< estimated bytes held by the cached entries
+         };
+
+         static constexpr uint32_t default_capacity = 1024;
+
+         explicit abi_serializer_cache( uint32_t capacity = default_capacity );
+         ~abi_serializer_cache();
+
+         /// shrinking evicts immediately, 0 disables caching
+         void set_capacity( uint32_t capacity );
+
+         /// the ABI set on account, nullptr if the account does not exist or has no ABI
+         entry_ptr get( const chainbase::database& db, const account_name& account, const fc::microseconds& max_serialization_time );
+
+         /// drop the entry of account, called when its ABI is replaced
+         void invalidate( const account_name& account );
+         void clear();
+
+         cache_stats get_stats()const;
+
+         /// builds an entry for the ABI set on account without caching it
+         static entry_ptr make_entry( const chainbase::database& db, const account_name& account, const fc::microseconds& max_serialization_time );
+
+      private:
+         struct impl;
+         std::unique_ptr<impl> my;
+   };
+
+} } /// eosio::chain
+
+FC_REFLECT( eosio::chain::abi_serializer_cache::cache_stats, (hits)(misses)(invalidations)(evictions)(entries)(capacity)(memory_size) )
@@ -210,6 +210,7 @@ class apply_context {
                EOS_ASSERT( table_obj.code == context.receiver, table_access_violation, "db access violation" );
 
 //               context.require_write_lock( table_obj.scope );
+               context.record_table_write( table_obj );
 
                context.db.modify( table_obj, [&]( auto& t ) {
                   --t.count;
@@ -230,6 +231,7 @@ class apply_context {
                EOS_ASSERT( table_obj.code == context.receiver, table_access_violation, "db access violation" );
 
 //               context.require_write_lock( table_obj.scope );
+               context.record_table_write( table_obj );
 
                if( payer == account_name() ) payer = obj.payer;
 
@@ -556,6 +558,7 @@ class apply_context {
       const table_id_object* find_table( name code, name scope, name table );
       const table_id_object& find_or_create_table( name code, name scope, name table, const account_name &payer );
       void                   remove_table( const table_id_object& tid );
+      void                   record_table_write( const table_id_object& tid );
 
       int  db_store_i64( uint64_t code, uint64_t scope, uint64_t table, const account_name& payer, uint64_t id, const char* buffer, size_t buffer_size );
 
@@ -6,6 +6,7 @@
 
 #include <eosio/chain/types.hpp>
 #include <eosio/chain/authority.hpp>
+#include <eosio/chain/flat_authority.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/parallel_markers.hpp>
 
@@ -64,7 +65,9 @@ namespace detail {
          const std::function<void()>&         checktime;
          vector<public_key_type>              provided_keys; // Making this a flat_set<public_key_type> causes runtime problems with utilities::filter_data_by_marker for some reason. TODO: Figure out why.
          flat_set<permission_level>           provided_permissions;
+         vector<uint64_t>                     provided_key_hashes;
          vector<bool>                         _used_keys;
+         vector<uint32_t>                     _newly_used_keys; ///< keys marked used while evaluating flat authorities, to undo on failure
          fc::microseconds                     provided_delay;
          uint16_t                             recursion_depth_limit;
 
@@ -85,6 +88,10 @@ namespace detail {
          ,recursion_depth_limit(recursion_depth_limit)
          {
             EOS_ASSERT( static_cast<bool>(checktime), authorization_exception, "checktime cannot be empty" );
+            provided_key_hashes.reserve( provided_keys.size() );
+            for( const auto& k : provided_keys )
+               provided_key_hashes.push_back( flat_authority::key_hash( k ) );
+            _newly_used_keys.reserve( provided_keys.size() );
          }
 
          enum permission_cache_status {
@@ -146,6 +153,14 @@ namespace detail {
 
          bool all_keys_used() const { return boost::algorithm::all_of_equal(_used_keys, true); }
 
+         /// marks keys as used without evaluating an authority, e.g. for a check whose outcome is already known
+         void use_keys( const flat_set<public_key_type>& keys ) {
+            for( size_t i = 0; i < provided_keys.size(); ++i ) {
+               if( keys.find( provided_keys[i] ) != keys.end() )
+                  _used_keys[i] = true;
+            }
+         }
+
          flat_set<public_key_type> used_keys() const {
             auto range = filter_data_by_marker(provided_keys, _used_keys, true);
             return {range.begin(), range.end()};
@@ -203,6 +218,44 @@ namespace detail {
             return false;
          }
 
+         /// evaluates the entries in place, the keys used are undone through _newly_used_keys instead of a copy
+         bool satisfied( const flat_authority& authority, permission_cache_type& cached_permissions, uint16_t depth ) {
+            const size_t newly_used_mark = _newly_used_keys.size();
+
+            weight_tally_visitor visitor(*this, cached_permissions, depth);
+            for( const auto& e : authority.entries ) {
+               switch( e.type ) {
+                  case flat_authority::wait_entry:
+                     if( provided_delay >= fc::seconds(e.value) )
+                        visitor.total_weight += e.weight;
+                     break;
+                  case flat_authority::key_entry:
+                     for( size_t i = 0; i < provided_keys.size(); ++i ) {
+                        if( provided_key_hashes[i] == e.key_hash && provided_keys[i] == authority.keys[e.value] ) {
+                           if( !_used_keys[i] ) {
+                              _used_keys[i] = true;
+                              _newly_used_keys.push_back( i );
+                           }
+                           visitor.total_weight += e.weight;
+                           break;
+                        }
+                     }
+                     break;
+                  case flat_authority::account_entry:
+                     visitor( permission_level_weight{e.permission, e.weight} );
+                     break;
+               }
+               if( visitor.total_weight >= authority.threshold )
+                  return true;
+            }
+
+            while( _newly_used_keys.size() > newly_used_mark ) {
+               _used_keys[_newly_used_keys.back()] = false;
+               _newly_used_keys.pop_back();
+            }
+            return false;
+         }
+
          struct weight_tally_visitor {
             using result_type = uint32_t;
 
@@ -6,10 +6,12 @@
 
 #include <eosio/chain/types.hpp>
 #include <eosio/chain/permission_object.hpp>
+#include <eosio/chain/flat_authority.hpp>
 #include <eosio/chain/snapshot.hpp>
 
 #include <utility>
 #include <functional>
+#include <tuple>
 
 namespace eosio { namespace chain {
 
@@ -24,11 +26,21 @@ namespace eosio { namespace chain {
       public:
          using permission_id_type = permission_object::id_type;
 
+         struct authority_cache_stats {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t invalidations = 0;
+            uint32_t entries = 0;
+            int64_t  cpu_saved_us = 0; ///< time the memoized checks took when first evaluated, summed over their hits
+         };
+
          explicit authorization_manager(controller& c, chainbase::database& d);
 
          void add_indices();
          void initialize_database();
          void add_to_snapshot( const snapshot_writer_ptr& snapshot ) const;
+         /// the sections of add_to_snapshot as parts that can be written independently, see add_index_snapshot_parts
+         void add_snapshot_parts( uint64_t rows_per_part, std::vector<snapshot_part>& parts ) const;
          void read_from_snapshot( const snapshot_reader_ptr& snapshot );
 
          const permission_object& create_permission( account_name account,
@@ -56,6 +68,10 @@ namespace eosio { namespace chain {
          const permission_object*  find_permission( const permission_level& level )const;
          const permission_object&  get_permission( const permission_level& level )const;
 
+         /// authority of the permission in the layout authority_checker evaluates without allocating, kept until the
+         /// authority cache is cleared and checked against the permission once a permission changed
+         const flat_authority&     get_flat_authority( const permission_level& level )const;
+
          /**
           * @brief Find the lowest authority level required for @ref authorizer_account to authorize a message of the
           * specified type
@@ -116,12 +132,43 @@ namespace eosio { namespace chain {
                                                     )const;
 
 
+         /**
+          *  Forgets the memoized authority checks. Must be called whenever state may be undone, i.e. for every new
+          *  or aborted block, since permission changes of undone transactions are not seen by the cache. Checks are
+          *  not memoized again until then once a permission changed, the change may still be undone.
+          */
+         void clear_authority_cache();
+
+         authority_cache_stats get_authority_cache_stats()const;
+
          static std::function<void()> _noop_checktime;
 
       private:
          const controller&    _control;
          chainbase::database& _db;
 
+         /// keys a satisfied check used and how long it took, keyed by (permission, provided keys, effective delay)
+         struct satisfied_authority {
+            flat_set<public_key_type> used_keys;
+            fc::microseconds          cpu_usage;
+         };
+         using satisfied_authority_key = std::tuple<permission_level, flat_set<public_key_type>, fc::microseconds>;
+
+         mutable map<satisfied_authority_key, satisfied_authority> _satisfied_authorities;
+         mutable uint16_t                                          _satisfied_authorities_depth = 0;
+         mutable authority_cache_stats                             _authority_cache_stats;
+         /// the authority is kept to validate the entry while permission changes may still be undone
+         struct cached_flat_authority {
+            authority      auth;
+            flat_authority flat;
+         };
+
+         mutable map<permission_level, cached_flat_authority>      _flat_authorities;
+         bool                                                      _permissions_changed = false; ///< since clear_authority_cache()
+
+         void             permission_changed();
+         void             forget_authorities()const;
+
          void             check_updateauth_authorization( const updateauth& update, const vector<permission_level>& auths )const;
          void             check_deleteauth_authorization( const deleteauth& del, const vector<permission_level>& auths )const;
          void             check_linkauth_authorization( const linkauth& link, const vector<permission_level>& auths )const;
@@ -135,3 +182,5 @@ namespace eosio { namespace chain {
    };
 
 } } /// namespace eosio::chain
+
+FC_REFLECT( eosio::chain::authorization_manager::authority_cache_stats, (hits)(misses)(invalidations)(entries)(cpu_saved_us) )
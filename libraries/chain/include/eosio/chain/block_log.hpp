@@ -34,11 +34,18 @@ namespace eosio { namespace chain {
     *
     * The main file is the only file that needs to persist. The index file can be reconstructed during a
     * linear scan of the main file.
+    *
+    * With a non zero stride the log is split after every block whose number is a multiple of the stride: the
+    * main and index file are renamed to blocks-<first>-<last>.log and blocks-<first>-<last>.index and a new main
+    * file starts with the next block. Split off files are read only and are kept next to the main file, reads by
+    * block number are routed to them transparently. Beyond max_retained_files the oldest ones are moved to
+    * archive_dir, or deleted when it is empty.
     */
 
    class block_log {
       public:
-         block_log(const fc::path& data_dir);
+         block_log(const fc::path& data_dir, uint32_t stride = 0,
+                   uint32_t max_retained_files = std::numeric_limits<uint32_t>::max(), const fc::path& archive_dir = fc::path());
          block_log(block_log&& other);
          ~block_log();
 
@@ -53,18 +60,22 @@ namespace eosio { namespace chain {
          }
 
          /**
-          * Return offset of block in file, or block_log::npos if it does not exist.
+          * Return offset of block in the file that holds it, the main file or a split off file, or block_log::npos
+          * if it is in neither.
           */
          uint64_t get_block_pos(uint32_t block_num) const;
          signed_block_ptr        read_head()const;
          const signed_block_ptr& head()const;
-         uint32_t                first_block_num() const;
+         uint32_t                first_block_num() const; ///< first block of the oldest retained file
 
          static const uint64_t npos = std::numeric_limits<uint64_t>::max();
 
          static const uint32_t min_supported_version;
          static const uint32_t max_supported_version;
 
+         /// bytes of the main file each thread scans at a time when an index is reconstructed
+         static uint64_t index_scan_chunk_size;
+
          static fc::path repair_log( const fc::path& data_dir, uint32_t truncate_at_block = 0 );
 
          static genesis_state extract_genesis_state( const fc::path& data_dir );
@@ -72,6 +83,8 @@ namespace eosio { namespace chain {
       private:
          void open(const fc::path& data_dir);
          void construct_index();
+         void start_log( const genesis_state& gs, const signed_block_ptr& first_block, uint32_t first_block_num );
+         void split_log();
 
          std::unique_ptr<detail::block_log_impl> my;
    };
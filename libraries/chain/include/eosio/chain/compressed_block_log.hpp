@@ -0,0 +1,57 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <fc/filesystem.hpp>
+#include <eosio/chain/block.hpp>
+#include <eosio/chain/genesis_state.hpp>
+
+namespace eosio { namespace chain {
+
+   namespace detail { class compressed_block_log_impl; }
+
+   /* A compressed, read only archive of a block log. Runs of blocks_per_chunk consecutive blocks are compressed
+    * together with zlib, so a block can be read by decompressing only the chunk that holds it.
+    *
+    * +---------+-----------------+------------------+------------+---------+-----+-------------+--------+
+    * | Version | First Block Num | Blocks Per Chunk | Genesis    | Chunk 0 | ... | Chunk Index | Footer |
+    * +---------+-----------------+------------------+------------+---------+-----+-------------+--------+
+    *
+    * The chunk index is the packed vector of the file positions of all chunks. The footer holds the position of
+    * the chunk index followed by the number of blocks in the archive, so both are found by reading the last
+    * 12 bytes of the file.
+    *
+    * A decompressed chunk starts with the number of blocks it holds and the offset of each of them within the
+    * chunk, followed by the packed blocks.
+    *
+    * Archives are created from and turned back into a regular block log with construct() and extract(); nodeos
+    * itself keeps appending to the uncompressed block log.
+    */
+   class compressed_block_log {
+      public:
+         explicit compressed_block_log(const fc::path& file);
+         compressed_block_log(compressed_block_log&& other);
+         ~compressed_block_log();
+
+         /// Thread safe, returns nullptr if the block is not in the archive
+         signed_block_ptr     read_block_by_num(uint32_t block_num)const;
+
+         uint32_t             first_block_num()const;
+         uint32_t             last_block_num()const;
+         const genesis_state& genesis()const;
+
+         static const uint32_t version;
+         static const uint32_t default_blocks_per_chunk;
+
+         /// Writes all blocks of the block log in blocks_dir to a new archive, file only appears once it is complete
+         static void construct( const fc::path& blocks_dir, const fc::path& file, uint32_t blocks_per_chunk = default_blocks_per_chunk );
+
+         /// Recreates a block log in blocks_dir, which must not already hold one, from an archive
+         static void extract( const fc::path& file, const fc::path& blocks_dir );
+
+      private:
+         std::unique_ptr<detail::compressed_block_log_impl> my;
+   };
+
+} }
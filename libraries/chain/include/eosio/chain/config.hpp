@@ -19,6 +19,7 @@ const static auto default_reversible_guard_size = 2*1024*1024ll;/// 1MB * 340 bl
 
 const static auto default_state_dir_name     = "state";
 const static auto forkdb_filename            = "forkdb.dat";
+const static auto forkdb_journal_filename    = "forkdb.journal";
 const static auto default_state_size            = 1*1024*1024*1024ll;
 const static auto default_state_guard_size      =    128*1024*1024ll;
 
@@ -81,6 +82,7 @@ const static uint16_t   default_max_inline_action_depth        = 4;
 const static uint16_t   default_max_auth_depth                 = 6;
 const static uint32_t   default_sig_cpu_bill_pct               = 50 * percent_1; // billable percentage of signature recovery
 const static uint16_t   default_controller_thread_pool_size    = 2;
+const static uint32_t   replay_block_lookahead                 = 2; ///< blocks read ahead during replay so their transactions are prepared on the thread pool
 
 const static uint32_t   min_net_usage_delta_between_base_and_max_for_trx  = 10*1024;
 // Should be large enough to allow recovery from badly set blockchain parameters without a hard fork
@@ -97,6 +99,9 @@ const static uint32_t   hashing_checktime_block_size       = 10*1024;  /// call
 
 const static eosio::chain::wasm_interface::vm_type default_wasm_runtime = eosio::chain::wasm_interface::vm_type::wabt;
 const static uint32_t   default_abi_serializer_max_time_ms = 15*1000; ///< default deadline for abi serialization methods
+const static uint32_t   default_wasm_cache_max_modules     = 0;       ///< instantiated contracts kept in the wasm cache, 0 for no limit
+const static uint64_t   default_wasm_cache_max_size        = 0;       ///< bytes of instantiated contracts kept in the wasm cache, 0 for no limit
+const static uint32_t   default_sig_cache_size             = 10000;   ///< recovered signature keys kept in the signature recovery cache
 
 /**
  *  The number of sequential blocks produced by a single producer
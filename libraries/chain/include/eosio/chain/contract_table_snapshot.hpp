@@ -0,0 +1,120 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+
+#include <eosio/chain/contract_table_objects.hpp>
+#include <tuple>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Version 2 snapshots split the contract tables across sections "contract_tables.0", "contract_tables.1", ...
+    * each holding a range of table ids in the layout of the single "contract_tables" section of version 1
+    */
+   inline string contract_table_shard_name( size_t shard ) {
+      return "contract_tables." + std::to_string(shard);
+   }
+
+   /**
+    * The rows below mirror the snapshot form of the contract table objects, so that a section can be decoded away
+    * from the chainbase database the objects are then created in
+    */
+   struct snapshot_table_id_row {
+      account_name   code;
+      scope_name     scope;
+      table_name     table;
+      account_name   payer;
+      uint32_t       count = 0;
+   };
+
+   /// contract row data, packed and converted to a variant like shared_blob
+   struct snapshot_blob {
+      bytes data;
+   };
+
+   struct snapshot_key_value_row {
+      uint64_t       primary_key = 0;
+      account_name   payer;
+      snapshot_blob  value;
+   };
+
+   template<typename SecondaryKey>
+   struct snapshot_secondary_row {
+      uint64_t       primary_key = 0;
+      account_name   payer;
+      SecondaryKey   secondary_key;
+   };
+
+   template<typename Object>
+   struct snapshot_contract_row_type {
+      using type = snapshot_secondary_row<typename Object::secondary_key_type>;
+   };
+
+   template<>
+   struct snapshot_contract_row_type<key_value_object> {
+      using type = snapshot_key_value_row;
+   };
+
+   template<typename Object>
+   using snapshot_contract_row = typename snapshot_contract_row_type<Object>::type;
+
+   template<typename IndexSet>
+   struct snapshot_contract_rows;
+
+   /// one vector of decoded rows for each index of the set
+   template<typename ...Indices>
+   struct snapshot_contract_rows<index_set<Indices...>> {
+      using type = std::tuple<std::vector<snapshot_contract_row<typename Indices::value_type>>...>;
+   };
+
+   /// a contract table and its rows, decoded from a snapshot section
+   template<typename IndexSet>
+   struct snapshot_contract_table {
+      snapshot_table_id_row                          table;
+      typename snapshot_contract_rows<IndexSet>::type rows;
+   };
+
+   inline void assign_snapshot_row( key_value_object& row, const snapshot_key_value_row& value ) {
+      row.primary_key = value.primary_key;
+      row.payer = value.payer;
+      row.value.assign(value.value.data.data(), value.value.data.size());
+   }
+
+   template<typename Object, typename SecondaryKey>
+   void assign_snapshot_row( Object& row, const snapshot_secondary_row<SecondaryKey>& value ) {
+      row.primary_key = value.primary_key;
+      row.payer = value.payer;
+      row.secondary_key = value.secondary_key;
+   }
+
+   template<typename DataStream>
+   DataStream& operator << ( DataStream& ds, const snapshot_blob& b ) {
+      fc::raw::pack(ds, b.data);
+      return ds;
+   }
+
+   template<typename DataStream>
+   DataStream& operator >> ( DataStream& ds, snapshot_blob& b ) {
+      fc::raw::unpack(ds, b.data);
+      return ds;
+   }
+} }
+
+namespace fc {
+   inline
+   void to_variant( const eosio::chain::snapshot_blob& b, variant& v ) {
+      v = variant(base64_encode(b.data.data(), b.data.size()));
+   }
+
+   inline
+   void from_variant( const variant& v, eosio::chain::snapshot_blob& b ) {
+      string _s = base64_decode(v.as_string());
+      b.data = std::vector<char>(_s.begin(), _s.end());
+   }
+}
+
+FC_REFLECT(eosio::chain::snapshot_table_id_row, (code)(scope)(table)(payer)(count))
+FC_REFLECT(eosio::chain::snapshot_key_value_row, (primary_key)(payer)(value))
+FC_REFLECT_TEMPLATE((typename SecondaryKey), eosio::chain::snapshot_secondary_row<SecondaryKey>, (primary_key)(payer)(secondary_key))
@@ -73,6 +73,9 @@ public:
       flat_set<pair<account_name, action_name>> action_blacklist;
       flat_set<public_key_type> key_blacklist;
       path blocks_dir = chain::config::default_blocks_dir_name;
+      uint32_t blocks_log_stride = 0; ///< split the block log after every multiple of this block number, 0 to keep a single file
+      uint32_t max_retained_block_files = std::numeric_limits<uint32_t>::max();
+      path blocks_archive_dir; ///< where split off block log files beyond max_retained_block_files go, empty to delete them
       path state_dir = chain::config::default_state_dir_name;
       uint64_t state_size = chain::config::default_state_size;
       uint64_t state_guard_size = chain::config::default_state_guard_size;
@@ -80,11 +83,15 @@ public:
       uint64_t reversible_guard_size = chain::config::default_reversible_guard_size;
       uint32_t sig_cpu_bill_pct = chain::config::default_sig_cpu_bill_pct;
       uint16_t thread_pool_size = chain::config::default_controller_thread_pool_size;
+      uint32_t wasm_cache_max_modules = chain::config::default_wasm_cache_max_modules;
+      uint64_t wasm_cache_max_size = chain::config::default_wasm_cache_max_size;
+      uint32_t sig_cache_size = chain::config::default_sig_cache_size;
       bool read_only = false;
       bool force_all_checks = false;
       bool disable_replay_opts = false;
       bool contracts_console = false;
       bool allow_ram_billing_in_notify = false;
+      bool analyze_transaction_conflicts = false; ///< record per transaction read/write sets and log the conflicts between them
 
       genesis_state genesis;
       wasm_interface::vm_type wasm_runtime = chain::config::default_wasm_runtime;
@@ -226,7 +233,11 @@ public:
 
    block_id_type get_block_id_for_num(uint32_t block_num) const;
 
-   sha256 calculate_integrity_hash() const;
+   /**
+    *  Version 1 hashes every row of the state in a single pass, version 2 hashes its sections concurrently on the
+    *  thread pool into a merkle root of the section digests.  The two versions give different hashes.
+    */
+   sha256 calculate_integrity_hash(uint32_t version = 1) const;
    void write_snapshot(const snapshot_writer_ptr &snapshot) const;
 
    bool sender_avoids_whitelist_blacklist_enforcement(account_name sender) const;
@@ -259,6 +270,7 @@ public:
    bool skip_trx_checks() const;
 
    bool contracts_console() const;
+   bool analyze_transaction_conflicts() const;
 
    chain_id_type get_chain_id() const;
 
@@ -288,6 +300,7 @@ public:
 
    const apply_handler *find_apply_handler(account_name contract, scope_name scope, action_name act) const;
    wasm_interface &get_wasm_interface();
+   const wasm_interface &get_wasm_interface() const;
 
    optional<abi_serializer> get_abi_serializer(account_name n, const fc::microseconds &max_serialization_time) const
    {
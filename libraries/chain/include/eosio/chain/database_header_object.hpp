@@ -0,0 +1,53 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <eosio/chain/types.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include "multi_index_includes.hpp"
+
+namespace eosio { namespace chain {
+   /**
+    *  @brief records the layout version of the objects in the state database
+    *  @ingroup object
+    *
+    *  chainbase finds an index by the name of its object type only, so a state database written by a build with a
+    *  different layout of an index would be reinterpreted silently. Every database gets a single header object when
+    *  it is initialized, and a database whose version is not supported is refused at startup.
+    */
+   class database_header_object : public chainbase::object<database_header_object_type, database_header_object>
+   {
+         OBJECT_CTOR(database_header_object)
+
+         /**
+          *  VERSION HISTORY
+          *  - Version 1: transactions are deduplicated by a hashed index of their ids and expired by second
+          */
+         static constexpr uint32_t current_version = 1;
+         static constexpr uint32_t minimum_version = 1;
+
+         id_type        id;
+         uint32_t       version = current_version;
+
+         void validate()const {
+            EOS_ASSERT( version >= minimum_version && version <= current_version, bad_database_version_exception,
+                        "state database version is ${version} while this build supports versions ${min} to ${max}, "
+                        "please restore from a compatible snapshot or replay",
+                        ("version", version)("min", minimum_version)("max", current_version) );
+         }
+   };
+
+   using database_header_multi_index = chainbase::shared_multi_index_container<
+      database_header_object,
+      indexed_by<
+         ordered_unique<tag<by_id>, BOOST_MULTI_INDEX_MEMBER(database_header_object, database_header_object::id_type, id)>
+      >
+   >;
+
+} }
+
+CHAINBASE_SET_INDEX_TYPE(eosio::chain::database_header_object, eosio::chain::database_header_multi_index)
+
+FC_REFLECT( eosio::chain::database_header_object, (version) )
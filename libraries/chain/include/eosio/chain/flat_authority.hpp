@@ -0,0 +1,86 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <eosio/chain/authority.hpp>
+
+#include <algorithm>
+
+namespace eosio { namespace chain {
+
+   /**
+    *  An authority laid out for evaluation: one array of entries already in the order authority_checker visits them,
+    *  so checking it needs neither the meta_permission set nor any other allocation. Keys are matched through a 64 bit
+    *  hash of their serialized form first and compared in full only when the hash matches.
+    */
+   struct flat_authority {
+      /// same order as the types of detail::meta_permission, ties in weight are visited from the highest type down
+      enum entry_type : uint8_t {
+         account_entry = 0,
+         key_entry     = 1,
+         wait_entry    = 2
+      };
+
+      struct entry {
+         permission_level permission; ///< account_entry
+         uint64_t         key_hash = 0; ///< key_entry
+         uint32_t         value = 0; ///< wait_sec of a wait_entry, index into keys of a key_entry
+         weight_type      weight = 0;
+         entry_type       type = account_entry;
+      };
+
+      uint32_t                threshold = 0;
+      vector<entry>           entries;
+      vector<public_key_type> keys;
+
+      flat_authority() = default;
+
+      template<typename Authority>
+      explicit flat_authority( const Authority& auth )
+      :threshold( auth.threshold )
+      {
+         entries.reserve( auth.waits.size() + auth.keys.size() + auth.accounts.size() );
+         keys.reserve( auth.keys.size() );
+         for( const auto& w : auth.waits ) {
+            entry e;
+            e.type = wait_entry;
+            e.weight = w.weight;
+            e.value = w.wait_sec;
+            entries.push_back( e );
+         }
+         for( const auto& k : auth.keys ) {
+            entry e;
+            e.type = key_entry;
+            e.weight = k.weight;
+            e.key_hash = key_hash( k.key );
+            e.value = keys.size();
+            keys.push_back( k.key );
+            entries.push_back( e );
+         }
+         for( const auto& a : auth.accounts ) {
+            entry e;
+            e.type = account_entry;
+            e.weight = a.weight;
+            e.permission = a.permission;
+            entries.push_back( e );
+         }
+         // matches meta_permission_comparator; stable so equal entries keep their declared order like the flat_multiset
+         std::stable_sort( entries.begin(), entries.end(), []( const entry& lhs, const entry& rhs ) {
+            return std::tie( lhs.weight, lhs.type ) > std::tie( rhs.weight, rhs.type );
+         });
+      }
+
+      /// FNV-1a over the serialized key
+      static uint64_t key_hash( const public_key_type& key ) {
+         char buffer[128];
+         fc::datastream<char*> ds( buffer, sizeof(buffer) );
+         fc::raw::pack( ds, key );
+         uint64_t h = 0xcbf29ce484222325ULL;
+         for( size_t i = 0; i < ds.tellp(); ++i )
+            h = (h ^ uint8_t(buffer[i])) * 0x100000001b3ULL;
+         return h;
+      }
+   };
+
+} } // namespace eosio::chain
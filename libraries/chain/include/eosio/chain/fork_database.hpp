@@ -18,6 +18,9 @@ namespace eosio { namespace chain {
     * database tracks the longest chain and the last irreversible block number. All
     * blocks older than the last irreversible block are freed after emitting the
     * irreversible signal.
+    *
+    * Every change is appended to a journal in data_dir as it is made, the fork
+    * database is rebuilt from it on construction, also after a crash.
     */
    class fork_database {
       public:
@@ -1,6 +1,8 @@
 #pragma once
 #include <eosio/chain/types.hpp>
 
+namespace boost { namespace asio { class thread_pool; } }
+
 namespace eosio { namespace chain {
 
    digest_type make_canonical_left(const digest_type& val);
@@ -19,4 +21,10 @@ namespace eosio { namespace chain {
     */
    digest_type merkle( vector<digest_type> ids );
 
+   /**
+    *  Same root as merkle(ids), but levels with many nodes are hashed in chunks on the thread pool.
+    *  Must not be called from a thread of pool.
+    */
+   digest_type merkle( vector<digest_type> ids, boost::asio::thread_pool& pool );
+
 } } /// eosio::chain
@@ -3,6 +3,7 @@
 #include <eosio/chain/types.hpp>
 #include <eosio/chain/snapshot.hpp>
 #include <chainbase/chainbase.hpp>
+#include <memory>
 #include <set>
 
 namespace eosio { namespace chain { namespace resource_limits {
@@ -36,15 +37,40 @@ namespace eosio { namespace chain { namespace resource_limits {
    };
 
    class resource_limits_manager {
+         struct pending_usage;
+
       public:
-         explicit resource_limits_manager(chainbase::database& db)
-         :_db(db)
-         {
-         }
+         /**
+          * Account CPU/NET usage billed while a block is being built is accumulated in memory and only
+          * written to chainbase by process_block_usage.  A usage_session scopes the accumulated changes
+          * the same way a chainbase::database::session scopes database changes; open one next to every
+          * undo session that may bill accounts.  An active session is undone when it is destroyed.
+          */
+         class usage_session {
+            public:
+               usage_session( usage_session&& other );
+               usage_session& operator=( usage_session&& other );
+               ~usage_session();
+
+               void squash();
+               void undo();
+
+            private:
+               friend class resource_limits_manager;
+               explicit usage_session( resource_limits_manager& manager );
+
+               resource_limits_manager* _manager = nullptr;
+               size_t                   _depth = 0;
+         };
+
+         explicit resource_limits_manager(chainbase::database& db);
+         ~resource_limits_manager();
 
          void add_indices();
          void initialize_database();
          void add_to_snapshot( const snapshot_writer_ptr& snapshot ) const;
+         /// the sections of add_to_snapshot as parts that can be written independently, see add_index_snapshot_parts
+         void add_snapshot_parts( uint64_t rows_per_part, std::vector<snapshot_part>& parts ) const;
          void read_from_snapshot( const snapshot_reader_ptr& snapshot );
 
          void initialize_account( const account_name& account );
@@ -53,6 +79,10 @@ namespace eosio { namespace chain { namespace resource_limits {
          void update_account_usage( const flat_set<account_name>& accounts, uint32_t ordinal );
          void add_transaction_usage( const flat_set<account_name>& accounts, uint64_t cpu_usage, uint64_t net_usage, uint32_t ordinal );
 
+         usage_session start_usage_session();
+         void flush_pending_usage();   ///< write the usage accumulated in memory to chainbase
+         void clear_pending_usage();   ///< drop the usage accumulated in memory, e.g. when the pending block is aborted
+
          void add_pending_ram_usage( const account_name account, int64_t ram_delta );
          void verify_account_ram_usage( const account_name accunt )const;
 
@@ -79,7 +109,8 @@ namespace eosio { namespace chain { namespace resource_limits {
          int64_t get_account_ram_usage( const account_name& name ) const;
 
       private:
-         chainbase::database& _db;
+         chainbase::database&            _db;
+         std::unique_ptr<pending_usage>  _pending;
    };
 } } } /// eosio::chain
 
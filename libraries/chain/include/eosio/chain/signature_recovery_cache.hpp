@@ -0,0 +1,60 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <eosio/chain/types.hpp>
+#include <eosio/chain/config.hpp>
+
+#include <array>
+#include <memory>
+
+namespace eosio { namespace chain {
+
+   /**
+    *  Public keys recovered from transaction signatures, shared by every thread that recovers keys.
+    *
+    *  Entries are spread over a fixed number of shards by signature hash, each shard has its own lock, LRU list
+    *  and an equal share of the capacity, so recovery on the thread pool workers rarely contends on the same lock.
+    *  A signature is only a hit for the transaction it was recovered for.
+    */
+   class signature_recovery_cache {
+      public:
+         struct cache_stats {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t evictions = 0;
+            uint32_t entries = 0;
+            uint32_t capacity = 0;
+         };
+
+         static constexpr uint32_t shard_count = 64;
+
+         explicit signature_recovery_cache( uint32_t capacity = config::default_sig_cache_size );
+         ~signature_recovery_cache();
+
+         /// the cache used by transaction::get_signature_keys
+         static signature_recovery_cache& instance();
+
+         /// capacity is rounded up to a multiple of shard_count, shrinking evicts immediately
+         void set_capacity( uint32_t capacity );
+
+         /// true if sig was recovered for trx_id before, then pub_key and cpu_usage hold the earlier result
+         bool find( const signature_type& sig, const transaction_id_type& trx_id,
+                    public_key_type& pub_key, fc::microseconds& cpu_usage );
+
+         void insert( const signature_type& sig, const transaction_id_type& trx_id,
+                      const public_key_type& pub_key, fc::microseconds cpu_usage );
+
+         cache_stats get_stats()const;
+
+      private:
+         struct shard;
+         shard& shard_for( const signature_type& sig );
+
+         std::array<std::unique_ptr<shard>, shard_count> _shards;
+   };
+
+} } /// eosio::chain
+
+FC_REFLECT( eosio::chain::signature_recovery_cache::cache_stats, (hits)(misses)(evictions)(entries)(capacity) )
@@ -6,16 +6,39 @@
 
 #include <eosio/chain/database_utils.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/multi_index_includes.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <fc/variant_object.hpp>
+#include <fc/scoped_exit.hpp>
+#include <fc/time.hpp>
 #include <boost/core/demangle.hpp>
+#include <deque>
+#include <functional>
+#include <map>
 #include <ostream>
+#include <sstream>
+#include <unordered_map>
 
 namespace eosio { namespace chain {
    /**
     * History:
     * Version 1: initial version with string identified sections and rows
+    * Version 2: binary snapshots end with a directory of their sections, contract tables are split across sections
+    * Version 3: binary snapshots index the size of every row, which deltas rely on
     */
-   static const uint32_t current_snapshot_version = 1;
+   static const uint32_t current_snapshot_version = 3;
+   static const uint32_t minimum_snapshot_version = 1;
+
+   /**
+    * Where a section landed in a binary snapshot and what it took to serialize it
+    */
+   struct snapshot_section_stats {
+      std::string      name;
+      uint64_t         offset = 0;  ///< position of the section relative to the start of the snapshot
+      uint64_t         rows = 0;
+      uint64_t         size = 0;    ///< bytes taken by the section, header included
+      fc::microseconds elapsed;     ///< time spent serializing the rows of the section
+   };
 
    namespace detail {
       template<typename T>
@@ -114,8 +137,61 @@ namespace eosio { namespace chain {
       snapshot_row_writer<T> make_row_writer( const T& data) {
          return snapshot_row_writer<T>(data);
       }
+
+      /**
+       * A row index holds the size of every row of a section as a varint, so that rows can be handed out as bytes
+       */
+      inline void append_row_size( std::string& index, uint64_t size ) {
+         do {
+            uint8_t b = uint8_t(size) & 0x7f;
+            size >>= 7;
+            b |= ((size > 0) << 7);
+            index.push_back(char(b));
+         } while( size );
+      }
+
+      inline uint64_t next_row_size( const std::string& index, size_t& pos ) {
+         uint64_t size = 0;
+         uint8_t  shift = 0;
+         uint8_t  b = 0;
+         do {
+            EOS_ASSERT(pos < index.size() && shift < 64, snapshot_exception, "Snapshot row index is corrupt");
+            b = uint8_t(index[pos++]);
+            size |= uint64_t(b & 0x7f) << shift;
+            shift += 7;
+         } while( b & 0x80 );
+         return size;
+      }
+
+      /**
+       * Digest of the sections and rows of a snapshot in the order they were written, identifying the state a
+       * snapshot holds whether it is stored in full or as a delta
+       */
+      class snapshot_state_digest {
+         public:
+            void add_section_start( const std::string& section_name ) {
+               enc.write(section_name.c_str(), section_name.size() + 1);
+            }
+
+            void add_rows( const char* data, size_t size ) {
+               enc.write(data, size);
+            }
+
+            void add_section_end( uint64_t row_count ) {
+               enc.write((const char*)&row_count, sizeof(row_count));
+            }
+
+            fc::sha256 result() {
+               return enc.result();
+            }
+
+         private:
+            fc::sha256::encoder enc;
+      };
    }
 
+   class section_buffer_writer;
+
    class snapshot_writer {
       public:
          class section_writer {
@@ -148,16 +224,68 @@ namespace eosio { namespace chain {
             write_section(detail::snapshot_section_traits<T>::section_name(), f);
          }
 
+         /**
+          * Writes the sections named by section_names in order, f(i, section) adding the rows of the i-th one.
+          * Writers that accept buffered sections have up to max_pending of them serialized ahead on pool, so f
+          * must be safe to call from several threads at once.
+          */
+         template<typename F>
+         void write_sections(const std::vector<std::string>& section_names, F f, boost::asio::thread_pool& pool, size_t max_pending);
+
       virtual ~snapshot_writer(){};
 
       protected:
+         friend class buffered_snapshot_writer;
+
          virtual void write_start_section( const std::string& section_name ) = 0;
          virtual void write_row( const detail::abstract_snapshot_row_writer& row_writer ) = 0;
          virtual void write_end_section() = 0;
+
+         virtual bool accepts_buffered_sections() const { return false; }
+         virtual void write_buffered_section( const std::shared_ptr<section_buffer_writer>& buffer );
    };
 
    using snapshot_writer_ptr = std::shared_ptr<snapshot_writer>;
 
+   /// writes some of the sections of a state, independently of the other parts
+   using snapshot_part = std::function<void(const snapshot_writer_ptr&)>;
+
+   /**
+    * Adds the parts writing the index of Utils, one per range of rows_per_part rows in id order, so that a large
+    * index can be hashed on several threads.  A single part keeps the section name, several are named <section>.<n>.
+    */
+   template<typename Utils>
+   void add_index_snapshot_parts( const chainbase::database& db, uint64_t rows_per_part, std::vector<snapshot_part>& parts ) {
+      using value_t = typename Utils::index_t::value_type;
+      using id_t = typename value_t::id_type;
+
+      std::vector<std::pair<id_t, id_t>> ranges;
+      uint64_t rows = 0;
+      Utils::walk(db, [&ranges, &rows, rows_per_part]( const value_t& row ) {
+         if (ranges.empty() || rows >= rows_per_part) {
+            ranges.emplace_back(row.id, row.id);
+            rows = 0;
+         }
+         ranges.back().second = id_t(row.id._id + 1);
+         ++rows;
+      });
+      if (ranges.empty()) {
+         ranges.emplace_back(id_t(0), id_t(0));
+      }
+
+      const auto name = detail::snapshot_section_traits<value_t>::section_name();
+      for (size_t i = 0; i < ranges.size(); ++i) {
+         auto section_name = ranges.size() == 1 ? name : name + "." + std::to_string(i);
+         parts.emplace_back([&db, range = ranges[i], section_name]( const snapshot_writer_ptr& snapshot ) {
+            snapshot->write_section(section_name, [&db, &range]( auto& section ) {
+               Utils::template walk_range<by_id>(db, range.first, range.second, [&db, &section]( const auto& row ) {
+                  section.add_row(row, db);
+               });
+            });
+         });
+      }
+   }
+
    namespace detail {
       struct abstract_snapshot_row_reader {
          virtual void provide(std::istream& in) const = 0;
@@ -281,16 +409,77 @@ namespace eosio { namespace chain {
          return has_section(suffix + detail::snapshot_section_traits<T>::section_name());
       }
 
+      /**
+       * Reads the sections named by section_names in order: decode(i, section) turns the i-th one into a value that
+       * apply(i, value) consumes on the calling thread.  Readers that provide buffered sections run decode on pool
+       * for up to max_pending sections ahead of apply, so decode must be safe to call from several threads at once.
+       */
+      template<typename Decode, typename Apply>
+      void read_sections(const std::vector<std::string>& section_names, Decode decode, Apply apply, boost::asio::thread_pool& pool, size_t max_pending) {
+         if (!provides_buffered_sections() || max_pending == 0) {
+            for (size_t i = 0; i < section_names.size(); ++i) {
+               read_section(section_names[i], [&](auto& section) {
+                  apply(i, decode(i, section));
+               });
+            }
+            return;
+         }
+
+         using decoded_t = std::decay_t<decltype(decode(size_t(), std::declval<section_reader&>()))>;
+         std::deque<std::future<decoded_t>> pending;
+
+         // the decoding tasks reference decode and section_names, never leave while one of them may still run
+         auto wait_pending = fc::make_scoped_exit([&pending]() {
+            for (auto& p : pending) {
+               if (p.valid()) p.wait();
+            }
+         });
+
+         size_t next = 0;
+         auto schedule = [&]() {
+            while (next < section_names.size() && pending.size() < max_pending) {
+               const size_t i = next++;
+               auto buffer = read_buffered_section(section_names[i]);
+               pending.emplace_back(async_thread_pool(pool, [&decode, &section_names, buffer, i]() {
+                  decoded_t result;
+                  buffer->read_section(section_names[i], [&](auto& section) {
+                     result = decode(i, section);
+                  });
+                  return result;
+               }));
+            }
+         };
+
+         schedule();
+         for (size_t i = 0; !pending.empty(); ++i) {
+            auto decoded = pending.front().get();
+            pending.pop_front();
+            schedule();
+            apply(i, std::move(decoded));
+         }
+      }
+
+      virtual bool has_section( const std::string& section_name ) = 0;
+
       virtual void validate() const = 0;
 
       virtual ~snapshot_reader(){};
 
       protected:
-         virtual bool has_section( const std::string& section_name ) = 0;
+         friend class delta_snapshot_writer;
+         friend class delta_snapshot_reader;
+
          virtual void set_section( const std::string& section_name ) = 0;
          virtual bool read_row( detail::abstract_snapshot_row_reader& row_reader ) = 0;
          virtual bool empty( ) = 0;
          virtual void clear_section() = 0;
+
+         virtual bool provides_buffered_sections() const { return false; }
+         virtual std::shared_ptr<snapshot_reader> read_buffered_section( const std::string& section_name );
+
+         /// readers that know where each row ends hand out the rows of the current section as bytes, for deltas
+         virtual bool read_raw_row( std::string& row );
+         virtual fc::sha256 state_digest();
    };
 
    using snapshot_reader_ptr = std::shared_ptr<snapshot_reader>;
@@ -327,6 +516,104 @@ namespace eosio { namespace chain {
          uint64_t cur_row;
    };
 
+   /**
+    * Serializes the rows of a single section in memory, in the binary snapshot format, so that the section can be
+    * built on another thread than the ostream_snapshot_writer it is appended to.
+    */
+   class section_buffer_writer : public snapshot_writer {
+      public:
+         section_buffer_writer();
+
+         void write_start_section( const std::string& section_name ) override;
+         void write_row( const detail::abstract_snapshot_row_writer& row_writer ) override;
+         void write_end_section( ) override;
+
+         const std::string& name() const { return section_name; }
+         uint64_t row_count() const { return rows; }
+         uint64_t size() const;
+         fc::microseconds elapsed() const { return serialize_time; }
+         const std::vector<uint32_t>& row_sizes() const { return sizes; }
+
+         /// appends the serialized rows to out
+         void write_to( std::ostream& out );
+
+         /// a copy of the serialized rows
+         std::string contents() const { return data.str(); }
+
+      private:
+         std::stringstream       data;
+         detail::ostream_wrapper wrapper;
+         std::string             section_name;
+         uint64_t                rows = 0;
+         std::vector<uint32_t>   sizes;
+         fc::time_point          start;
+         fc::microseconds        serialize_time;
+   };
+
+   /**
+    * Reads the rows of a single section that a binary snapshot reader has copied to memory
+    */
+   class section_buffer_reader : public snapshot_reader {
+      public:
+         section_buffer_reader( std::string section_name, uint64_t row_count, std::string rows );
+
+         void validate() const override;
+         bool has_section( const string& section_name ) override;
+         void set_section( const string& section_name ) override;
+         bool read_row( detail::abstract_snapshot_row_reader& row_reader ) override;
+         bool empty ( ) override;
+         void clear_section() override;
+
+      private:
+         std::string        section_name;
+         std::istringstream data;
+         uint64_t           num_rows;
+         uint64_t           cur_row;
+   };
+
+   template<typename F>
+   void snapshot_writer::write_sections(const std::vector<std::string>& section_names, F f, boost::asio::thread_pool& pool, size_t max_pending) {
+      if (!accepts_buffered_sections() || max_pending == 0) {
+         for (size_t i = 0; i < section_names.size(); ++i) {
+            write_section(section_names[i], [&](auto& section) {
+               f(i, section);
+            });
+         }
+         return;
+      }
+
+      std::deque<std::future<std::shared_ptr<section_buffer_writer>>> pending;
+
+      // the serializing tasks reference f and section_names, never leave while one of them may still run
+      auto wait_pending = fc::make_scoped_exit([&pending]() {
+         for (auto& p : pending) {
+            if (p.valid()) p.wait();
+         }
+      });
+
+      size_t next = 0;
+      auto schedule = [&]() {
+         while (next < section_names.size() && pending.size() < max_pending) {
+            const size_t i = next++;
+            pending.emplace_back(async_thread_pool(pool, [&f, &section_names, i]() {
+               auto buffer = std::make_shared<section_buffer_writer>();
+               buffer->write_section(section_names[i], [&](auto& section) {
+                  f(i, section);
+               });
+               return buffer;
+            }));
+         }
+      };
+
+      schedule();
+      while (!pending.empty()) {
+         auto buffer = pending.front().get();
+         pending.pop_front();
+         schedule();
+         write_buffered_section(buffer);
+      }
+   }
+
    class ostream_snapshot_writer : public snapshot_writer {
       public:
          explicit ostream_snapshot_writer(std::ostream& snapshot);
@@ -336,13 +623,24 @@ namespace eosio { namespace chain {
          void write_end_section( ) override;
          void finalize();
 
+         bool accepts_buffered_sections() const override { return true; }
+         void write_buffered_section( const std::shared_ptr<section_buffer_writer>& buffer ) override;
+
+         /// one entry per section written so far, in snapshot order
+         const std::vector<snapshot_section_stats>& section_stats() const { return stats; }
+
          static const uint32_t magic_number = 0x30510550;
 
       private:
-         detail::ostream_wrapper snapshot;
-         std::streampos          header_pos;
-         std::streampos          section_pos;
-         uint64_t                row_count;
+         detail::ostream_wrapper             snapshot;
+         std::streampos                      header_pos;
+         std::streampos                      section_pos;
+         uint64_t                            row_count;
+         std::string                         section_name;
+         fc::time_point                      section_start;
+         std::string                         row_index;
+         std::vector<std::string>            row_indexes;
+         std::vector<snapshot_section_stats> stats;
 
    };
 
@@ -357,13 +655,175 @@ namespace eosio { namespace chain {
          bool empty ( ) override;
          void clear_section() override;
 
+         bool provides_buffered_sections() const override { return true; }
+         std::shared_ptr<snapshot_reader> read_buffered_section( const std::string& section_name ) override;
+
+         bool read_raw_row( std::string& row ) override;
+         fc::sha256 state_digest() override;
+
+         /// names of the sections in the order they were written
+         std::vector<std::string> section_names();
+
       private:
-         bool validate_section() const;
+         struct section_entry {
+            std::streampos pos;             ///< start of the section, at its size field
+            uint64_t       size = 0;        ///< bytes following the size field
+            uint64_t       rows = 0;
+            uint64_t       index_offset = 0;
+            uint64_t       index_size = 0;  ///< bytes of the row index, none before version 3
+         };
+
+         using section_map = std::map<std::string, section_entry>;
+
+         uint32_t read_header() const;
+         section_entry read_section_entry( std::streampos pos, const std::string& section_name ) const;
+         section_map scan_sections() const;
+         section_map read_directory( uint32_t version ) const;
+         std::string read_row_index( const section_entry& entry ) const;
+         void load_sections();
+         const section_entry& find_section( const std::string& section_name );
 
          std::istream&  snapshot;
          std::streampos header_pos;
          uint64_t       num_rows;
          uint64_t       cur_row;
+         section_map    sections;
+         bool           sections_loaded;
+         uint32_t       version;
+         bool           digest_computed;  ///< the digest is only taken when a delta needs it
+         fc::sha256     digest;
+         const section_entry* cur_section;
+         std::string          cur_row_index;
+         size_t               cur_row_index_pos;
+   };
+
+   /**
+    * Captures every section in memory, so that the state can be taken on the thread that owns the database and
+    * written out by an ostream_snapshot_writer or a delta_snapshot_writer on another thread while the chain moves on.
+    */
+   class buffered_snapshot_writer : public snapshot_writer {
+      public:
+         void write_start_section( const std::string& section_name ) override;
+         void write_row( const detail::abstract_snapshot_row_writer& row_writer ) override;
+         void write_end_section( ) override;
+
+         bool accepts_buffered_sections() const override { return true; }
+         void write_buffered_section( const std::shared_ptr<section_buffer_writer>& buffer ) override;
+
+         /// bytes of row data captured
+         uint64_t size() const;
+
+         /// appends the captured sections to out, releasing each once written; out still has to be finalized
+         void write_to( snapshot_writer& out );
+
+      private:
+         std::vector<std::shared_ptr<section_buffer_writer>> sections;
+   };
+
+   /**
+    * One step of rebuilding a section from the base snapshot: copy or skip the next rows of the base, insert a row
+    * that is new, or continue at the first row of another base section.  Rows are taken from the same section of
+    * the base until the first switch.
+    */
+   struct snapshot_delta_op {
+      enum kind_t : uint8_t {
+         copy = 0,
+         skip = 1,
+         insert = 2,
+         base = 3
+      };
+
+      uint8_t  kind = copy;
+      uint32_t count = 0;  ///< rows copied or skipped
+      bytes    row;        ///< the inserted row, or the name of the base section to continue at
+   };
+
+   struct snapshot_delta_header {
+      fc::sha256 base_digest;   ///< state digest of the snapshot the delta applies to
+      fc::sha256 state_digest;  ///< state digest of the snapshot the delta stands for
+   };
+
+   /**
+    * Writes only the rows that changed since a base snapshot.  Every section is written as a binary section of
+    * snapshot_delta_op rows against the same section of the base, which must be a binary snapshot of version 3 or
+    * later, or a delta_snapshot_reader on top of one.  Numbered sections such as the contract table shards
+    * <name>.<n> take rows from any <name>.<k> of the base, since their boundaries move as the state changes; the
+    * rows of all of them are held in memory while those sections are written.
+    */
+   class delta_snapshot_writer : public snapshot_writer {
+      public:
+         delta_snapshot_writer( const snapshot_reader_ptr& base, std::ostream& delta );
+
+         void write_start_section( const std::string& section_name ) override;
+         void write_row( const detail::abstract_snapshot_row_writer& row_writer ) override;
+         void write_end_section( ) override;
+         void finalize();
+
+         bool accepts_buffered_sections() const override { return true; }
+         void write_buffered_section( const std::shared_ptr<section_buffer_writer>& buffer ) override;
+
+         const std::vector<snapshot_section_stats>& section_stats() const { return out.section_stats(); }
+         uint64_t copied_rows() const { return copied; }
+         uint64_t inserted_rows() const { return inserted; }
+
+      private:
+         void load_base( const std::string& section_name );
+         void write_delta( const section_buffer_writer& buffer );
+
+         snapshot_reader_ptr                    base;
+         fc::sha256                             base_digest;
+         ostream_snapshot_writer                out;
+         detail::snapshot_state_digest          digest;
+         std::shared_ptr<section_buffer_writer> current;
+         uint64_t                               copied = 0;
+         uint64_t                               inserted = 0;
+
+         // rows of the base sections the current section may take rows from, one after another
+         bool                                        base_loaded = false;
+         bool                                        base_numbered = false;
+         std::string                                 base_group;     ///< the section, or <name>. of numbered sections
+         std::vector<std::string>                    base_rows;
+         std::vector<std::pair<std::string, size_t>> base_sections;  ///< name and first row in base_rows
+         std::unordered_multimap<size_t, size_t>     base_positions; ///< hash of a row to its positions in base_rows
+   };
+
+   /**
+    * Reads the state a delta snapshot stands for, replaying it on top of its base.  Bases may themselves be deltas.
+    * validate() rebuilds the whole state once to check it against the state digest of the delta, the bases are only
+    * checked to be the states the layers above them were taken against.
+    */
+   class delta_snapshot_reader : public snapshot_reader {
+      public:
+         delta_snapshot_reader( const snapshot_reader_ptr& base, std::istream& delta );
+
+         void validate() const override;
+         bool has_section( const string& section_name ) override;
+         void set_section( const string& section_name ) override;
+         bool read_row( detail::abstract_snapshot_row_reader& row_reader ) override;
+         bool empty ( ) override;
+         void clear_section() override;
+
+         bool read_raw_row( std::string& row ) override;
+         fc::sha256 state_digest() override;
+
+      private:
+         void next_row( std::string& row );
+         fc::sha256 replay_state_digest();
+
+         void set_base_section( const std::string& section_name );
+
+         snapshot_reader_ptr            base;
+         std::istream&                  delta_stream;
+         istream_snapshot_reader        delta;
+         snapshot_delta_header          header;
+         std::vector<snapshot_delta_op> ops;
+         size_t                         cur_op;
+         uint32_t                       cur_op_done;
+         uint64_t                       num_rows;
+         uint64_t                       cur_row;
+         bool                           base_section;  ///< whether base is positioned in a section
+         std::string                    section_name;
+         std::string                    scratch;
    };
 
    class integrity_hash_snapshot_writer : public snapshot_writer {
@@ -380,4 +840,25 @@ namespace eosio { namespace chain {
 
    };
 
+   /**
+    * Hashes the name and rows of every section on its own, for integrity hashes that combine section digests
+    */
+   class section_digest_snapshot_writer : public snapshot_writer {
+      public:
+         void write_start_section( const std::string& section_name ) override;
+         void write_row( const detail::abstract_snapshot_row_writer& row_writer ) override;
+         void write_end_section( ) override;
+
+         /// one digest per section written, in order
+         const std::vector<fc::sha256>& section_digests() const { return digests; }
+
+      private:
+         fc::sha256::encoder     enc;
+         uint64_t                rows = 0;
+         std::vector<fc::sha256> digests;
+   };
+
 }}
+
+FC_REFLECT(eosio::chain::snapshot_delta_op, (kind)(count)(row))
+FC_REFLECT(eosio::chain::snapshot_delta_header, (base_digest)(state_digest))
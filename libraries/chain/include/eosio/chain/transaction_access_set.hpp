@@ -0,0 +1,116 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#pragma once
+#include <eosio/chain/types.hpp>
+
+namespace eosio { namespace chain {
+
+   /**
+    *  Identifies a piece of chain state touched by a transaction. Contract table rows are tracked per
+    *  (code, scope, table); an empty scope and table refers to the account level state of `code`
+    *  (account object, permissions and resource usage).
+    */
+   struct state_access_key {
+      account_name code;
+      scope_name   scope;
+      table_name   table;
+
+      friend bool operator < ( const state_access_key& a, const state_access_key& b ) {
+         return std::tie( a.code, a.scope, a.table ) < std::tie( b.code, b.scope, b.table );
+      }
+      friend bool operator == ( const state_access_key& a, const state_access_key& b ) {
+         return std::tie( a.code, a.scope, a.table ) == std::tie( b.code, b.scope, b.table );
+      }
+   };
+
+   /**
+    *  The read and write set of one transaction, recorded while it executes.
+    *
+    *  Global and per-receiver sequence numbers are not part of the sets, they would be assigned in receipt
+    *  order when results are committed.
+    */
+   struct transaction_access_set {
+      flat_set<state_access_key> reads;
+      flat_set<state_access_key> writes;
+      bool                       exclusive = false; ///< touched state that is not tracked per key, conflicts with everything
+
+      void add_read( account_name code, scope_name scope = scope_name(), table_name table = table_name() ) {
+         reads.insert( state_access_key{code, scope, table} );
+      }
+
+      void add_write( account_name code, scope_name scope = scope_name(), table_name table = table_name() ) {
+         writes.insert( state_access_key{code, scope, table} );
+      }
+
+      bool conflicts_with( const transaction_access_set& other )const {
+         if( exclusive || other.exclusive ) return true;
+         return intersects( writes, other.writes ) || intersects( writes, other.reads ) || intersects( reads, other.writes );
+      }
+
+      private:
+         static bool intersects( const flat_set<state_access_key>& a, const flat_set<state_access_key>& b ) {
+            auto ai = a.begin();
+            auto bi = b.begin();
+            while( ai != a.end() && bi != b.end() ) {
+               if( *ai < *bi )      ++ai;
+               else if( *bi < *ai ) ++bi;
+               else                 return true;
+            }
+            return false;
+         }
+   };
+
+   /**
+    *  Assigns each transaction, given in receipt order, the earliest wave in which it could execute
+    *  concurrently with the other transactions of that wave without changing the result of serial execution.
+    *  A transaction is placed after every earlier transaction it conflicts with.
+    *
+    *  @return wave number (starting at 0) for each transaction
+    */
+   inline vector<uint32_t> schedule_access_waves( const vector<transaction_access_set>& sets ) {
+      vector<uint32_t> waves;
+      waves.reserve( sets.size() );
+
+      map<state_access_key, uint32_t> next_after_write; // first wave allowed to read or write a key
+      map<state_access_key, uint32_t> next_after_read;  // first wave allowed to write a key
+      uint32_t barrier = 0;   // first wave allowed after the last exclusive transaction
+      uint32_t max_wave = 0;
+
+      for( const auto& s : sets ) {
+         uint32_t wave = barrier;
+         if( s.exclusive ) {
+            wave = waves.empty() ? 0 : max_wave + 1;
+         } else {
+            auto bump = [&wave]( const map<state_access_key, uint32_t>& m, const state_access_key& k ) {
+               auto itr = m.find( k );
+               if( itr != m.end() ) wave = std::max( wave, itr->second );
+            };
+            for( const auto& k : s.reads )  bump( next_after_write, k );
+            for( const auto& k : s.writes ) { bump( next_after_write, k ); bump( next_after_read, k ); }
+         }
+
+         if( s.exclusive ) {
+            barrier = wave + 1;
+         } else {
+            for( const auto& k : s.reads ) {
+               auto& r = next_after_read[k];
+               r = std::max( r, wave + 1 );
+            }
+            for( const auto& k : s.writes ) {
+               next_after_write[k] = wave + 1;
+               auto& r = next_after_read[k];
+               r = std::max( r, wave + 1 );
+            }
+         }
+
+         max_wave = std::max( max_wave, wave );
+         waves.push_back( wave );
+      }
+      return waves;
+   }
+
+} } /// namespace eosio::chain
+
+FC_REFLECT( eosio::chain::state_access_key, (code)(scope)(table) )
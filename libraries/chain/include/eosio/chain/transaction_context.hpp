@@ -1,6 +1,8 @@
 #pragma once
 #include <eosio/chain/controller.hpp>
+#include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/trace.hpp>
+#include <eosio/chain/transaction_access_set.hpp>
 #include <signal.h>
 
 namespace eosio { namespace chain {
@@ -80,6 +82,7 @@ namespace eosio { namespace chain {
          const signed_transaction&     trx;
          transaction_id_type           id;
          optional<chainbase::database::session>  undo_session;
+         optional<resource_limits::resource_limits_manager::usage_session>  usage_session; ///< opened and closed together with undo_session
          transaction_trace_ptr         trace;
          fc::time_point                start;
 
@@ -103,6 +106,8 @@ namespace eosio { namespace chain {
          int64_t                       billed_cpu_time_us = 0;
          bool                          explicit_billed_cpu_time = false;
 
+         optional<transaction_access_set> access_set; ///< state read/written by this transaction, only recorded when set
+
       private:
          bool                          is_initialized = false;
 
@@ -55,6 +55,16 @@ class transaction_metadata {
       static void create_signing_keys_future( const transaction_metadata_ptr& mtrx, boost::asio::thread_pool& thread_pool,
                                               const chain_id_type& chain_id, fc::microseconds time_limit );
 
+      /**
+       *  Recovers the keys of every transaction in trxs that has neither signing_keys nor a signing_keys_future and
+       *  stores them in signing_keys. The transactions are split into chunks with about the same number of
+       *  signatures, which the calling thread and up to threads pool workers take in turn. Returns once all chunks
+       *  are done, so it may be called from a thread of thread_pool. Transactions whose keys cannot be recovered
+       *  are left without signing_keys, recover_keys() reports the error when the keys are needed.
+       */
+      static void recover_keys_batch( const vector<transaction_metadata_ptr>& trxs, boost::asio::thread_pool& thread_pool,
+                                      uint32_t threads, const chain_id_type& chain_id, fc::microseconds time_limit );
+
 };
 
 } } // eosio::chain
@@ -20,6 +20,9 @@ namespace eosio { namespace chain {
     * The purpose of this object is to enable the detection of duplicate transactions. When a transaction is included
     * in a block a transaction_object is added. At the end of block processing all transaction_objects that have
     * expired can be removed from the index.
+    *
+    * Duplicates are looked up by hash, and transactions are bucketed by their expiration second rather than ordered
+    * by (expiration, id), so recording and expiring one does not pay for a composite key comparison at every node.
     */
    class transaction_object : public chainbase::object<transaction_object_type, transaction_object>
    {
@@ -36,17 +39,37 @@ namespace eosio { namespace chain {
       transaction_object,
       indexed_by<
          ordered_unique< tag<by_id>, BOOST_MULTI_INDEX_MEMBER(transaction_object, transaction_object::id_type, id)>,
-         ordered_unique< tag<by_trx_id>, BOOST_MULTI_INDEX_MEMBER(transaction_object, transaction_id_type, trx_id)>,
-         ordered_unique< tag<by_expiration>,
-            composite_key< transaction_object,
-               BOOST_MULTI_INDEX_MEMBER( transaction_object, time_point_sec, expiration ),
-               BOOST_MULTI_INDEX_MEMBER( transaction_object, transaction_object::id_type, id)
-            >
-         >
+         hashed_unique< tag<by_trx_id>, BOOST_MULTI_INDEX_MEMBER(transaction_object, transaction_id_type, trx_id), std::hash<transaction_id_type>>,
+         ordered_non_unique< tag<by_expiration>, BOOST_MULTI_INDEX_MEMBER(transaction_object, time_point_sec, expiration)>
       >
    >;
 
    typedef chainbase::generic_index<transaction_multi_index> transaction_index;
+
+   /**
+    * Removes the transactions that expired before now.  The end of the expired buckets is found with a single
+    * lookup and everything before it is removed in order, without comparing each transaction against now.
+    *
+    * @return the number of transactions removed
+    */
+   inline size_t remove_expired_transactions( chainbase::database& db, fc::time_point now ) {
+      auto& transaction_idx = db.get_mutable_index<transaction_multi_index>();
+      const auto& dedupe_index = transaction_idx.indices().get<by_expiration>();
+
+      // a transaction expires once now is past its expiration, so the first bucket to keep is now rounded up
+      time_point_sec first_unexpired( now );
+      if( fc::time_point(first_unexpired) < now ) {
+         first_unexpired += 1;
+      }
+
+      size_t removed = 0;
+      const auto expired_end = dedupe_index.lower_bound( first_unexpired );
+      while( dedupe_index.begin() != expired_end ) {
+         transaction_idx.remove( *dedupe_index.begin() );
+         ++removed;
+      }
+      return removed;
+   }
 } }
 
 CHAINBASE_SET_INDEX_TYPE(eosio::chain::transaction_object, eosio::chain::transaction_multi_index)
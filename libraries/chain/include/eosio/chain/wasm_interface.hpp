@@ -4,6 +4,8 @@
 #include "Runtime/Linker.h"
 #include "Runtime/Runtime.h"
 
+namespace boost { namespace asio { class thread_pool; } }
+
 namespace eosio { namespace chain {
 
    class apply_context;
@@ -56,7 +58,21 @@ namespace eosio { namespace chain {
             wabt
          };
 
-         wasm_interface(vm_type vm);
+         struct cache_stats {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t evictions = 0;
+            uint32_t modules = 0;
+            uint64_t resident_bytes = 0; ///< injected wasm, initial memory image and generated machine code of the cached modules
+            uint64_t background_prepares = 0;   ///< preparations completed on the thread pool
+            uint64_t background_prepare_us = 0; ///< total time spent in those preparations
+            uint64_t prepared_ahead = 0;        ///< misses served by a background preparation
+            uint64_t prepare_waits = 0;         ///< misses that had to wait for a background preparation to finish
+            uint64_t prepare_wait_us = 0;       ///< total time spent waiting
+         };
+
+         /// max_cached_modules and max_cache_bytes bound the instantiation cache, 0 for no limit
+         wasm_interface(vm_type vm, uint32_t max_cached_modules = 0, uint64_t max_cache_bytes = 0);
          ~wasm_interface();
 
          //validates code -- does a WASM validation pass and checks the wasm against EOSIO specific constraints
@@ -68,6 +84,14 @@ namespace eosio { namespace chain {
          //Immediately exits currently running wasm. UB is called when no wasm running
          void exit();
 
+         //Parses and injects code on the thread pool so its first execution does not have to, thread safe
+         void queue_preparation(const digest_type& code_id, const bytes& code, boost::asio::thread_pool& pool);
+
+         cache_stats get_cache_stats()const;
+
+         //code ids of the instantiated modules, least recently used first
+         vector<digest_type> cached_modules()const;
+
       private:
          unique_ptr<struct wasm_interface_impl> my;
          friend class eosio::chain::webassembly::common::intrinsics_accessor;
@@ -80,3 +104,5 @@ namespace eosio{ namespace chain {
 }}
 
 FC_REFLECT_ENUM( eosio::chain::wasm_interface::vm_type, (wavm)(wabt) )
+FC_REFLECT( eosio::chain::wasm_interface::cache_stats, (hits)(misses)(evictions)(modules)(resident_bytes)
+            (background_prepares)(background_prepare_us)(prepared_ahead)(prepare_waits)(prepare_wait_us) )
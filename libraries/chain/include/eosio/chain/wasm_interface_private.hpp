@@ -7,8 +7,17 @@
 #include <eosio/chain/wasm_eosio_injection.hpp>
 #include <eosio/chain/transaction_context.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <fc/scoped_exit.hpp>
 
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/member.hpp>
+
+#include <atomic>
+#include <mutex>
+
 #include "IR/Module.h"
 #include "Runtime/Intrinsics.h"
 #include "Platform/Platform.h"
@@ -19,11 +28,37 @@ using namespace fc;
 using namespace eosio::chain::webassembly;
 using namespace IR;
 using namespace Runtime;
+using namespace boost::multi_index;
 
 namespace eosio { namespace chain {
 
+   /**
+    *  Contract code after parsing and wasm_binary_injection, ready to be handed to a runtime for instantiation.
+    */
+   struct prepared_wasm {
+      std::vector<uint8_t> code;
+      std::vector<uint8_t> initial_memory;
+   };
+
+   struct wasm_cache_entry {
+      digest_type                                                 code_id;
+      size_t                                                      resident_bytes = 0;
+      mutable std::unique_ptr<wasm_instantiated_module_interface> module;
+   };
+   struct by_hash;
+
+   /// front of the sequenced index is the least recently used module
+   typedef multi_index_container<
+      wasm_cache_entry,
+      indexed_by<
+         sequenced<>,
+         ordered_unique<tag<by_hash>, member<wasm_cache_entry, digest_type, &wasm_cache_entry::code_id>>
+      >
+   > wasm_cache_index;
+
    struct wasm_interface_impl {
-      wasm_interface_impl(wasm_interface::vm_type vm) {
+      wasm_interface_impl(wasm_interface::vm_type vm, uint32_t max_modules, uint64_t max_bytes)
+      :max_cached_modules(max_modules), max_cache_bytes(max_bytes) {
          if(vm == wasm_interface::vm_type::wavm)
             runtime_interface = std::make_unique<webassembly::wavm::wavm_runtime>();
          else if(vm == wasm_interface::vm_type::wabt)
@@ -32,6 +67,18 @@ namespace eosio { namespace chain {
             EOS_THROW(wasm_exception, "wasm_interface_impl fall through");
       }
 
+      ~wasm_interface_impl() {
+         // queued preparations reference this object
+         for(auto& p : pending_preparations)
+            p.second.wait();
+      }
+
+      /// wasm_binary_injection keeps its state in static members, so injections must not run concurrently
+      static std::mutex& injection_mutex() {
+         static std::mutex m;
+         return m;
+      }
+
       std::vector<uint8_t> parse_initial_memory(const Module& module) {
          std::vector<uint8_t> mem_image;
 
@@ -50,47 +97,151 @@ namespace eosio { namespace chain {
          return mem_image;
       }
 
+      prepared_wasm prepare_module(const char* code, size_t code_size) {
+         IR::Module module;
+         try {
+            Serialization::MemoryInputStream stream((const U8*)code, code_size);
+            WASM::serialize(stream, module);
+            module.userSections.clear();
+         } catch(const Serialization::FatalSerializationException& e) {
+            EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+         } catch(const IR::ValidationException& e) {
+            EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+         }
+
+         {
+            std::lock_guard<std::mutex> g(injection_mutex());
+            wasm_injections::wasm_binary_injection injector(module);
+            injector.inject();
+         }
+
+         prepared_wasm prepared;
+         try {
+            Serialization::ArrayOutputStream outstream;
+            WASM::serialize(outstream, module);
+            prepared.code = outstream.getBytes();
+         } catch(const Serialization::FatalSerializationException& e) {
+            EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+         } catch(const IR::ValidationException& e) {
+            EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+         }
+         prepared.initial_memory = parse_initial_memory(module);
+         return prepared;
+      }
+
+      void queue_preparation(const digest_type& code_id, const bytes& code, boost::asio::thread_pool& pool) {
+         std::lock_guard<std::mutex> g(pending_lock);
+         if(pending_preparations.count(code_id))
+            return;
+         if(pending_preparations.size() >= max_pending_preparations) {
+            // finished preparations nobody asked for, e.g. from blocks of an abandoned fork or code that was already cached
+            for(auto i = pending_preparations.begin(); i != pending_preparations.end();) {
+               if(i->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+                  i = pending_preparations.erase(i);
+               else
+                  ++i;
+            }
+            if(pending_preparations.size() >= max_pending_preparations)
+               return;
+         }
+
+         pending_preparations.emplace(code_id, async_thread_pool(pool, [this, code]() {
+            auto start = fc::time_point::now();
+            auto prepared = prepare_module(code.data(), code.size());
+            background_prepare_us += (fc::time_point::now() - start).count();
+            ++background_prepares;
+            return prepared;
+         }).share());
+      }
+
+      /// removes and returns the background preparation of code_id, waiting for it if it is still running
+      optional<prepared_wasm> take_preparation(const digest_type& code_id) {
+         std::shared_future<prepared_wasm> f;
+         {
+            std::lock_guard<std::mutex> g(pending_lock);
+            auto i = pending_preparations.find(code_id);
+            if(i == pending_preparations.end())
+               return optional<prepared_wasm>();
+            f = std::move(i->second);
+            pending_preparations.erase(i);
+         }
+
+         if(f.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            auto start = fc::time_point::now();
+            f.wait();
+            ++cache_stats.prepare_waits;
+            cache_stats.prepare_wait_us += (fc::time_point::now() - start).count();
+         }
+         try {
+            auto prepared = f.get();
+            ++cache_stats.prepared_ahead;
+            return prepared;
+         } catch(...) {
+            // invalid code, let the inline preparation report the error
+            return optional<prepared_wasm>();
+         }
+      }
+
       std::unique_ptr<wasm_instantiated_module_interface>& get_instantiated_module( const digest_type& code_id,
                                                                                     const shared_string& code,
                                                                                     transaction_context& trx_context )
       {
-         auto it = instantiation_cache.find(code_id);
-         if(it == instantiation_cache.end()) {
+         auto& by_hash_idx = instantiation_cache.get<by_hash>();
+         auto it = by_hash_idx.find(code_id);
+         if(it != by_hash_idx.end()) {
+            ++cache_stats.hits;
+            instantiation_cache.relocate(instantiation_cache.end(), instantiation_cache.project<0>(it));
+         } else {
+            ++cache_stats.misses;
             auto timer_pause = fc::make_scoped_exit([&](){
                trx_context.resume_billing_timer();
             });
             trx_context.pause_billing_timer();
-            IR::Module module;
-            try {
-               Serialization::MemoryInputStream stream((const U8*)code.data(), code.size());
-               WASM::serialize(stream, module);
-               module.userSections.clear();
-            } catch(const Serialization::FatalSerializationException& e) {
-               EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
-            } catch(const IR::ValidationException& e) {
-               EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
-            }
 
-            wasm_injections::wasm_binary_injection injector(module);
-            injector.inject();
+            optional<prepared_wasm> prepared = take_preparation(code_id);
+            if(!prepared)
+               prepared = prepare_module(code.data(), code.size());
 
-            std::vector<U8> bytes;
-            try {
-               Serialization::ArrayOutputStream outstream;
-               WASM::serialize(outstream, module);
-               bytes = outstream.getBytes();
-            } catch(const Serialization::FatalSerializationException& e) {
-               EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
-            } catch(const IR::ValidationException& e) {
-               EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
-            }
-            it = instantiation_cache.emplace(code_id, runtime_interface->instantiate_module((const char*)bytes.data(), bytes.size(), parse_initial_memory(module))).first;
+            wasm_cache_entry entry{code_id, prepared->code.size() + prepared->initial_memory.size()};
+            entry.module = runtime_interface->instantiate_module((const char*)prepared->code.data(), prepared->code.size(), std::move(prepared->initial_memory));
+            entry.resident_bytes += entry.module->generated_code_bytes();
+            cache_stats.resident_bytes += entry.resident_bytes;
+            it = instantiation_cache.project<by_hash>(instantiation_cache.emplace_back(std::move(entry)).first);
+            evict();
          }
-         return it->second;
+         return it->module;
+      }
+
+      /**
+       *  Drops least recently used modules until the cache is within its limits, the most recently used module
+       *  is always kept. Must not be called while a cached module is executing.
+       */
+      void evict() {
+         bool evicted = false;
+         while( instantiation_cache.size() > 1 &&
+                ( (max_cached_modules && instantiation_cache.size() > max_cached_modules) ||
+                  (max_cache_bytes && cache_stats.resident_bytes > max_cache_bytes) ) ) {
+            cache_stats.resident_bytes -= instantiation_cache.front().resident_bytes;
+            instantiation_cache.pop_front();
+            ++cache_stats.evictions;
+            evicted = true;
+         }
+         if(evicted)
+            runtime_interface->free_unreferenced_modules();
+         cache_stats.modules = instantiation_cache.size();
       }
 
       std::unique_ptr<wasm_runtime_interface> runtime_interface;
-      map<digest_type, std::unique_ptr<wasm_instantiated_module_interface>> instantiation_cache;
+
+      static constexpr size_t max_pending_preparations = 64;
+      std::mutex pending_lock; ///< guards pending_preparations, which is filled from thread pool threads
+      map<digest_type, std::shared_future<prepared_wasm>> pending_preparations;
+      std::atomic<uint64_t> background_prepares{0};
+      std::atomic<uint64_t> background_prepare_us{0};
+      wasm_cache_index instantiation_cache;
+      uint32_t max_cached_modules = 0; ///< 0 for no limit
+      uint64_t max_cache_bytes = 0;    ///< 0 for no limit
+      wasm_interface::cache_stats cache_stats;
    };
 
 #define _REGISTER_INTRINSIC_EXPLICIT(CLS, MOD, METHOD, WASM_SIG, NAME, SIG)\
@@ -10,6 +10,9 @@ class wasm_instantiated_module_interface {
    public:
       virtual void apply(apply_context& context) = 0;
 
+      //bytes of machine code generated for the module, 0 for interpreting runtimes
+      virtual size_t generated_code_bytes() const { return 0; }
+
       virtual ~wasm_instantiated_module_interface();
 };
 
@@ -20,6 +23,9 @@ class wasm_runtime_interface {
       //immediately exit the currently running wasm_instantiated_module_interface. Yep, this assumes only one can possibly run at a time.
       virtual void immediately_exit_currently_running_module() = 0;
 
+      //release runtime resources of instantiated modules that have been destroyed, for runtimes that do not free them in the destructor
+      virtual void free_unreferenced_modules() {}
+
       virtual ~wasm_runtime_interface();
 };
 
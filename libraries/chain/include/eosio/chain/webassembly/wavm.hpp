@@ -24,6 +24,8 @@ class wavm_runtime : public eosio::chain::wasm_runtime_interface {
 
       void immediately_exit_currently_running_module() override;
 
+      void free_unreferenced_modules() override;
+
       struct runtime_guard {
          runtime_guard();
          ~runtime_guard();
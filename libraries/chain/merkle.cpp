@@ -1,4 +1,5 @@
 #include <eosio/chain/merkle.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <fc/io/raw.hpp>
 
 namespace eosio { namespace chain {
@@ -31,22 +32,212 @@ bool is_canonical_right(const digest_type& val) {
    return (val._hash[0] & 0x0000000000000080ULL) != 0;
 }
 
+namespace {
 
-digest_type merkle(vector<digest_type> ids) {
-   if( 0 == ids.size() ) { return digest_type(); }
+#if defined(__GNUC__)
+   /**
+    *  Multi-buffer SHA-256 of canonical pairs: every lane of a vector register hashes a different pair, so one pass
+    *  over the 64 rounds produces 4 (SSE/NEON) or 8 (AVX2) parents. A canonical pair always serializes to exactly
+    *  64 bytes, the second compressed block is therefore pure padding and its message schedule is a constant.
+    */
+   typedef uint32_t lanes4 __attribute__((vector_size(16)));
+#if defined(__x86_64__) || defined(__i386__)
+   typedef uint32_t lanes8 __attribute__((vector_size(32)));
+   // lanes8 values only cross always_inline helpers called from an avx2 function, never a real call boundary,
+   // the warning is silenced up to the end of the vector code only
+   #pragma GCC diagnostic push
+   #pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+   const uint32_t sha256_k[64] = {
+      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+      0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+      0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+      0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+      0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+      0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+      0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+      0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+   };
+
+   const uint32_t sha256_iv[8] = {
+      0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+   };
+
+   inline uint32_t rotr( uint32_t x, int n ) { return (x >> n) | (x << (32 - n)); }
+
+   /// K[t] + W[t] of the padding block that follows every 64 byte message
+   struct padding_schedule {
+      uint32_t kw[64];
+
+      padding_schedule() {
+         uint32_t w[64] = { 0x80000000 };
+         w[15] = 64 * 8;
+         for( int t = 16; t < 64; ++t ) {
+            const uint32_t s0 = rotr(w[t-15], 7) ^ rotr(w[t-15], 18) ^ (w[t-15] >> 3);
+            const uint32_t s1 = rotr(w[t-2], 17) ^ rotr(w[t-2], 19) ^ (w[t-2] >> 10);
+            w[t] = w[t-16] + s0 + w[t-7] + s1;
+         }
+         for( int t = 0; t < 64; ++t )
+            kw[t] = sha256_k[t] + w[t];
+      }
+   };
+
+   const padding_schedule padding;
+
+   template<typename V>
+   inline __attribute__((always_inline)) V splat( uint32_t x ) {
+      V v;
+      for( size_t i = 0; i < sizeof(V) / sizeof(uint32_t); ++i )
+         v[i] = x;
+      return v;
+   }
+
+   template<typename V>
+   inline __attribute__((always_inline)) V vrotr( V x, int n ) { return (x >> n) | (x << (32 - n)); }
 
-   while( ids.size() > 1 ) {
-      if( ids.size() % 2 )
-         ids.push_back(ids.back());
+   template<typename V>
+   inline __attribute__((always_inline)) void sha256_round( V s[8], V kw ) {
+      const V t1 = s[7] + (vrotr(s[4], 6) ^ vrotr(s[4], 11) ^ vrotr(s[4], 25)) + ((s[4] & s[5]) ^ (~s[4] & s[6])) + kw;
+      const V t2 = (vrotr(s[0], 2) ^ vrotr(s[0], 13) ^ vrotr(s[0], 22)) + ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+      s[7] = s[6]; s[6] = s[5]; s[5] = s[4]; s[4] = s[3] + t1;
+      s[3] = s[2]; s[2] = s[1]; s[1] = s[0]; s[0] = t1 + t2;
+   }
+
+   inline uint32_t load_be32( const unsigned char* p ) {
+      return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+   }
+
+   inline void store_be32( unsigned char* p, uint32_t v ) {
+      p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+   }
+
+   /// hashes the lanes canonical pairs in[0,1], in[2,3], ... into out[0], out[1], ..., out may alias in
+   template<typename V>
+   inline __attribute__((always_inline)) void hash_pair_lanes( const digest_type* in, digest_type* out ) {
+      constexpr size_t lanes = sizeof(V) / sizeof(uint32_t);
 
-      for (int i = 0; i < ids.size() / 2; i++) {
-         ids[i] = digest_type::hash(make_canonical_pair(ids[2 * i], ids[(2 * i) + 1]));
+      V w[16];
+      for( size_t j = 0; j < lanes; ++j ) {
+         const auto* l = reinterpret_cast<const unsigned char*>( in[2*j].data() );
+         const auto* r = reinterpret_cast<const unsigned char*>( in[2*j+1].data() );
+         for( int t = 0; t < 8; ++t ) {
+            w[t][j]   = load_be32( l + 4*t );
+            w[t+8][j] = load_be32( r + 4*t );
+         }
       }
+      w[0] &= splat<V>( 0x7FFFFFFF ); // make_canonical_left
+      w[8] |= splat<V>( 0x80000000 ); // make_canonical_right
 
-      ids.resize(ids.size() / 2);
+      V s[8], h[8];
+      for( int i = 0; i < 8; ++i )
+         s[i] = h[i] = splat<V>( sha256_iv[i] );
+
+      for( int t = 0; t < 64; ++t ) {
+         if( t >= 16 ) {
+            const V w15 = w[(t-15) & 15], w2 = w[(t-2) & 15];
+            w[t & 15] += (vrotr(w15, 7) ^ vrotr(w15, 18) ^ (w15 >> 3)) + w[(t-7) & 15]
+                       + (vrotr(w2, 17) ^ vrotr(w2, 19) ^ (w2 >> 10));
+         }
+         sha256_round( s, w[t & 15] + splat<V>( sha256_k[t] ) );
+      }
+      for( int i = 0; i < 8; ++i )
+         s[i] = h[i] = h[i] + s[i];
+
+      for( int t = 0; t < 64; ++t )
+         sha256_round( s, splat<V>( padding.kw[t] ) );
+      for( int i = 0; i < 8; ++i )
+         s[i] += h[i];
+
+      for( size_t j = 0; j < lanes; ++j ) {
+         auto* o = reinterpret_cast<unsigned char*>( out[j].data() );
+         for( int i = 0; i < 8; ++i )
+            store_be32( o + 4*i, s[i][j] );
+      }
    }
 
-   return ids.front();
+   void hash_pairs_x4( const digest_type* in, size_t groups, digest_type* out ) {
+      for( size_t g = 0; g < groups; ++g )
+         hash_pair_lanes<lanes4>( in + 8*g, out + 4*g );
+   }
+
+#if defined(__x86_64__) || defined(__i386__)
+   __attribute__((target("avx2")))
+   void hash_pairs_x8( const digest_type* in, size_t groups, digest_type* out ) {
+      for( size_t g = 0; g < groups; ++g )
+         hash_pair_lanes<lanes8>( in + 16*g, out + 8*g );
+   }
+
+   bool has_avx2() {
+      static const bool supported = ( __builtin_cpu_init(), __builtin_cpu_supports( "avx2" ) );
+      return supported;
+   }
+
+   #pragma GCC diagnostic pop
+#endif
+#endif // __GNUC__
+
+   /// hashes pairs canonical pairs of in into out, out may alias in
+   void hash_pairs( const digest_type* in, size_t pairs, digest_type* out ) {
+      size_t done = 0;
+#if defined(__GNUC__)
+#if defined(__x86_64__) || defined(__i386__)
+      if( has_avx2() ) {
+         hash_pairs_x8( in, pairs / 8, out );
+         done = pairs / 8 * 8;
+      }
+#endif
+      hash_pairs_x4( in + 2*done, (pairs - done) / 4, out + done );
+      done += (pairs - done) / 4 * 4;
+#endif
+      for( ; done < pairs; ++done )
+         out[done] = digest_type::hash( make_canonical_pair( in[2*done], in[2*done+1] ) );
+   }
+
+   /// levels with at least this many pairs are split into chunks of this many pairs across the thread pool
+   const size_t parallel_chunk_pairs = 4096;
+
+   digest_type merkle_levels( vector<digest_type> ids, boost::asio::thread_pool* pool ) {
+      if( 0 == ids.size() ) { return digest_type(); }
+
+      vector<digest_type> next;
+      while( ids.size() > 1 ) {
+         if( ids.size() % 2 )
+            ids.push_back(ids.back());
+
+         const size_t pairs = ids.size() / 2;
+         if( pool && pairs >= 2 * parallel_chunk_pairs ) {
+            // chunks would overwrite each other's input if they hashed in place
+            next.reserve( pairs + 1 );
+            next.resize( pairs );
+            vector<std::future<void>> chunks;
+            for( size_t begin = parallel_chunk_pairs; begin < pairs; begin += parallel_chunk_pairs ) {
+               const size_t count = std::min( parallel_chunk_pairs, pairs - begin );
+               chunks.emplace_back( async_thread_pool( *pool, [&ids, &next, begin, count]() {
+                  hash_pairs( ids.data() + 2*begin, count, next.data() + begin );
+               }) );
+            }
+            hash_pairs( ids.data(), parallel_chunk_pairs, next.data() );
+            for( auto& c : chunks )
+               c.get();
+            std::swap( ids, next );
+         } else {
+            hash_pairs( ids.data(), pairs, ids.data() );
+            ids.resize( pairs );
+         }
+      }
+
+      return ids.front();
+   }
+
+} // anonymous namespace
+
+digest_type merkle(vector<digest_type> ids) {
+   return merkle_levels( move(ids), nullptr );
+}
+
+digest_type merkle(vector<digest_type> ids, boost::asio::thread_pool& pool) {
+   return merkle_levels( move(ids), &pool );
 }
 
 } } // eosio::chain
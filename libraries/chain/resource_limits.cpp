@@ -18,6 +18,171 @@ using resource_index_set = index_set<
 
 static_assert( config::rate_limiting_precision > 0, "config::rate_limiting_precision must be positive" );
 
+/**
+ * In-block copy of the usage accumulators of every account billed since the last flush, together with
+ * the block CPU/NET usage billed since then.  The accumulators are advanced with exactly the same
+ * arithmetic as the chainbase rows would be, so flushing them produces the same state.
+ *
+ * Each usage_session pushes a frame that remembers the value an account had before the session first
+ * touched it; undoing the session restores those values, squashing it hands them to the enclosing frame.
+ */
+struct resource_limits_manager::pending_usage {
+   struct account_usage {
+      usage_accumulator net_usage;
+      usage_accumulator cpu_usage;
+   };
+
+   struct frame {
+      map<account_name, optional<account_usage>> saved;
+      uint64_t                                    cpu_usage = 0;
+      uint64_t                                    net_usage = 0;
+   };
+
+   map<account_name, account_usage> accounts;
+   uint64_t                         cpu_usage = 0;
+   uint64_t                         net_usage = 0;
+   vector<frame>                    frames;
+
+   account_usage current( const chainbase::database& db, const account_name& a )const {
+      auto itr = accounts.find( a );
+      if( itr != accounts.end() )
+         return itr->second;
+
+      const auto& usage = db.get<resource_usage_object,by_owner>( a );
+      return { usage.net_usage, usage.cpu_usage };
+   }
+
+   account_usage& modify( const chainbase::database& db, const account_name& a ) {
+      auto itr = accounts.find( a );
+      if( !frames.empty() ) {
+         auto& saved = frames.back().saved;
+         if( saved.find( a ) == saved.end() ) {
+            saved.emplace( a, itr == accounts.end() ? optional<account_usage>() : optional<account_usage>( itr->second ) );
+         }
+      }
+
+      if( itr == accounts.end() ) {
+         const auto& usage = db.get<resource_usage_object,by_owner>( a );
+         itr = accounts.emplace( a, account_usage{ usage.net_usage, usage.cpu_usage } ).first;
+      }
+      return itr->second;
+   }
+
+   void push() {
+      frames.emplace_back();
+      frames.back().cpu_usage = cpu_usage;
+      frames.back().net_usage = net_usage;
+   }
+
+   void squash( size_t depth ) {
+      if( frames.size() != depth ) return; // already discarded by clear_pending_usage
+
+      if( frames.size() > 1 ) {
+         auto& outer = frames[frames.size() - 2].saved;
+         for( auto& s : frames.back().saved ) {
+            outer.emplace( s.first, std::move( s.second ) ); // keeps the outer frame's older value
+         }
+      }
+      frames.pop_back();
+   }
+
+   void undo( size_t depth ) {
+      if( frames.size() != depth ) return; // already discarded by clear_pending_usage
+
+      auto& f = frames.back();
+      for( auto& s : f.saved ) {
+         if( s.second ) {
+            accounts[s.first] = *s.second;
+         } else {
+            accounts.erase( s.first );
+         }
+      }
+      cpu_usage = f.cpu_usage;
+      net_usage = f.net_usage;
+      frames.pop_back();
+   }
+};
+
+resource_limits_manager::resource_limits_manager( chainbase::database& db )
+:_db(db)
+,_pending(std::make_unique<pending_usage>())
+{
+}
+
+resource_limits_manager::~resource_limits_manager() = default;
+
+resource_limits_manager::usage_session::usage_session( resource_limits_manager& manager )
+:_manager(&manager)
+{
+   _manager->_pending->push();
+   _depth = _manager->_pending->frames.size();
+}
+
+resource_limits_manager::usage_session::usage_session( usage_session&& other )
+:_manager(other._manager)
+,_depth(other._depth)
+{
+   other._manager = nullptr;
+}
+
+resource_limits_manager::usage_session& resource_limits_manager::usage_session::operator=( usage_session&& other ) {
+   if( this != &other ) {
+      undo();
+      _manager = other._manager;
+      _depth = other._depth;
+      other._manager = nullptr;
+   }
+   return *this;
+}
+
+resource_limits_manager::usage_session::~usage_session() {
+   undo();
+}
+
+void resource_limits_manager::usage_session::squash() {
+   if( _manager ) _manager->_pending->squash( _depth );
+   _manager = nullptr;
+}
+
+void resource_limits_manager::usage_session::undo() {
+   if( _manager ) _manager->_pending->undo( _depth );
+   _manager = nullptr;
+}
+
+resource_limits_manager::usage_session resource_limits_manager::start_usage_session() {
+   return usage_session( *this );
+}
+
+void resource_limits_manager::flush_pending_usage() {
+   EOS_ASSERT( _pending->frames.empty(), rate_limiting_state_inconsistent,
+               "cannot flush account usage while a usage session is active" );
+
+   for( const auto& a : _pending->accounts ) {
+      const auto& usage = _db.get<resource_usage_object,by_owner>( a.first );
+      _db.modify( usage, [&]( auto& bu ){
+         bu.net_usage = a.second.net_usage;
+         bu.cpu_usage = a.second.cpu_usage;
+      });
+   }
+
+   if( _pending->cpu_usage > 0 || _pending->net_usage > 0 ) {
+      const auto& state = _db.get<resource_limits_state_object>();
+      _db.modify(state, [&](resource_limits_state_object& rls){
+         rls.pending_cpu_usage += _pending->cpu_usage;
+         rls.pending_net_usage += _pending->net_usage;
+      });
+   }
+
+   clear_pending_usage();
+}
+
+void resource_limits_manager::clear_pending_usage() {
+   _pending->accounts.clear();
+   _pending->cpu_usage = 0;
+   _pending->net_usage = 0;
+   _pending->frames.clear();
+}
+
 static uint64_t update_elastic_limit(uint64_t current_limit, uint64_t average_usage, const elastic_limit_parameters& params) {
    uint64_t result = current_limit;
    if (average_usage > params.target ) {
@@ -75,6 +240,12 @@ void resource_limits_manager::add_to_snapshot( const snapshot_writer_ptr& snapsh
    });
 }
 
+void resource_limits_manager::add_snapshot_parts( uint64_t rows_per_part, std::vector<snapshot_part>& parts ) const {
+   resource_index_set::walk_indices([this, rows_per_part, &parts]( auto utils ){
+      add_index_snapshot_parts<decltype(utils)>(_db, rows_per_part, parts);
+   });
+}
+
 void resource_limits_manager::read_from_snapshot( const snapshot_reader_ptr& snapshot ) {
    resource_index_set::walk_indices([this, &snapshot]( auto utils ){
       snapshot->read_section<typename decltype(utils)::index_t::value_type>([this]( auto& section ) {
@@ -111,11 +282,9 @@ void resource_limits_manager::set_block_parameters(const elastic_limit_parameter
 void resource_limits_manager::update_account_usage(const flat_set<account_name>& accounts, uint32_t time_slot ) {
    const auto& config = _db.get<resource_limits_config_object>();
    for( const auto& a : accounts ) {
-      const auto& usage = _db.get<resource_usage_object,by_owner>( a );
-      _db.modify( usage, [&]( auto& bu ){
-          bu.net_usage.add( 0, time_slot, config.account_net_usage_average_window );
-          bu.cpu_usage.add( 0, time_slot, config.account_cpu_usage_average_window );
-      });
+      auto& usage = _pending->modify( _db, a );
+      usage.net_usage.add( 0, time_slot, config.account_net_usage_average_window );
+      usage.cpu_usage.add( 0, time_slot, config.account_cpu_usage_average_window );
    }
 }
 
@@ -125,16 +294,14 @@ void resource_limits_manager::add_transaction_usage(const flat_set<account_name>
 
    for( const auto& a : accounts ) {
 
-      const auto& usage = _db.get<resource_usage_object,by_owner>( a );
+      auto& usage = _pending->modify( _db, a );
       int64_t unused;
       int64_t net_weight;
       int64_t cpu_weight;
       get_account_limits( a, unused, net_weight, cpu_weight );
 
-      _db.modify( usage, [&]( auto& bu ){
-          bu.net_usage.add( net_usage, time_slot, config.account_net_usage_average_window );
-          bu.cpu_usage.add( cpu_usage, time_slot, config.account_cpu_usage_average_window );
-      });
+      usage.net_usage.add( net_usage, time_slot, config.account_net_usage_average_window );
+      usage.cpu_usage.add( cpu_usage, time_slot, config.account_cpu_usage_average_window );
 
       if( cpu_weight >= 0 && state.total_cpu_weight > 0 ) {
          uint128_t window_size = config.account_cpu_usage_average_window;
@@ -176,13 +343,11 @@ void resource_limits_manager::add_transaction_usage(const flat_set<account_name>
    }
 
    // account for this transaction in the block and do not exceed those limits either
-   _db.modify(state, [&](resource_limits_state_object& rls){
-      rls.pending_cpu_usage += cpu_usage;
-      rls.pending_net_usage += net_usage;
-   });
+   _pending->cpu_usage += cpu_usage;
+   _pending->net_usage += net_usage;
 
-   EOS_ASSERT( state.pending_cpu_usage <= config.cpu_limit_parameters.max, block_resource_exhausted, "Block has insufficient cpu resources" );
-   EOS_ASSERT( state.pending_net_usage <= config.net_limit_parameters.max, block_resource_exhausted, "Block has insufficient net resources" );
+   EOS_ASSERT( state.pending_cpu_usage + _pending->cpu_usage <= config.cpu_limit_parameters.max, block_resource_exhausted, "Block has insufficient cpu resources" );
+   EOS_ASSERT( state.pending_net_usage + _pending->net_usage <= config.net_limit_parameters.max, block_resource_exhausted, "Block has insufficient net resources" );
 }
 
 void resource_limits_manager::add_pending_ram_usage( const account_name account, int64_t ram_delta ) {
@@ -324,6 +489,8 @@ void resource_limits_manager::process_account_limit_updates() {
 }
 
 void resource_limits_manager::process_block_usage(uint32_t block_num) {
+   flush_pending_usage();
+
    const auto& s = _db.get<resource_limits_state_object>();
    const auto& config = _db.get<resource_limits_config_object>();
    _db.modify(s, [&](resource_limits_state_object& state){
@@ -354,13 +521,13 @@ uint64_t resource_limits_manager::get_virtual_block_net_limit() const {
 uint64_t resource_limits_manager::get_block_cpu_limit() const {
    const auto& state = _db.get<resource_limits_state_object>();
    const auto& config = _db.get<resource_limits_config_object>();
-   return config.cpu_limit_parameters.max - state.pending_cpu_usage;
+   return config.cpu_limit_parameters.max - (state.pending_cpu_usage + _pending->cpu_usage);
 }
 
 uint64_t resource_limits_manager::get_block_net_limit() const {
    const auto& state = _db.get<resource_limits_state_object>();
    const auto& config = _db.get<resource_limits_config_object>();
-   return config.net_limit_parameters.max - state.pending_net_usage;
+   return config.net_limit_parameters.max - (state.pending_net_usage + _pending->net_usage);
 }
 
 int64_t resource_limits_manager::get_account_cpu_limit( const account_name& name, bool elastic ) const {
@@ -371,7 +538,7 @@ int64_t resource_limits_manager::get_account_cpu_limit( const account_name& name
 account_resource_limit resource_limits_manager::get_account_cpu_limit_ex( const account_name& name, bool elastic) const {
 
    const auto& state = _db.get<resource_limits_state_object>();
-   const auto& usage = _db.get<resource_usage_object, by_owner>(name);
+   const auto usage = _pending->current(_db, name);
    const auto& config = _db.get<resource_limits_config_object>();
 
    int64_t cpu_weight, x, y;
@@ -410,7 +577,7 @@ int64_t resource_limits_manager::get_account_net_limit( const account_name& name
 account_resource_limit resource_limits_manager::get_account_net_limit_ex( const account_name& name, bool elastic) const {
    const auto& config = _db.get<resource_limits_config_object>();
    const auto& state  = _db.get<resource_limits_state_object>();
-   const auto& usage  = _db.get<resource_usage_object, by_owner>(name);
+   const auto  usage  = _pending->current(_db, name);
 
    int64_t net_weight, x, y;
    get_account_limits( name, x, net_weight, y );
@@ -0,0 +1,138 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE
+ */
+#include <eosio/chain/signature_recovery_cache.hpp>
+
+#include <mutex>
+
+#include <boost/functional/hash.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+
+namespace eosio { namespace chain {
+
+using namespace boost::multi_index;
+
+namespace {
+
+   struct cached_pub_key {
+      transaction_id_type trx_id;
+      public_key_type pub_key;
+      signature_type sig;
+      fc::microseconds cpu_usage;
+      cached_pub_key(const cached_pub_key&) = delete;
+      cached_pub_key() = delete;
+      cached_pub_key& operator=(const cached_pub_key&) = delete;
+      cached_pub_key(cached_pub_key&&) = default;
+   };
+   struct by_sig{};
+
+   typedef multi_index_container<
+      cached_pub_key,
+      indexed_by<
+         sequenced<>,
+         hashed_unique<
+            tag<by_sig>,
+            member<cached_pub_key,
+                   signature_type,
+                   &cached_pub_key::sig>
+         >
+      >
+   > recovery_cache_type;
+
+} // anonymous namespace
+
+/// least recently used entries are at the front, shards are allocated separately to keep their locks apart
+struct signature_recovery_cache::shard {
+   std::mutex          mtx;
+   recovery_cache_type entries;
+   uint32_t            capacity = 0;
+   uint64_t            hits = 0;
+   uint64_t            misses = 0;
+   uint64_t            evictions = 0;
+
+   void trim() {
+      while( entries.size() > capacity ) {
+         entries.pop_front();
+         ++evictions;
+      }
+   }
+};
+
+signature_recovery_cache::signature_recovery_cache( uint32_t capacity ) {
+   for( auto& s : _shards )
+      s.reset( new shard() );
+   set_capacity( capacity );
+}
+
+signature_recovery_cache::~signature_recovery_cache() = default;
+
+signature_recovery_cache& signature_recovery_cache::instance() {
+   static signature_recovery_cache cache;
+   return cache;
+}
+
+void signature_recovery_cache::set_capacity( uint32_t capacity ) {
+   const uint32_t per_shard = capacity / shard_count + (capacity % shard_count ? 1 : 0);
+   for( auto& s : _shards ) {
+      std::lock_guard<std::mutex> g( s->mtx );
+      s->capacity = per_shard;
+      s->trim();
+   }
+}
+
+signature_recovery_cache::shard& signature_recovery_cache::shard_for( const signature_type& sig ) {
+   return *_shards[ boost::hash<signature_type>()( sig ) % shard_count ];
+}
+
+bool signature_recovery_cache::find( const signature_type& sig, const transaction_id_type& trx_id,
+                                     public_key_type& pub_key, fc::microseconds& cpu_usage ) {
+   shard& s = shard_for( sig );
+   std::lock_guard<std::mutex> g( s.mtx );
+   auto& by_sig_idx = s.entries.get<by_sig>();
+   auto it = by_sig_idx.find( sig );
+   if( it == by_sig_idx.end() || it->trx_id != trx_id ) {
+      ++s.misses;
+      return false;
+   }
+   pub_key = it->pub_key;
+   cpu_usage = it->cpu_usage;
+   s.entries.relocate( s.entries.end(), s.entries.project<0>( it ) );
+   ++s.hits;
+   return true;
+}
+
+void signature_recovery_cache::insert( const signature_type& sig, const transaction_id_type& trx_id,
+                                       const public_key_type& pub_key, fc::microseconds cpu_usage ) {
+   shard& s = shard_for( sig );
+   std::lock_guard<std::mutex> g( s.mtx );
+   auto r = s.entries.emplace_back( cached_pub_key{trx_id, pub_key, sig, cpu_usage} );
+   if( !r.second ) {
+      // the same signature was cached for another transaction, keep the latest one
+      s.entries.modify( r.first, [&]( cached_pub_key& e ) {
+         e.trx_id = trx_id;
+         e.pub_key = pub_key;
+         e.cpu_usage = cpu_usage;
+      });
+      s.entries.relocate( s.entries.end(), r.first );
+   }
+   s.trim();
+}
+
+signature_recovery_cache::cache_stats signature_recovery_cache::get_stats()const {
+   cache_stats stats;
+   for( const auto& s : _shards ) {
+      std::lock_guard<std::mutex> g( s->mtx );
+      stats.hits += s->hits;
+      stats.misses += s->misses;
+      stats.evictions += s->evictions;
+      stats.entries += s->entries.size();
+      stats.capacity += s->capacity;
+   }
+   return stats;
+}
+
+} } /// eosio::chain
@@ -2,8 +2,27 @@
 #include <eosio/chain/exceptions.hpp>
 #include <fc/scoped_exit.hpp>
 
+#include <algorithm>
+#include <unordered_map>
+
 namespace eosio { namespace chain {
 
+void snapshot_writer::write_buffered_section( const std::shared_ptr<section_buffer_writer>& buffer ) {
+   EOS_THROW(snapshot_exception, "Snapshot writer does not accept buffered sections, cannot write ${n}", ("n", buffer->name()));
+}
+
+std::shared_ptr<snapshot_reader> snapshot_reader::read_buffered_section( const std::string& section_name ) {
+   EOS_THROW(snapshot_exception, "Snapshot reader does not provide buffered sections, cannot read ${n}", ("n", section_name));
+}
+
+bool snapshot_reader::read_raw_row( std::string& ) {
+   EOS_THROW(snapshot_exception, "Snapshot reader does not provide raw rows, it cannot be the base of a delta");
+}
+
+fc::sha256 snapshot_reader::state_digest() {
+   EOS_THROW(snapshot_exception, "Snapshot reader has no state digest, it cannot be the base of a delta");
+}
+
 variant_snapshot_writer::variant_snapshot_writer(fc::mutable_variant_object& snapshot)
 : snapshot(snapshot)
 {
@@ -46,9 +65,9 @@ void variant_snapshot_reader::validate() const {
    EOS_ASSERT(version.is_integer(), snapshot_validation_exception,
          "Variant snapshot version is not an integer");
 
-   EOS_ASSERT(version.as_uint64() == (uint64_t)current_snapshot_version, snapshot_validation_exception,
-         "Variant snapshot is an unsuppored version.  Expected : ${expected}, Got: ${actual}",
-         ("expected", current_snapshot_version)("actual",o["version"].as_uint64()));
+   EOS_ASSERT(version.as_uint64() >= (uint64_t)minimum_snapshot_version && version.as_uint64() <= (uint64_t)current_snapshot_version, snapshot_validation_exception,
+         "Variant snapshot is an unsuppored version.  Expected : ${min} to ${expected}, Got: ${actual}",
+         ("min", minimum_snapshot_version)("expected", current_snapshot_version)("actual",o["version"].as_uint64()));
 
    EOS_ASSERT(o.contains("sections"), snapshot_validation_exception,
          "Variant snapshot has no sections");
@@ -114,6 +133,75 @@ void variant_snapshot_reader::clear_section() {
    cur_row = 0;
 }
 
+section_buffer_writer::section_buffer_writer()
+:wrapper(data)
+{
+}
+
+void section_buffer_writer::write_start_section( const std::string& name )
+{
+   EOS_ASSERT(section_name.empty() && rows == 0, snapshot_exception, "Section buffer already holds section ${n}", ("n", section_name));
+   section_name = name;
+   start = fc::time_point::now();
+}
+
+void section_buffer_writer::write_row( const detail::abstract_snapshot_row_writer& row_writer ) {
+   auto before = data.tellp();
+   row_writer.write(wrapper);
+   sizes.push_back(uint32_t(data.tellp() - before));
+   rows++;
+}
+
+void section_buffer_writer::write_end_section( ) {
+   serialize_time = fc::time_point::now() - start;
+}
+
+uint64_t section_buffer_writer::size() const {
+   return const_cast<std::stringstream&>(data).tellp();
+}
+
+void section_buffer_writer::write_to( std::ostream& out ) {
+   if (size() > 0) {
+      out << data.rdbuf();
+   }
+}
+
+section_buffer_reader::section_buffer_reader( std::string section_name, uint64_t row_count, std::string rows )
+:section_name(std::move(section_name))
+,data(std::move(rows))
+,num_rows(row_count)
+,cur_row(0)
+{
+   data.exceptions(std::istream::failbit|std::istream::eofbit);
+}
+
+void section_buffer_reader::validate() const {
+   // validated by the reader the section was copied from
+}
+
+bool section_buffer_reader::has_section( const string& name ) {
+   return name == section_name;
+}
+
+void section_buffer_reader::set_section( const string& name ) {
+   EOS_ASSERT(name == section_name, snapshot_exception, "Section buffer has no section named ${n}", ("n", name));
+   data.seekg(0);
+   cur_row = 0;
+}
+
+bool section_buffer_reader::read_row( detail::abstract_snapshot_row_reader& row_reader ) {
+   row_reader.provide(data);
+   return ++cur_row < num_rows;
+}
+
+bool section_buffer_reader::empty ( ) {
+   return num_rows == 0;
+}
+
+void section_buffer_reader::clear_section() {
+   cur_row = 0;
+}
+
 ostream_snapshot_writer::ostream_snapshot_writer(std::ostream& snapshot)
 :snapshot(snapshot)
 ,header_pos(snapshot.tellp())
@@ -134,6 +222,9 @@ void ostream_snapshot_writer::write_start_section( const std::string& section_na
    EOS_ASSERT(section_pos == std::streampos(-1), snapshot_exception, "Attempting to write a new section without closing the previous section");
    section_pos = snapshot.tellp();
    row_count = 0;
+   this->section_name = section_name;
+   section_start = fc::time_point::now();
+   row_index.clear();
 
    uint64_t placeholder = std::numeric_limits<uint64_t>::max();
 
@@ -156,6 +247,7 @@ void ostream_snapshot_writer::write_row( const detail::abstract_snapshot_row_wri
       snapshot.seekp(restore);
       throw;
    }
+   detail::append_row_size(row_index, snapshot.tellp() - restore);
    row_count++;
 }
 
@@ -174,15 +266,65 @@ void ostream_snapshot_writer::write_end_section( ) {
 
    snapshot.seekp(restore);
 
+   row_indexes.emplace_back(std::move(row_index));
+   stats.push_back({std::move(section_name), uint64_t(section_pos - header_pos), row_count,
+                    uint64_t(restore - section_pos), fc::time_point::now() - section_start});
+
    section_pos = std::streampos(-1);
    row_count = 0;
 }
 
+void ostream_snapshot_writer::write_buffered_section( const std::shared_ptr<section_buffer_writer>& buffer ) {
+   EOS_ASSERT(section_pos == std::streampos(-1), snapshot_exception, "Attempting to write a new section without closing the previous section");
+   auto pos = snapshot.tellp();
+
+   const auto& name = buffer->name();
+   uint64_t section_size = sizeof(uint64_t) + name.size() + 1 + buffer->size();
+   uint64_t rows = buffer->row_count();
+
+   snapshot.write((char*)&section_size, sizeof(section_size));
+   snapshot.write((char*)&rows, sizeof(rows));
+   snapshot.write(name.data(), name.size());
+   snapshot.put(0);
+   buffer->write_to(snapshot.inner);
+
+   std::string index;
+   for (auto size : buffer->row_sizes()) {
+      detail::append_row_size(index, size);
+   }
+   row_indexes.emplace_back(std::move(index));
+
+   stats.push_back({name, uint64_t(pos - header_pos), rows, sizeof(section_size) + section_size, buffer->elapsed()});
+}
+
 void ostream_snapshot_writer::finalize() {
    uint64_t end_marker = std::numeric_limits<uint64_t>::max();
 
    // write a placeholder for the section size
    snapshot.write((char*)&end_marker, sizeof(end_marker));
+
+   // followed by the row indexes of the sections
+   std::vector<uint64_t> index_offsets;
+   for (const auto& index : row_indexes) {
+      index_offsets.push_back(snapshot.tellp() - header_pos);
+      snapshot.write(index.data(), index.size());
+   }
+
+   // then the directory: the offset, row index and name of every section
+   uint64_t directory_offset = snapshot.tellp() - header_pos;
+   for (size_t i = 0; i < stats.size(); ++i) {
+      uint64_t index_size = row_indexes[i].size();
+      snapshot.write((char*)&stats[i].offset, sizeof(stats[i].offset));
+      snapshot.write((char*)&index_offsets[i], sizeof(index_offsets[i]));
+      snapshot.write((char*)&index_size, sizeof(index_size));
+      snapshot.write(stats[i].name.data(), stats[i].name.size());
+      snapshot.put(0);
+   }
+
+   // and last where the directory starts and its size
+   uint64_t section_count = stats.size();
+   snapshot.write((char*)&directory_offset, sizeof(directory_offset));
+   snapshot.write((char*)&section_count, sizeof(section_count));
 }
 
 istream_snapshot_reader::istream_snapshot_reader(std::istream& snapshot)
@@ -190,6 +332,11 @@ istream_snapshot_reader::istream_snapshot_reader(std::istream& snapshot)
 ,header_pos(snapshot.tellg())
 ,num_rows(0)
 ,cur_row(0)
+,sections_loaded(false)
+,version(0)
+,digest_computed(false)
+,cur_section(nullptr)
+,cur_row_index_pos(0)
 {
 
 }
@@ -204,136 +351,743 @@ void istream_snapshot_reader::validate() const {
    snapshot.exceptions(std::istream::failbit|std::istream::eofbit);
 
    try {
-      // validate totem
-      auto expected_totem = ostream_snapshot_writer::magic_number;
-      decltype(expected_totem) actual_totem;
-      snapshot.read((char*)&actual_totem, sizeof(actual_totem));
-      EOS_ASSERT(actual_totem == expected_totem, snapshot_exception,
-                 "Binary snapshot has unexpected magic number!");
-
-      // validate version
-      auto expected_version = current_snapshot_version;
-      decltype(expected_version) actual_version;
-      snapshot.read((char*)&actual_version, sizeof(actual_version));
-      EOS_ASSERT(actual_version == expected_version, snapshot_exception,
-                 "Binary snapshot is an unsuppored version.  Expected : ${expected}, Got: ${actual}",
-                 ("expected", expected_version)("actual", actual_version));
-
-      while (validate_section()) {}
+      snapshot.seekg(header_pos);
+      auto version = read_header();
+      auto scanned = scan_sections();
+
+      if (version >= 2) {
+         auto directory = read_directory(version);
+         EOS_ASSERT(directory.size() == scanned.size(), snapshot_exception,
+                    "Binary snapshot directory lists ${d} sections but the snapshot has ${s}",
+                    ("d", directory.size())("s", scanned.size()));
+         for (const auto& entry : scanned) {
+            auto itr = directory.find(entry.first);
+            EOS_ASSERT(itr != directory.end() && itr->second.pos == entry.second.pos, snapshot_exception,
+                       "Binary snapshot directory does not match section ${n}", ("n", entry.first));
+         }
+
+         // the row index of every section has to account for exactly its rows
+         for (const auto& entry : version >= 3 ? directory : section_map()) {
+            auto index = read_row_index(entry.second);
+            size_t pos = 0;
+            uint64_t size = sizeof(entry.second.rows) + entry.first.size() + 1;
+            for (uint64_t row = 0; row < entry.second.rows; ++row) {
+               size += detail::next_row_size(index, pos);
+            }
+            EOS_ASSERT(pos == index.size() && size == entry.second.size, snapshot_exception,
+                       "Binary snapshot row index does not match section ${n}", ("n", entry.first));
+         }
+      }
    } catch( const std::exception& e ) {  \
       snapshot_exception fce(FC_LOG_MESSAGE( warn, "Binary snapshot validation threw IO exception (${what})",("what",e.what())));
       throw fce;
    }
 }
 
-bool istream_snapshot_reader::validate_section() const {
-   uint64_t section_size = 0;
-   snapshot.read((char*)&section_size,sizeof(section_size));
+uint32_t istream_snapshot_reader::read_header() const {
+   // validate totem
+   auto expected_totem = ostream_snapshot_writer::magic_number;
+   decltype(expected_totem) actual_totem;
+   snapshot.read((char*)&actual_totem, sizeof(actual_totem));
+   EOS_ASSERT(actual_totem == expected_totem, snapshot_exception,
+              "Binary snapshot has unexpected magic number!");
+
+   // validate version
+   uint32_t actual_version = 0;
+   snapshot.read((char*)&actual_version, sizeof(actual_version));
+   EOS_ASSERT(actual_version >= minimum_snapshot_version && actual_version <= current_snapshot_version, snapshot_exception,
+              "Binary snapshot is an unsuppored version.  Expected : ${min} to ${expected}, Got: ${actual}",
+              ("min", minimum_snapshot_version)("expected", current_snapshot_version)("actual", actual_version));
+
+   return actual_version;
+}
+
+istream_snapshot_reader::section_entry istream_snapshot_reader::read_section_entry( std::streampos pos, const std::string& section_name ) const {
+   section_entry entry;
+   entry.pos = pos;
+
+   snapshot.seekg(pos);
+   snapshot.read((char*)&entry.size,sizeof(entry.size));
+   snapshot.read((char*)&entry.rows,sizeof(entry.rows));
 
-   // stop when we see the end marker
-   if (section_size == std::numeric_limits<uint64_t>::max()) {
-      return false;
+   bool match = entry.size >= sizeof(entry.rows) + section_name.size() + 1;
+   for(auto c : section_name) {
+      if(!match || snapshot.get() != c) {
+         match = false;
+         break;
+      }
    }
 
-   // seek past the section
-   snapshot.seekg(snapshot.tellg() + std::streamoff(section_size));
+   EOS_ASSERT(match && snapshot.get() == 0, snapshot_exception,
+              "Binary snapshot directory does not point at section ${n}", ("n", section_name));
+   return entry;
+}
 
-   return true;
+istream_snapshot_reader::section_map istream_snapshot_reader::scan_sections() const {
+   section_map result;
+   while (true) {
+      section_entry entry;
+      entry.pos = snapshot.tellg();
+      snapshot.read((char*)&entry.size,sizeof(entry.size));
+
+      // stop when we see the end marker
+      if (entry.size == std::numeric_limits<uint64_t>::max()) {
+         break;
+      }
+
+      auto next_section_pos = snapshot.tellg() + std::streamoff(entry.size);
+
+      snapshot.read((char*)&entry.rows,sizeof(entry.rows));
+      std::string section_name;
+      std::getline(snapshot, section_name, '\0');
+      result.emplace(std::move(section_name), entry);
+
+      // seek past the section
+      snapshot.seekg(next_section_pos);
+   }
+
+   return result;
+}
+
+istream_snapshot_reader::section_map istream_snapshot_reader::read_directory( uint32_t version ) const {
+   uint64_t directory_offset = 0;
+   uint64_t section_count = 0;
+
+   // the directory is located by the values that end the snapshot
+   snapshot.seekg(-std::streamoff(sizeof(directory_offset) + sizeof(section_count)), std::ios::end);
+   snapshot.read((char*)&directory_offset, sizeof(directory_offset));
+   snapshot.read((char*)&section_count, sizeof(section_count));
+
+   struct directory_entry {
+      std::string name;
+      uint64_t    offset = 0;
+      uint64_t    index_offset = 0;
+      uint64_t    index_size = 0;
+   };
+
+   std::vector<directory_entry> entries;
+   snapshot.seekg(header_pos + std::streamoff(directory_offset));
+   for (uint64_t i = 0; i < section_count; ++i) {
+      directory_entry entry;
+      snapshot.read((char*)&entry.offset, sizeof(entry.offset));
+      if (version >= 3) {
+         snapshot.read((char*)&entry.index_offset, sizeof(entry.index_offset));
+         snapshot.read((char*)&entry.index_size, sizeof(entry.index_size));
+      }
+      std::getline(snapshot, entry.name, '\0');
+      entries.emplace_back(std::move(entry));
+   }
+
+   section_map result;
+   for (const auto& e : entries) {
+      auto section = read_section_entry(header_pos + std::streamoff(e.offset), e.name);
+      section.index_offset = e.index_offset;
+      section.index_size = e.index_size;
+      result.emplace(e.name, section);
+   }
+
+   return result;
+}
+
+std::string istream_snapshot_reader::read_row_index( const section_entry& entry ) const {
+   auto restore_pos = fc::make_scoped_exit([this,pos=snapshot.tellg()](){
+      snapshot.seekg(pos);
+   });
+
+   std::string index(entry.index_size, '\0');
+   snapshot.seekg(header_pos + std::streamoff(entry.index_offset));
+   snapshot.read(&index[0], index.size());
+   EOS_ASSERT(snapshot.gcount() == std::streamsize(index.size()), snapshot_exception,
+              "Binary snapshot row index is truncated");
+   return index;
+}
+
+void istream_snapshot_reader::load_sections() {
+   if (sections_loaded) {
+      return;
+   }
+
+   auto restore_pos = fc::make_scoped_exit([this,pos=snapshot.tellg(),ex=snapshot.exceptions()](){
+      snapshot.seekg(pos);
+      snapshot.exceptions(ex);
+   });
+
+   snapshot.exceptions(std::istream::failbit|std::istream::eofbit);
+
+   try {
+      snapshot.seekg(header_pos);
+      version = read_header();
+
+      // version 1 snapshots have no directory and are scanned once instead
+      sections = version >= 2 ? read_directory(version) : scan_sections();
+      sections_loaded = true;
+   } catch( const std::exception& e ) {
+      snapshot_exception fce(FC_LOG_MESSAGE( warn, "Binary snapshot threw IO exception reading its sections (${what})",("what",e.what())));
+      throw fce;
+   }
+}
+
+const istream_snapshot_reader::section_entry& istream_snapshot_reader::find_section( const std::string& section_name ) {
+   load_sections();
+
+   auto itr = sections.find(section_name);
+   EOS_ASSERT(itr != sections.end(), snapshot_exception, "Binary snapshot has no section named ${n}", ("n", section_name));
+   return itr->second;
 }
 
 bool istream_snapshot_reader::has_section( const string& section_name ) {
+   load_sections();
+   return sections.count(section_name) > 0;
+}
+
+void istream_snapshot_reader::set_section( const string& section_name ) {
+   const auto& entry = find_section(section_name);
+
+   // leave the stream at the first row
+   snapshot.seekg(entry.pos + std::streamoff(sizeof(entry.size) + sizeof(entry.rows) + section_name.size() + 1));
+   cur_row = 0;
+   num_rows = entry.rows;
+   cur_section = &entry;
+   cur_row_index.clear();
+   cur_row_index_pos = 0;
+}
+
+std::shared_ptr<snapshot_reader> istream_snapshot_reader::read_buffered_section( const std::string& section_name ) {
+   const auto& entry = find_section(section_name);
+
    auto restore_pos = fc::make_scoped_exit([this,pos=snapshot.tellg()](){
       snapshot.seekg(pos);
    });
 
-   const std::streamoff header_size = sizeof(ostream_snapshot_writer::magic_number) + sizeof(current_snapshot_version);
+   const uint64_t header_size = sizeof(entry.rows) + section_name.size() + 1;
+   EOS_ASSERT(entry.size >= header_size, snapshot_exception, "Binary snapshot section ${n} is truncated", ("n", section_name));
+   std::string rows(entry.size - header_size, '\0');
 
-   auto next_section_pos = header_pos + header_size;
+   snapshot.seekg(entry.pos + std::streamoff(sizeof(entry.size) + header_size));
+   snapshot.read(&rows[0], rows.size());
+   EOS_ASSERT(snapshot.gcount() == std::streamsize(rows.size()), snapshot_exception,
+              "Binary snapshot section ${n} is truncated", ("n", section_name));
 
-   while (true) {
-      snapshot.seekg(next_section_pos);
-      uint64_t section_size = 0;
-      snapshot.read((char*)&section_size,sizeof(section_size));
-      if (section_size == std::numeric_limits<uint64_t>::max()) {
-         break;
+   return std::make_shared<section_buffer_reader>(section_name, entry.rows, std::move(rows));
+}
+
+bool istream_snapshot_reader::read_row( detail::abstract_snapshot_row_reader& row_reader ) {
+   row_reader.provide(snapshot);
+   return ++cur_row < num_rows;
+}
+
+bool istream_snapshot_reader::read_raw_row( std::string& row ) {
+   EOS_ASSERT(cur_section != nullptr && cur_row < num_rows, snapshot_exception, "Binary snapshot has no row to read");
+   if (cur_row_index.empty()) {
+      EOS_ASSERT(version >= 3, snapshot_exception,
+                 "Binary snapshot of version ${v} has no row index, it cannot be the base of a delta", ("v", version));
+      cur_row_index = read_row_index(*cur_section);
+   }
+
+   auto size = detail::next_row_size(cur_row_index, cur_row_index_pos);
+   row.resize(size);
+   snapshot.read(&row[0], size);
+   EOS_ASSERT(snapshot.gcount() == std::streamsize(size), snapshot_exception, "Binary snapshot row is truncated");
+   return ++cur_row < num_rows;
+}
+
+std::vector<std::string> istream_snapshot_reader::section_names() {
+   load_sections();
+
+   std::vector<std::pair<std::streamoff, std::string>> in_order;
+   for (const auto& entry : sections) {
+      in_order.emplace_back(std::streamoff(entry.second.pos), entry.first);
+   }
+   std::sort(in_order.begin(), in_order.end());
+
+   std::vector<std::string> names;
+   for (auto& s : in_order) {
+      names.emplace_back(std::move(s.second));
+   }
+   return names;
+}
+
+fc::sha256 istream_snapshot_reader::state_digest() {
+   if (digest_computed) {
+      return digest;
+   }
+
+   load_sections();
+   EOS_ASSERT(version >= 3, snapshot_exception,
+              "Binary snapshot of version ${v} has no row index, it cannot be the base of a delta", ("v", version));
+
+   auto restore_pos = fc::make_scoped_exit([this,pos=snapshot.tellg(),ex=snapshot.exceptions()](){
+      snapshot.seekg(pos);
+      snapshot.exceptions(ex);
+   });
+
+   snapshot.exceptions(std::istream::failbit|std::istream::eofbit);
+
+   // full snapshots do not store their digest, so writing one costs nothing; it is taken from the rows here, once
+   try {
+      detail::snapshot_state_digest computed;
+      std::vector<char> buffer(1024*1024);
+      for (const auto& name : section_names()) {
+         const auto& entry = sections.at(name);
+         const uint64_t header_size = sizeof(entry.rows) + name.size() + 1;
+         snapshot.seekg(entry.pos + std::streamoff(sizeof(entry.size) + header_size));
+         computed.add_section_start(name);
+         for (uint64_t left = entry.size - header_size; left > 0;) {
+            const auto chunk = std::min<uint64_t>(left, buffer.size());
+            snapshot.read(buffer.data(), chunk);
+            computed.add_rows(buffer.data(), chunk);
+            left -= chunk;
+         }
+         computed.add_section_end(entry.rows);
+      }
+      digest = computed.result();
+      digest_computed = true;
+   } catch( const std::exception& e ) {
+      snapshot_exception fce(FC_LOG_MESSAGE( warn, "Binary snapshot threw IO exception computing its state digest (${what})",("what",e.what())));
+      throw fce;
+   }
+   return digest;
+}
+
+bool istream_snapshot_reader::empty ( ) {
+   return num_rows == 0;
+}
+
+void istream_snapshot_reader::clear_section() {
+   num_rows = 0;
+   cur_row = 0;
+   cur_section = nullptr;
+   cur_row_index.clear();
+   cur_row_index_pos = 0;
+}
+
+void buffered_snapshot_writer::write_start_section( const std::string& section_name )
+{
+   sections.emplace_back(std::make_shared<section_buffer_writer>());
+   sections.back()->write_start_section(section_name);
+}
+
+void buffered_snapshot_writer::write_row( const detail::abstract_snapshot_row_writer& row_writer ) {
+   sections.back()->write_row(row_writer);
+}
+
+void buffered_snapshot_writer::write_end_section( ) {
+   sections.back()->write_end_section();
+}
+
+void buffered_snapshot_writer::write_buffered_section( const std::shared_ptr<section_buffer_writer>& buffer ) {
+   sections.emplace_back(buffer);
+}
+
+uint64_t buffered_snapshot_writer::size() const {
+   uint64_t result = 0;
+   for (const auto& s : sections) {
+      result += s->size();
+   }
+   return result;
+}
+
+void buffered_snapshot_writer::write_to( snapshot_writer& out ) {
+   EOS_ASSERT(out.accepts_buffered_sections(), snapshot_exception, "Snapshot writer cannot take captured sections");
+   for (auto& s : sections) {
+      out.write_buffered_section(s);
+      s.reset();
+   }
+   sections.clear();
+}
+
+namespace {
+   // how far ahead in the base a row is looked for before it is written as inserted, so that a reordered row
+   // cannot make the delta skip most of a section
+   const size_t max_delta_skip = 4096;
+
+   /// whether section_name is one of the numbered sections <name>.<n>, which share their rows, and its <name>.
+   bool numbered_section( const std::string& section_name, std::string& prefix ) {
+      const auto dot = section_name.rfind('.');
+      const auto digits = dot == std::string::npos ? 0 : section_name.size() - dot - 1;
+      if (digits == 0 || digits > 9 ||
+          !std::all_of(section_name.begin() + dot + 1, section_name.end(), []( char c ) { return c >= '0' && c <= '9'; })) {
+         return false;
+      }
+      prefix = section_name.substr(0, dot + 1);
+      return true;
+   }
+}
+
+delta_snapshot_writer::delta_snapshot_writer( const snapshot_reader_ptr& base, std::ostream& delta )
+:base(base)
+,base_digest(base->state_digest())
+,out(delta)
+{
+}
+
+void delta_snapshot_writer::write_start_section( const std::string& section_name )
+{
+   EOS_ASSERT(!current, snapshot_exception, "Attempting to write a new section without closing the previous section");
+   current = std::make_shared<section_buffer_writer>();
+   current->write_start_section(section_name);
+}
+
+void delta_snapshot_writer::write_row( const detail::abstract_snapshot_row_writer& row_writer ) {
+   current->write_row(row_writer);
+}
+
+void delta_snapshot_writer::write_end_section( ) {
+   current->write_end_section();
+   write_delta(*current);
+   current.reset();
+}
+
+void delta_snapshot_writer::write_buffered_section( const std::shared_ptr<section_buffer_writer>& buffer ) {
+   write_delta(*buffer);
+}
+
+void delta_snapshot_writer::load_base( const std::string& section_name ) {
+   std::string prefix;
+   const bool numbered = numbered_section(section_name, prefix);
+   const auto& group = numbered ? prefix : section_name;
+   if (base_loaded && base_numbered == numbered && base_group == group) {
+      return;
+   }
+
+   base_rows.clear();
+   base_sections.clear();
+   base_positions.clear();
+
+   auto load = [this]( const std::string& name ) {
+      base_sections.emplace_back(name, base_rows.size());
+      base->set_section(name);
+      bool more = !base->empty();
+      while (more) {
+         base_rows.emplace_back();
+         more = base->read_raw_row(base_rows.back());
+      }
+      base->clear_section();
+   };
+
+   // the shards of numbered sections are cut by row counts, so a row may end up in any of them
+   if (numbered) {
+      for (uint32_t n = 0; base->has_section(prefix + std::to_string(n)); ++n) {
+         load(prefix + std::to_string(n));
+      }
+   } else if (base->has_section(section_name)) {
+      load(section_name);
+   }
+
+   std::hash<std::string> hasher;
+   base_positions.reserve(base_rows.size());
+   for (size_t pos = 0; pos < base_rows.size(); ++pos) {
+      base_positions.emplace(hasher(base_rows[pos]), pos);
+   }
+
+   base_loaded = true;
+   base_numbered = numbered;
+   base_group = group;
+}
+
+void delta_snapshot_writer::write_delta( const section_buffer_writer& buffer ) {
+   const auto& section_name = buffer.name();
+   const auto data = buffer.contents();
+
+   digest.add_section_start(section_name);
+   digest.add_rows(data.data(), data.size());
+   digest.add_section_end(buffer.row_count());
+
+   load_base(section_name);
+
+   auto section_of = [&]( size_t pos ) {
+      auto itr = std::upper_bound(base_sections.begin(), base_sections.end(), pos,
+                                  []( size_t p, const auto& s ) { return p < s.second; });
+      return size_t(itr - base_sections.begin()) - 1;
+   };
+
+   size_t cur_section = std::numeric_limits<size_t>::max();
+   for (size_t s = 0; s < base_sections.size(); ++s) {
+      if (base_sections[s].first == section_name) {
+         cur_section = s;
       }
+   }
 
-      next_section_pos = snapshot.tellg() + std::streamoff(section_size);
+   std::hash<std::string> hasher;
+   out.write_start_section(section_name);
 
-      uint64_t ignore = 0;
-      snapshot.read((char*)&ignore,sizeof(ignore));
+   // runs of copied or skipped rows are coalesced into a single operation
+   snapshot_delta_op run;
+   auto flush_run = [&]() {
+      if (run.count > 0) {
+         out.write_row(detail::make_row_writer(run));
+         run.count = 0;
+      }
+   };
 
-      bool match = true;
-      for(auto c : section_name) {
-         if(snapshot.get() != c) {
-            match = false;
-            break;
+   auto add_run = [&]( uint8_t kind, uint64_t count ) {
+      while (count > 0) {
+         if (run.kind != kind || run.count == std::numeric_limits<uint32_t>::max()) {
+            flush_run();
+            run.kind = kind;
+         }
+         auto added = std::min<uint64_t>(count, std::numeric_limits<uint32_t>::max() - run.count);
+         run.count += added;
+         count -= added;
+      }
+   };
+
+   // the reader starts in the same section of the base, until the first row is matched it may be found anywhere
+   size_t next_base = cur_section < base_sections.size() ? base_sections[cur_section].second : 0;
+   bool matched = false;
+
+   // rows the reader passes over to get to pos: skipped ahead in its section, or after switching to the section of pos
+   auto cost_of = [&]( size_t pos ) {
+      const auto s = section_of(pos);
+      return s == cur_section && pos >= next_base ? pos - next_base : 1 + pos - base_sections[s].second;
+   };
+
+   size_t offset = 0;
+   for (auto size : buffer.row_sizes()) {
+      auto row = data.substr(offset, size);
+      offset += size;
+
+      // rows mostly keep their order, prefer the next row of the base over searching for the cheapest match
+      size_t match = base_rows.size();
+      if (matched && next_base < base_rows.size() && section_of(next_base) == cur_section && base_rows[next_base] == row) {
+         match = next_base;
+      } else {
+         size_t match_cost = std::numeric_limits<size_t>::max();
+         auto range = base_positions.equal_range(hasher(row));
+         for (auto itr = range.first; itr != range.second; ++itr) {
+            auto pos = itr->second;
+            auto cost = cost_of(pos);
+            bool reachable = !matched || cost <= max_delta_skip;
+            if (reachable && cost < match_cost && base_rows[pos] == row) {
+               match = pos;
+               match_cost = cost;
+            }
          }
       }
 
-      if (match && snapshot.get() == 0) {
-         return true;
+      if (match < base_rows.size()) {
+         const auto match_section = section_of(match);
+         if (match_section != cur_section || match < next_base) {
+            // the reader continues at the first row of the section the match is in
+            flush_run();
+            snapshot_delta_op switch_base;
+            switch_base.kind = snapshot_delta_op::base;
+            const auto& name = base_sections[match_section].first;
+            switch_base.row.assign(name.begin(), name.end());
+            out.write_row(detail::make_row_writer(switch_base));
+            cur_section = match_section;
+            next_base = base_sections[match_section].second;
+         }
+         add_run(snapshot_delta_op::skip, match - next_base);
+         add_run(snapshot_delta_op::copy, 1);
+         next_base = match + 1;
+         matched = true;
+         ++copied;
+      } else {
+         flush_run();
+         snapshot_delta_op insert;
+         insert.kind = snapshot_delta_op::insert;
+         insert.row.assign(row.begin(), row.end());
+         out.write_row(detail::make_row_writer(insert));
+         ++inserted;
       }
    }
 
-   return false;
+   flush_run();
+   out.write_end_section();
 }
 
-void istream_snapshot_reader::set_section( const string& section_name ) {
-   auto restore_pos = fc::make_scoped_exit([this,pos=snapshot.tellg()](){
-      snapshot.seekg(pos);
+void delta_snapshot_writer::finalize() {
+   EOS_ASSERT(!current, snapshot_exception, "Attempting to finalize a delta snapshot with a section still open");
+
+   out.write_start_section(detail::snapshot_section_traits<snapshot_delta_header>::section_name());
+   out.write_row(detail::make_row_writer(snapshot_delta_header{base_digest, digest.result()}));
+   out.write_end_section();
+   out.finalize();
+}
+
+delta_snapshot_reader::delta_snapshot_reader( const snapshot_reader_ptr& base, std::istream& delta )
+:base(base)
+,delta_stream(delta)
+,delta(delta)
+,cur_op(0)
+,cur_op_done(0)
+,num_rows(0)
+,cur_row(0)
+,base_section(false)
+{
+   this->delta.read_section<snapshot_delta_header>([this]( auto& section ) {
+      section.read_row(header);
    });
+}
 
-   const std::streamoff header_size = sizeof(ostream_snapshot_writer::magic_number) + sizeof(current_snapshot_version);
+void delta_snapshot_reader::validate() const {
+   // each layer is checked once, its file and that it applies to the state below it; the bases are not replayed
+   // on their own, the replay of this delta reads every row of theirs that it is made of
+   std::vector<const delta_snapshot_reader*> layers{this};
+   while (auto below = dynamic_cast<const delta_snapshot_reader*>(layers.back()->base.get())) {
+      layers.push_back(below);
+   }
+   layers.back()->base->validate();
+   for (auto itr = layers.rbegin(); itr != layers.rend(); ++itr) {
+      const auto& layer = **itr;
+      layer.delta.validate();
+      const auto base_digest = layer.base->state_digest();
+      EOS_ASSERT(base_digest == layer.header.base_digest, snapshot_exception,
+                 "Delta snapshot applies to state ${d}, the base snapshot holds ${b}",
+                 ("d", layer.header.base_digest)("b", base_digest));
+   }
 
-   auto next_section_pos = header_pos + header_size;
+   // the header only claims a state, replaying the delta on its own reader shows whether it rebuilds that state
+   delta_snapshot_reader replay(base, delta_stream);
+   const auto rebuilt = replay.replay_state_digest();
+   EOS_ASSERT(rebuilt == header.state_digest, snapshot_exception,
+              "Delta snapshot rebuilds state ${r} instead of ${d}", ("r", rebuilt)("d", header.state_digest));
+}
 
-   while (true) {
-      snapshot.seekg(next_section_pos);
-      uint64_t section_size = 0;
-      snapshot.read((char*)&section_size,sizeof(section_size));
-      if (section_size == std::numeric_limits<uint64_t>::max()) {
-         break;
+fc::sha256 delta_snapshot_reader::replay_state_digest() {
+   detail::snapshot_state_digest computed;
+   std::string row;
+   for (const auto& section_name : delta.section_names()) {
+      if (!has_section(section_name)) {
+         continue;
       }
 
-      next_section_pos = snapshot.tellg() + std::streamoff(section_size);
+      set_section(section_name);
+      computed.add_section_start(section_name);
+      bool more = !empty();
+      while (more) {
+         more = read_raw_row(row);
+         computed.add_rows(row.data(), row.size());
+      }
+      computed.add_section_end(num_rows);
+      clear_section();
+   }
+   return computed.result();
+}
 
-      uint64_t row_count = 0;
-      snapshot.read((char*)&row_count,sizeof(row_count));
+bool delta_snapshot_reader::has_section( const string& section_name ) {
+   return section_name != detail::snapshot_section_traits<snapshot_delta_header>::section_name() &&
+          delta.has_section(section_name);
+}
 
-      bool match = true;
-      for(auto c : section_name) {
-         if(snapshot.get() != c) {
-            match = false;
-            break;
-         }
+void delta_snapshot_reader::set_section( const string& section_name ) {
+   EOS_ASSERT(has_section(section_name), snapshot_exception,
+              "Delta snapshot has no section named ${n}", ("n", section_name));
+
+   ops.clear();
+   delta.read_section(section_name, [this]( auto& section ) {
+      bool more = !section.empty();
+      while (more) {
+         ops.emplace_back();
+         more = section.read_row(ops.back());
+      }
+   });
+
+   if (base_section) {
+      base->clear_section();
+      base_section = false;
+   }
+   num_rows = 0;
+   this->section_name = section_name;
+   for (const auto& op : ops) {
+      EOS_ASSERT(op.kind <= snapshot_delta_op::base, snapshot_exception,
+                 "Delta snapshot section ${n} has an unknown operation ${k}", ("n", section_name)("k", op.kind));
+      if (op.kind == snapshot_delta_op::insert) {
+         ++num_rows;
+      } else if (op.kind == snapshot_delta_op::copy) {
+         num_rows += op.count;
       }
+   }
 
-      if (match && snapshot.get() == 0) {
-         cur_row = 0;
-         num_rows = row_count;
+   cur_op = 0;
+   cur_op_done = 0;
+   cur_row = 0;
+}
 
-         // leave the stream at the right point
-         restore_pos.cancel();
+void delta_snapshot_reader::set_base_section( const std::string& name ) {
+   EOS_ASSERT(base->has_section(name), snapshot_exception,
+              "Delta snapshot section ${n} copies from section ${b} the base snapshot does not have",
+              ("n", section_name)("b", name));
+   if (base_section) {
+      base->clear_section();
+   }
+   base->set_section(name);
+   base_section = true;
+}
+
+void delta_snapshot_reader::next_row( std::string& row ) {
+   while (true) {
+      EOS_ASSERT(cur_op < ops.size(), snapshot_exception, "Delta snapshot section has fewer rows than it claims");
+      const auto& op = ops[cur_op];
+
+      if (op.kind == snapshot_delta_op::insert) {
+         row.assign(op.row.begin(), op.row.end());
+         ++cur_op;
          return;
       }
+
+      if (op.kind == snapshot_delta_op::base) {
+         set_base_section(std::string(op.row.begin(), op.row.end()));
+         ++cur_op;
+         continue;
+      }
+
+      // rows are taken from the same section of the base until the delta switches to another one
+      if (!base_section) {
+         set_base_section(section_name);
+      }
+
+      if (op.kind == snapshot_delta_op::skip) {
+         for (uint32_t i = 0; i < op.count; ++i) {
+            base->read_raw_row(scratch);
+         }
+         ++cur_op;
+         continue;
+      }
+
+      if (cur_op_done == op.count) {
+         ++cur_op;
+         cur_op_done = 0;
+         continue;
+      }
+
+      base->read_raw_row(row);
+      ++cur_op_done;
+      return;
    }
+}
 
-   EOS_THROW(snapshot_exception, "Binary snapshot has no section named ${n}", ("n", section_name));
+bool delta_snapshot_reader::read_row( detail::abstract_snapshot_row_reader& row_reader ) {
+   next_row(scratch);
+   std::istringstream in(scratch);
+   row_reader.provide(in);
+   return ++cur_row < num_rows;
 }
 
-bool istream_snapshot_reader::read_row( detail::abstract_snapshot_row_reader& row_reader ) {
-   row_reader.provide(snapshot);
+bool delta_snapshot_reader::read_raw_row( std::string& row ) {
+   next_row(row);
    return ++cur_row < num_rows;
 }
 
-bool istream_snapshot_reader::empty ( ) {
+bool delta_snapshot_reader::empty ( ) {
    return num_rows == 0;
 }
 
-void istream_snapshot_reader::clear_section() {
+void delta_snapshot_reader::clear_section() {
+   if (base_section) {
+      base->clear_section();
+   }
+   ops.clear();
    num_rows = 0;
    cur_row = 0;
+   cur_op = 0;
+   cur_op_done = 0;
+   base_section = false;
+}
+
+fc::sha256 delta_snapshot_reader::state_digest() {
+   return header.state_digest;
 }
 
 integrity_hash_snapshot_writer::integrity_hash_snapshot_writer(fc::sha256::encoder& enc)
@@ -358,4 +1112,21 @@ void integrity_hash_snapshot_writer::finalize() {
    // no-op for structural details
 }
 
+void section_digest_snapshot_writer::write_start_section( const std::string& section_name )
+{
+   enc.reset();
+   enc.write(section_name.c_str(), section_name.size() + 1);
+   rows = 0;
+}
+
+void section_digest_snapshot_writer::write_row( const detail::abstract_snapshot_row_writer& row_writer ) {
+   row_writer.write(enc);
+   rows++;
+}
+
+void section_digest_snapshot_writer::write_end_section( ) {
+   enc.write((const char*)&rows, sizeof(rows));
+   digests.push_back(enc.result());
+}
+
 }}
\ No newline at end of file
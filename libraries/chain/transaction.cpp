@@ -6,13 +6,8 @@
 #include <fc/bitutil.hpp>
 #include <fc/smart_ref_impl.hpp>
 #include <algorithm>
-#include <mutex>
 
 #include <boost/range/adaptor/transformed.hpp>
-#include <boost/multi_index_container.hpp>
-#include <boost/multi_index/sequenced_index.hpp>
-#include <boost/multi_index/hashed_index.hpp>
-#include <boost/multi_index/member.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/iostreams/device/back_inserter.hpp>
 #include <boost/iostreams/filter/zlib.hpp>
@@ -20,36 +15,10 @@
 #include <eosio/chain/config.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/transaction.hpp>
+#include <eosio/chain/signature_recovery_cache.hpp>
 
 namespace eosio { namespace chain {
 
-using namespace boost::multi_index;
-
-struct cached_pub_key {
-   transaction_id_type trx_id;
-   public_key_type pub_key;
-   signature_type sig;
-   fc::microseconds cpu_usage;
-   cached_pub_key(const cached_pub_key&) = delete;
-   cached_pub_key() = delete;
-   cached_pub_key& operator=(const cached_pub_key&) = delete;
-   cached_pub_key(cached_pub_key&&) = default;
-};
-struct by_sig{};
-
-typedef multi_index_container<
-   cached_pub_key,
-   indexed_by<
-      sequenced<>,
-      hashed_unique<
-         tag<by_sig>,
-         member<cached_pub_key,
-                signature_type,
-                &cached_pub_key::sig>
-      >
-   >
-> recovery_cache_type;
-
 void transaction_header::set_reference_block( const block_id_type& reference_block ) {
    ref_block_num    = fc::endian_reverse_u32(reference_block._hash[0]);
    ref_block_prefix = reference_block._hash[1];
@@ -85,7 +54,7 @@ digest_type transaction::sig_digest( const chain_id_type& chain_id, const vector
 }
 
 // 从签名中提取公钥, 结果存储在recovered_pub_keys中
-// 最终这个函数内部保存了 recovery_cache的多索引容器,里面包含了数据结构 cached_pub_key,最多包含10000个
+// 恢复出的公钥保存在分片的 signature_recovery_cache 中,容量由 signature-cache-size 配置
 // 猜测这个功能是从外部收到交易之后将交易信息保存在本地
 fc::microseconds transaction::get_signature_keys( const vector<signature_type>& signatures,
       const chain_id_type& chain_id, fc::time_point deadline, const vector<bytes>& cfd,
@@ -93,15 +62,12 @@ fc::microseconds transaction::get_signature_keys( const vector<signature_type>&
 { try {
    using boost::adaptors::transformed;
 
-   constexpr size_t recovery_cache_size = 10000;
-   static recovery_cache_type recovery_cache;// 保存cached_pub_key 的多索引容器
-   static std::mutex cache_mtx;
+   auto& recovery_cache = signature_recovery_cache::instance();
 
    auto start = fc::time_point::now();
    recovered_pub_keys.clear();
    const digest_type digest = sig_digest(chain_id, cfd);// 获得digest
 
-   std::unique_lock<std::mutex> lock(cache_mtx, std::defer_lock);
    fc::microseconds sig_cpu_usage;
    
    // 遍历交易中所有的签名
@@ -112,23 +78,15 @@ fc::microseconds transaction::get_signature_keys( const vector<signature_type>&
       public_key_type recov;
 
       const auto& tid = id();  // 返回交易的id, 类型为fc::sha256;
-      lock.lock();
+      fc::microseconds cpu_usage;
 
-      // 根据签名在cache中寻找公钥的迭代器位置
-      recovery_cache_type::index<by_sig>::type::iterator it = recovery_cache.get<by_sig>().find( sig );
       // 未找到签名或者找到签名,但是签名的交易id不是本次交易的id
-      if( it == recovery_cache.get<by_sig>().end() || it->trx_id != tid ) {
-         lock.unlock();
+      if( !recovery_cache.find( sig, tid, recov, cpu_usage ) ) {
          recov = public_key_type( sig, digest );// 通过签名和摘要(digest)可以获取公钥
-         fc::microseconds cpu_usage = fc::time_point::now() - start;
-         lock.lock();
-         recovery_cache.emplace_back( cached_pub_key{tid, recov, sig, cpu_usage} ); //could fail on dup signatures; not a problem
-         sig_cpu_usage += cpu_usage;
-      } else {
-         recov = it->pub_key;
-         sig_cpu_usage += it->cpu_usage;
+         cpu_usage = fc::time_point::now() - start;
+         recovery_cache.insert( sig, tid, recov, cpu_usage );
       }
-      lock.unlock();
+      sig_cpu_usage += cpu_usage;
       bool successful_insertion = false;
       std::tie(std::ignore, successful_insertion) = recovered_pub_keys.insert(recov);
       EOS_ASSERT( allow_duplicate_keys || successful_insertion, tx_duplicate_sig,
@@ -136,11 +94,6 @@ fc::microseconds transaction::get_signature_keys( const vector<signature_type>&
                   ("key", recov) );
    }
 
-   lock.lock();
-   while ( recovery_cache.size() > recovery_cache_size )
-      recovery_cache.erase( recovery_cache.begin());
-   lock.unlock();
-
    return sig_cpu_usage;
 } FC_CAPTURE_AND_RETHROW() }
 
@@ -160,12 +160,16 @@ namespace bacc = boost::accumulators;
    {
       if (!c.skip_db_sessions()) {
          undo_session = c.mutable_db().start_undo_session(true);
+         usage_session = c.get_mutable_resource_limits_manager().start_usage_session();
       }
       trace->id = id;
       trace->block_num = c.pending_block_state()->block_num;
       trace->block_time = c.pending_block_time();
       trace->producer_block_id = c.pending_producer_block_id();
       executed.reserve( trx.total_actions() );
+      if( c.analyze_transaction_conflicts() ) {
+         access_set.emplace();
+      }
       EOS_ASSERT( trx.transaction_extensions.size() == 0, unsupported_feature, "we don't support any extensions yet" );
    }
 
@@ -228,6 +232,10 @@ namespace bacc = boost::accumulators;
       // Update usage values of accounts to reflect new time
       rl.update_account_usage( bill_to_accounts, block_timestamp_type(control.pending_block_time()).slot );
 
+      if( access_set ) {
+         for( const auto& a : bill_to_accounts ) access_set->add_write( a );
+      }
+
       // Calculate the highest network usage and CPU time that all of the billed accounts can afford to be billed
       int64_t account_net_limit = 0;
       int64_t account_cpu_limit = 0;
@@ -405,10 +413,12 @@ namespace bacc = boost::accumulators;
 
    void transaction_context::squash() {
       if (undo_session) undo_session->squash();
+      if (usage_session) usage_session->squash();
    }
 
    void transaction_context::undo() {
       if (undo_session) undo_session->undo();
+      if (usage_session) usage_session->undo();
    }
 
    void transaction_context::check_net_usage()const {
@@ -1,6 +1,10 @@
 #include <eosio/chain/transaction_metadata.hpp>
 #include <eosio/chain/thread_utils.hpp>
 #include <boost/asio/thread_pool.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
 
 namespace eosio { namespace chain {
 
@@ -43,5 +47,81 @@ void transaction_metadata::create_signing_keys_future( const transaction_metadat
    } );
 }
 
+namespace {
+   /// chunks still to be claimed and finished, shared with helpers that may only start after the batch returned
+   struct recovery_batch {
+      std::function<void(size_t)> recover_chunk;
+      size_t                      chunks = 0;
+      std::atomic<size_t>         next{0};
+      size_t                      finished = 0;
+      std::mutex                  mtx;
+      std::condition_variable     all_finished;
+
+      void run() {
+         for( size_t c = next++; c < chunks; c = next++ ) {
+            recover_chunk( c );
+            std::lock_guard<std::mutex> g( mtx );
+            if( ++finished == chunks )
+               all_finished.notify_one();
+         }
+      }
+   };
+}
+
+void transaction_metadata::recover_keys_batch( const vector<transaction_metadata_ptr>& trxs, boost::asio::thread_pool& thread_pool,
+                                               uint32_t threads, const chain_id_type& chain_id, fc::microseconds time_limit ) {
+   vector<transaction_metadata*> pending;
+   size_t total_sigs = 0;
+   pending.reserve( trxs.size() );
+   for( const auto& mtrx : trxs ) {
+      if( mtrx->signing_keys.valid() || mtrx->signing_keys_future.valid() )
+         continue;
+      pending.push_back( mtrx.get() );
+      total_sigs += mtrx->packed_trx->get_signed_transaction().signatures.size();
+   }
+   if( pending.empty() )
+      return;
+
+   // a few chunks per thread so that a slow chunk does not hold up the batch, a chunk ends with the
+   // transaction that reaches its share of the signatures
+   const size_t target_chunks = std::max<size_t>( std::min<size_t>( size_t(threads + 1) * 4, pending.size() ), 1 );
+   const size_t sigs_per_chunk = std::max<size_t>( (total_sigs + target_chunks - 1) / target_chunks, 1 );
+   vector<size_t> bounds( 1, 0 );
+   size_t chunk_sigs = 0;
+   for( size_t i = 0; i < pending.size(); ++i ) {
+      chunk_sigs += pending[i]->packed_trx->get_signed_transaction().signatures.size();
+      if( chunk_sigs >= sigs_per_chunk || i + 1 == pending.size() ) {
+         bounds.push_back( i + 1 );
+         chunk_sigs = 0;
+      }
+   }
+
+   auto batch = std::make_shared<recovery_batch>();
+   batch->chunks = bounds.size() - 1;
+   batch->recover_chunk = [&pending, &bounds, &chain_id, time_limit]( size_t c ) {
+      for( size_t i = bounds[c]; i < bounds[c+1]; ++i ) {
+         transaction_metadata& mtrx = *pending[i];
+         fc::time_point deadline = time_limit == fc::microseconds::maximum() ?
+               fc::time_point::maximum() : fc::time_point::now() + time_limit;
+         try {
+            flat_set<public_key_type> recovered_pub_keys;
+            mtrx.sig_cpu_usage = mtrx.packed_trx->get_signed_transaction().get_signature_keys( chain_id, deadline, recovered_pub_keys );
+            mtrx.signing_keys.emplace( chain_id, std::move( recovered_pub_keys ));
+         } catch( ... ) {
+            // recovered again and reported by recover_keys()
+         }
+      }
+   };
+
+   const size_t helpers = std::min<size_t>( threads, batch->chunks - 1 );
+   for( size_t h = 0; h < helpers; ++h )
+      boost::asio::post( thread_pool, [batch]() { batch->run(); } );
+   batch->run();
+
+   // chunks claimed by helpers are already running, so waiting here cannot starve the pool
+   std::unique_lock<std::mutex> g( batch->mtx );
+   batch->all_finished.wait( g, [&batch]() { return batch->finished == batch->chunks; } );
+}
+
 
 } } // eosio::chain
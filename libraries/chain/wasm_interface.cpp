@@ -27,7 +27,8 @@ namespace eosio { namespace chain {
    using namespace webassembly;
    using namespace webassembly::common;
 
-   wasm_interface::wasm_interface(vm_type vm) : my( new wasm_interface_impl(vm) ) {}
+   wasm_interface::wasm_interface(vm_type vm, uint32_t max_cached_modules, uint64_t max_cache_bytes)
+   : my( new wasm_interface_impl(vm, max_cached_modules, max_cache_bytes) ) {}
 
    wasm_interface::~wasm_interface() {}
 
@@ -61,6 +62,25 @@ namespace eosio { namespace chain {
       my->runtime_interface->immediately_exit_currently_running_module();
    }
 
+   void wasm_interface::queue_preparation(const digest_type& code_id, const bytes& code, boost::asio::thread_pool& pool) {
+      my->queue_preparation(code_id, code, pool);
+   }
+
+   wasm_interface::cache_stats wasm_interface::get_cache_stats()const {
+      auto stats = my->cache_stats;
+      stats.background_prepares = my->background_prepares;
+      stats.background_prepare_us = my->background_prepare_us;
+      return stats;
+   }
+
+   vector<digest_type> wasm_interface::cached_modules()const {
+      vector<digest_type> code_ids;
+      code_ids.reserve(my->instantiation_cache.size());
+      for(const auto& e : my->instantiation_cache)
+         code_ids.push_back(e.code_id);
+      return code_ids;
+   }
+
    wasm_instantiated_module_interface::~wasm_instantiated_module_interface() {}
    wasm_runtime_interface::~wasm_runtime_interface() {}
 
@@ -12,7 +12,22 @@
 #include "Runtime/Linker.h"
 #include "Runtime/Intrinsics.h"
 
+#include <map>
 #include <mutex>
+#include <set>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(SYS_memfd_create)
+#define EOSIO_WAVM_COW_MEMORY_IMAGE 1
+#else
+#define EOSIO_WAVM_COW_MEMORY_IMAGE 0
+#endif
 
 using namespace IR;
 using namespace Runtime;
@@ -21,13 +36,222 @@ namespace eosio { namespace chain { namespace webassembly { namespace wavm {
 
 running_instance_context the_running_instance_context;
 
+#if EOSIO_WAVM_COW_MEMORY_IMAGE
+/**
+ * A single anonymous in-memory file holding the memory images of all live modules, so the number of open file
+ * descriptors does not grow with the number of cached modules. The file is created when the first image is stored.
+ * Space of released images is punched out of the file and reused for later ones.
+ */
+class wavm_memory_image_arena {
+   public:
+      //never destroyed, images may be released during static destruction
+      static wavm_memory_image_arena& instance() {
+         static wavm_memory_image_arena* arena = new wavm_memory_image_arena;
+         return *arena;
+      }
+
+      int fd() const { return _fd; }
+
+      /// copies image into size bytes of the arena, returns their offset or -1 if the image could not be stored
+      off_t store(const std::vector<uint8_t>& image, size_t size) {
+         std::lock_guard<std::mutex> l(_lock);
+         if(_fd < 0) {
+            if(_unavailable)
+               return -1;
+            _fd = syscall(SYS_memfd_create, "eosio-wasm-memory-images", 1 /*MFD_CLOEXEC*/);
+            if(_fd < 0) {
+               _unavailable = true;
+               return -1;
+            }
+         }
+
+         off_t offset = -1;
+         bool reused = false;
+         for(auto itr = _free.begin(); itr != _free.end(); ++itr) {
+            if(itr->second < size)
+               continue;
+            offset = itr->first;
+            if(itr->second > size)
+               _free.emplace(offset + size, itr->second - size);
+            _free.erase(itr);
+            reused = true;
+            break;
+         }
+         if(offset < 0) {
+            if(ftruncate(_fd, _end + size) != 0)
+               return -1;
+            offset = _end;
+            _end += size;
+         }
+
+         bool stored = write_all(image.data(), image.size(), offset);
+         //the tail of a reused range may still hold a released image if punching it out failed
+         if(stored && reused && size > image.size()) {
+            const std::vector<uint8_t> zeros(size - image.size());
+            stored = write_all(zeros.data(), zeros.size(), offset + image.size());
+         }
+         if(!stored) {
+            release_locked(offset, size);
+            return -1;
+         }
+         return offset;
+      }
+
+      void release(off_t offset, size_t size) {
+         std::lock_guard<std::mutex> l(_lock);
+         release_locked(offset, size);
+      }
+
+   private:
+      wavm_memory_image_arena() = default;
+
+      bool write_all(const uint8_t* data, size_t size, off_t offset) {
+         size_t written = 0;
+         while(written < size) {
+            ssize_t r = pwrite(_fd, data + written, size - written, offset + written);
+            if(r <= 0)
+               return false;
+            written += r;
+         }
+         return true;
+      }
+
+      /**
+       * Gives the pages back to the kernel. The file is never shrunk, linear memory may still have the released image
+       * mapped until the next action resets it and a mapping past the end of the file would fault instead of reading
+       * zeros.
+       */
+      void release_locked(off_t offset, size_t size) {
+         fallocate(_fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE, offset, size);
+
+         auto next = _free.lower_bound(offset);
+         if(next != _free.end() && offset + off_t(size) == next->first) {
+            size += next->second;
+            next = _free.erase(next);
+         }
+         if(next != _free.begin()) {
+            auto prev = std::prev(next);
+            if(prev->first + off_t(prev->second) == offset) {
+               offset = prev->first;
+               size += prev->second;
+               _free.erase(prev);
+            }
+         }
+         _free.emplace(offset, size);
+      }
+
+      std::mutex               _lock;
+      int                      _fd = -1;
+      bool                     _unavailable = false;
+      off_t                    _end = 0;
+      std::map<off_t, size_t>  _free; //offset -> size of released ranges below _end
+};
+#endif
+
+/**
+ * A module's initial memory image held in the shared in-memory file of wavm_memory_image_arena. Instead of copying
+ * the image into linear memory before every action it is mapped copy-on-write over the start of linear memory, so
+ * an action only pays for the pages it actually touches. Small images are cheaper to memcpy and are not mapped,
+ * neither are images that could not be stored in the arena.
+ */
+class wavm_memory_image {
+   public:
+      static constexpr size_t min_mapped_size = 64*1024;
+
+      explicit wavm_memory_image(const std::vector<uint8_t>& image) {
+#if EOSIO_WAVM_COW_MEMORY_IMAGE
+         if(image.size() < min_mapped_size)
+            return;
+         _size = (image.size() + page_size() - 1) & ~(page_size() - 1);
+         _offset = wavm_memory_image_arena::instance().store(image, _size);
+#endif
+      }
+
+      ~wavm_memory_image() {
+#if EOSIO_WAVM_COW_MEMORY_IMAGE
+         if(_offset >= 0)
+            wavm_memory_image_arena::instance().release(_offset, _size);
+#endif
+      }
+
+      wavm_memory_image(const wavm_memory_image&) = delete;
+      wavm_memory_image& operator=(const wavm_memory_image&) = delete;
+
+      /// maps the image over the start of linear memory, false if it has to be copied in instead
+      bool map(char* memstart, size_t memory_size) const {
+#if EOSIO_WAVM_COW_MEMORY_IMAGE
+         if(_offset < 0 || _size > memory_size)
+            return false;
+         _mapped_size = _size;
+         if(mmap(memstart, _size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_FIXED, wavm_memory_image_arena::instance().fd(), _offset) == MAP_FAILED) {
+            //a failed MAP_FIXED may have dropped the old pages, put anonymous ones back before copying instead
+            unmap(memstart, memory_size);
+            return false;
+         }
+         return true;
+#else
+         return false;
+#endif
+      }
+
+      /**
+       * Puts anonymous zero pages back where an image was mapped. A file backed mapping would otherwise survive
+       * WAVM shrinking the memory and leak this image into the next module using the shared memory instance.
+       */
+      static void unmap(char* memstart, size_t memory_size) {
+#if EOSIO_WAVM_COW_MEMORY_IMAGE
+         if(!_mapped_size)
+            return;
+         const size_t accessible = std::min(_mapped_size, memory_size);
+         if(accessible)
+            EOS_ASSERT(mmap(memstart, accessible, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED, -1, 0) != MAP_FAILED,
+                       wasm_execution_error, "failed to reset WASM memory image");
+         if(_mapped_size > accessible)
+            EOS_ASSERT(mmap(memstart + accessible, _mapped_size - accessible, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED, -1, 0) != MAP_FAILED,
+                       wasm_execution_error, "failed to reset WASM memory image");
+         _mapped_size = 0;
+#endif
+      }
+
+   private:
+#if EOSIO_WAVM_COW_MEMORY_IMAGE
+      static size_t page_size() {
+         static const size_t size = sysconf(_SC_PAGESIZE);
+         return size;
+      }
+
+      //bytes at the start of the (single, shared) linear memory currently backed by an image mapping
+      static size_t _mapped_size;
+
+      off_t  _offset = -1;
+      size_t _size = 0;
+#endif
+};
+
+#if EOSIO_WAVM_COW_MEMORY_IMAGE
+size_t wavm_memory_image::_mapped_size = 0;
+#endif
+
+//module instances of all live wavm_instantiated_modules, these are the roots when collecting unreferenced WAVM objects
+static std::set<ModuleInstance*> __live_module_instances;
+static std::mutex __live_module_instances_lock;
+
 class wavm_instantiated_module : public wasm_instantiated_module_interface {
    public:
       wavm_instantiated_module(ModuleInstance* instance, std::unique_ptr<Module> module, std::vector<uint8_t> initial_mem) :
          _initial_memory(initial_mem),
+         _memory_image(_initial_memory),
          _instance(instance),
          _module(std::move(module))
-      {}
+      {
+         std::lock_guard<std::mutex> l(__live_module_instances_lock);
+         __live_module_instances.insert(_instance);
+      }
+
+      ~wavm_instantiated_module() {
+         std::lock_guard<std::mutex> l(__live_module_instances_lock);
+         __live_module_instances.erase(_instance);
+      }
 
       void apply(apply_context& context) override {
          vector<Value> args = {Value(uint64_t(context.receiver)),
@@ -37,6 +261,10 @@ class wavm_instantiated_module : public wasm_instantiated_module_interface {
          call("apply", args, context);
       }
 
+      size_t generated_code_bytes() const override {
+         return getGeneratedCodeNumBytes(_instance);
+      }
+
    private:
       void call(const string &entry_point, const vector <Value> &args, apply_context &context) {
          try {
@@ -55,7 +283,10 @@ class wavm_instantiated_module : public wasm_instantiated_module_interface {
                resetMemory(default_mem, _module->memories.defs[0].type);
 
                char* memstart = &memoryRef<char>(getDefaultMemory(_instance), 0);
-               memcpy(memstart, _initial_memory.data(), _initial_memory.size());
+               const size_t memory_size = getMemoryNumPages(default_mem) << IR::numBytesPerPageLog2;
+               wavm_memory_image::unmap(memstart, memory_size);
+               if(!_memory_image.map(memstart, memory_size))
+                  memcpy(memstart, _initial_memory.data(), _initial_memory.size());
             }
 
             the_running_instance_context.memory = default_mem;
@@ -75,8 +306,9 @@ class wavm_instantiated_module : public wasm_instantiated_module_interface {
 
 
       std::vector<uint8_t>     _initial_memory;
+      wavm_memory_image        _memory_image;
       //naked pointer because ModuleInstance is opaque
-      //_instance is deleted via WAVM's object garbage collection when wavm_rutime is deleted
+      //_instance is deleted via WAVM's object garbage collection, see wavm_runtime::free_unreferenced_modules()
       ModuleInstance*          _instance;
       std::unique_ptr<Module>  _module;
 };
@@ -127,6 +359,11 @@ std::unique_ptr<wasm_instantiated_module_interface> wavm_runtime::instantiate_mo
    return std::make_unique<wavm_instantiated_module>(instance, std::move(module), initial_memory);
 }
 
+void wavm_runtime::free_unreferenced_modules() {
+   std::lock_guard<std::mutex> l(__live_module_instances_lock);
+   Runtime::freeUnreferencedObjects(std::vector<ObjectInstance*>(__live_module_instances.begin(), __live_module_instances.end()));
+}
+
 void wavm_runtime::immediately_exit_currently_running_module() {
 #ifdef _WIN32
    throw wasm_exit();
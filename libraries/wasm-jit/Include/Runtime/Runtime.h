@@ -209,6 +209,8 @@ namespace Runtime
 	RUNTIME_API MemoryInstance* getDefaultMemory(ModuleInstance* moduleInstance);
 	RUNTIME_API uint64_t getDefaultMemorySize(ModuleInstance* moduleInstance);
 	RUNTIME_API TableInstance* getDefaultTable(ModuleInstance* moduleInstance);
+	// EOSIO: bytes of machine code and data the JIT generated for a ModuleInstance.
+	RUNTIME_API Uptr getGeneratedCodeNumBytes(ModuleInstance* moduleInstance);
 
 	RUNTIME_API void runInstanceStartFunc(ModuleInstance* moduleInstance);
 	RUNTIME_API void resetGlobalInstances(ModuleInstance* moduleInstance);
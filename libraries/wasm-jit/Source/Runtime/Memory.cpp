@@ -114,7 +114,11 @@ namespace Runtime
 			{
 				return -1;
 			}
+			// EOSIO: skip the clear on Linux, where Platform::decommitVirtualPages drops pages with MADV_DONTNEED and they
+			// read back as zero. Clearing them here would fault in the whole memory on every resetMemory.
+			#ifndef __linux__
 			memset(memory->baseAddress + (memory->numPages << IR::numBytesPerPageLog2), 0, numNewPages << IR::numBytesPerPageLog2);
+			#endif
 			memory->numPages += numNewPages;
 		}
 		return previousNumPages;
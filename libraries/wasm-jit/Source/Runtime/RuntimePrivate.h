@@ -17,6 +17,8 @@ namespace LLVMJIT
 	struct JITModuleBase
 	{
 		virtual ~JITModuleBase() {}
+		// EOSIO: bytes of machine code and data generated for the module, used to bound the instantiation cache
+		virtual Uptr getNumImageBytes() const = 0;
 	};
 
 	void init();
@@ -7,6 +7,8 @@
 
 #include <fc/io/json.hpp>
 
+#include <sstream>
+
 namespace eosio {
 
 static appbase::abstract_plugin& _chain_api_plugin = app().register_plugin<chain_api_plugin>();
@@ -48,6 +50,21 @@ struct async_result_visitor : public fc::visitor<std::string> {
           } \
        }}
 
+// for calls that write their JSON response themselves instead of returning a result to convert
+#define CALL_WRITER(api_name, api_handle, api_namespace, call_name, writer_name, http_response_code) \
+{std::string("/v1/" #api_name "/" #call_name), \
+   [api_handle](string, string body, url_response_callback cb) mutable { \
+          api_handle.validate(); \
+          try { \
+             if (body.empty()) body = "{}"; \
+             std::ostringstream out; \
+             api_handle.writer_name(fc::json::from_string(body).as<api_namespace::call_name ## _params>(), out); \
+             cb(http_response_code, out.str()); \
+          } catch (...) { \
+             http_plugin::handle_exception(#api_name, #call_name, body, cb); \
+          } \
+       }}
+
 #define CALL_ASYNC(api_name, api_handle, api_namespace, call_name, call_result, http_response_code) \
 {std::string("/v1/" #api_name "/" #call_name), \
    [api_handle](string, string body, url_response_callback cb) mutable { \
@@ -70,6 +87,7 @@ struct async_result_visitor : public fc::visitor<std::string> {
 
 #define CHAIN_RO_CALL(call_name, http_response_code) CALL(chain, ro_api, chain_apis::read_only, call_name, http_response_code)
 #define CHAIN_RW_CALL(call_name, http_response_code) CALL(chain, rw_api, chain_apis::read_write, call_name, http_response_code)
+#define CHAIN_RO_CALL_WRITER(call_name, writer_name, http_response_code) CALL_WRITER(chain, ro_api, chain_apis::read_only, call_name, writer_name, http_response_code)
 #define CHAIN_RO_CALL_ASYNC(call_name, call_result, http_response_code) CALL_ASYNC(chain, ro_api, chain_apis::read_only, call_name, call_result, http_response_code)
 #define CHAIN_RW_CALL_ASYNC(call_name, call_result, http_response_code) CALL_ASYNC(chain, rw_api, chain_apis::read_write, call_name, call_result, http_response_code)
 // chain_api_plugin插件在启动函数中注册了以下URL回调函数，包括查询区块信息、处理交易数据：
@@ -92,7 +110,11 @@ void chain_api_plugin::plugin_startup() {
       CHAIN_RO_CALL(get_abi, 200),
       CHAIN_RO_CALL(get_raw_code_and_abi, 200),
       CHAIN_RO_CALL(get_raw_abi, 200),
-      CHAIN_RO_CALL(get_table_rows, 200),
+      CHAIN_RO_CALL(get_wasm_cache_stats, 200),
+      CHAIN_RO_CALL(get_signature_cache_stats, 200),
+      CHAIN_RO_CALL(get_authority_cache_stats, 200),
+      CHAIN_RO_CALL(get_abi_cache_stats, 200),
+      CHAIN_RO_CALL_WRITER(get_table_rows, write_table_rows, 200),
       CHAIN_RO_CALL(get_table_by_scope, 200),
       CHAIN_RO_CALL(get_currency_balance, 200),
       CHAIN_RO_CALL(get_currency_stats, 200),
@@ -100,7 +122,7 @@ void chain_api_plugin::plugin_startup() {
       CHAIN_RO_CALL(get_producer_schedule, 200),
       CHAIN_RO_CALL(get_scheduled_transactions, 200),
       CHAIN_RO_CALL(abi_json_to_bin, 200),
-      CHAIN_RO_CALL(abi_bin_to_json, 200),
+      CHAIN_RO_CALL_WRITER(abi_bin_to_json, write_abi_bin_to_json, 200),
       CHAIN_RO_CALL(get_required_keys, 200),
       CHAIN_RO_CALL(get_transaction_id, 200),
       CHAIN_RW_CALL_ASYNC(push_block, chain_apis::read_write::push_block_results, 202),
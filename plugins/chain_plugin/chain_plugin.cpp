@@ -10,6 +10,8 @@
 #include <eosio/chain/producer_object.hpp>
 #include <eosio/chain/config.hpp>
 #include <eosio/chain/wasm_interface.hpp>
+#include <eosio/chain/signature_recovery_cache.hpp>
+#include <eosio/chain/abi_serializer_cache.hpp>
 #include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/reversible_block_object.hpp>
 #include <eosio/chain/controller.hpp>
@@ -199,6 +201,8 @@ public:
    fc::optional<vm_type> wasm_runtime;
    fc::microseconds abi_serializer_max_time_ms;
    fc::optional<bfs::path> snapshot_path;
+   std::vector<fc::path> snapshot_deltas;
+   abi_serializer_cache abi_cache;
 
    // retained references to channels for easy publication
    channels::pre_accepted_block::channel_type &pre_accepted_block_channel;
@@ -228,6 +232,17 @@ public:
    fc::optional<scoped_connection> accepted_transaction_connection;
    fc::optional<scoped_connection> applied_transaction_connection;
    fc::optional<scoped_connection> accepted_confirmation_connection;
+
+   // drop the cached serializers of accounts whose ABI was replaced by setabi
+   void invalidate_abi_cache(const vector<action_trace> &traces)
+   {
+      for (const auto &at : traces)
+      {
+         if (at.receipt.receiver == config::system_account_name && at.act.account == config::system_account_name && at.act.name == N(setabi))
+            abi_cache.invalidate(at.act.data_as<setabi>().account);
+         invalidate_abi_cache(at.inline_traces);
+      }
+   }
 };
 
 chain_plugin::chain_plugin()
@@ -240,10 +255,17 @@ chain_plugin::~chain_plugin() {}
 void chain_plugin::set_program_options(options_description &cli, options_description &cfg)
 {
    cfg.add_options()("blocks-dir", bpo::value<bfs::path>()->default_value("blocks"),
-                     "the location of the blocks directory (absolute path or relative to application data dir)")("checkpoint", bpo::value<vector<string>>()->composing(), "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")("wasm-runtime", bpo::value<eosio::chain::wasm_interface::vm_type>()->value_name("wavm/wabt"), "Override default WASM runtime")("abi-serializer-max-time-ms", bpo::value<uint32_t>()->default_value(config::default_abi_serializer_max_time_ms),
+                     "the location of the blocks directory (absolute path or relative to application data dir)")("blocks-log-stride", bpo::value<uint32_t>()->default_value(0),
+         "split the block log into a new file after every block whose number is a multiple of this value (0 to keep a single file)")("max-retained-block-files", bpo::value<uint32_t>()->default_value(std::numeric_limits<uint32_t>::max()),
+         "maximum number of split block log files kept in the blocks directory, at least 1, older ones are moved to blocks-archive-dir")("blocks-archive-dir", bpo::value<bfs::path>()->default_value(""),
+         "where split block log files beyond max-retained-block-files are moved (absolute path or relative to blocks dir), empty to delete them")("checkpoint", bpo::value<vector<string>>()->composing(), "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")("wasm-runtime", bpo::value<eosio::chain::wasm_interface::vm_type>()->value_name("wavm/wabt"), "Override default WASM runtime")("abi-serializer-max-time-ms", bpo::value<uint32_t>()->default_value(config::default_abi_serializer_max_time_ms),
                                                                                                                                                                                                                                                                                                                                                                                   "Override default maximum ABI serialization time allowed in ms")("chain-state-db-size-mb", bpo::value<uint64_t>()->default_value(config::default_state_size / (1024 * 1024)), "Maximum size (in MiB) of the chain state database")("chain-state-db-guard-size-mb", bpo::value<uint64_t>()->default_value(config::default_state_guard_size / (1024 * 1024)), "Safely shut down node when free space remaining in the chain state database drops below this size (in MiB).")("reversible-blocks-db-size-mb", bpo::value<uint64_t>()->default_value(config::default_reversible_cache_size / (1024 * 1024)), "Maximum size (in MiB) of the reversible blocks database")("reversible-blocks-db-guard-size-mb", bpo::value<uint64_t>()->default_value(config::default_reversible_guard_size / (1024 * 1024)), "Safely shut down node when free space remaining in the reverseible blocks database drops below this size (in MiB).")("signature-cpu-billable-pct", bpo::value<uint32_t>()->default_value(config::default_sig_cpu_bill_pct / config::percent_1),
                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                 "Percentage of actual signature recovery cpu to bill. Whole number percentages, e.g. 50 for 50%")("chain-threads", bpo::value<uint16_t>()->default_value(config::default_controller_thread_pool_size),
-                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                  "Number of worker threads in controller thread pool")("contracts-console", bpo::bool_switch()->default_value(false),
+                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                  "Number of worker threads in controller thread pool")("wasm-cache-max-modules", bpo::value<uint32_t>()->default_value(config::default_wasm_cache_max_modules),
+         "Maximum number of instantiated contracts kept in the WASM cache, least recently used contracts are evicted first (0 for no limit)")("wasm-cache-max-size-mb", bpo::value<uint64_t>()->default_value(config::default_wasm_cache_max_size / (1024 * 1024)),
+         "Maximum size (in MiB) of instantiated contracts kept in the WASM cache, counting injected code, initial memory and generated machine code (0 for no limit)")("signature-cache-size", bpo::value<uint32_t>()->default_value(config::default_sig_cache_size),
+         "Number of recovered signature keys to keep, least recently used keys are evicted first")("abi-serializer-cache-size", bpo::value<uint32_t>()->default_value(abi_serializer_cache::default_capacity),
+         "Number of contract ABI serializers kept for the chain API, least recently used ABIs are evicted first (0 to disable)")("contracts-console", bpo::bool_switch()->default_value(false),
                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                         "print contract's output to console")("actor-whitelist", boost::program_options::value<vector<string>>()->composing()->multitoken(),
                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                               "Account added to actor whitelist (may specify multiple times)")("actor-blacklist", boost::program_options::value<vector<string>>()->composing()->multitoken(),
                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                "Account added to actor blacklist (may specify multiple times)")("contract-whitelist", boost::program_options::value<vector<string>>()->composing()->multitoken(),
@@ -261,7 +283,8 @@ void chain_plugin::set_program_options(options_description &cli, options_descrip
         "Chain validation mode (\"full\" or \"light\").\n"
         "In \"full\" mode all incoming blocks will be fully validated.\n"
         "In \"light\" mode all incoming blocks headers will be fully validated; transactions in those validated blocks will be trusted \n")("disable-ram-billing-notify-checks", bpo::bool_switch()->default_value(false),
-                                                                                                                                            "Disable the check which subjectively fails a transaction if a contract bills more RAM to another account within the context of a notification handler (i.e. when the receiver is not the code of the action).")("trusted-producer", bpo::value<vector<string>>()->composing(), "Indicate a producer whose blocks headers signed by it will be fully validated, but transactions in those validated blocks will be trusted.");
+                                                                                                                                            "Disable the check which subjectively fails a transaction if a contract bills more RAM to another account within the context of a notification handler (i.e. when the receiver is not the code of the action).")("analyze-transaction-conflicts", bpo::bool_switch()->default_value(false),
+         "Record the state read and written by each transaction and log per block how many conflict-free waves its transactions form (analysis only, execution stays serial)")("trusted-producer", bpo::value<vector<string>>()->composing(), "Indicate a producer whose blocks headers signed by it will be fully validated, but transactions in those validated blocks will be trusted.");
 
    // TODO: rate limiting
    /*("per-authorized-account-transaction-msg-rate-limit-time-frame-sec", bpo::value<uint32_t>()->default_value(default_per_auth_account_time_frame_seconds),
@@ -284,7 +307,7 @@ void chain_plugin::set_program_options(options_description &cli, options_descrip
                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                       "clear chain state database and block log")("truncate-at-block", bpo::value<uint32_t>()->default_value(0),
                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                   "stop hard replay / block log recovery at this block number (if set to non-zero number)")("import-reversible-blocks", bpo::value<bfs::path>(),
                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                             "replace reversible block database with blocks imported from specified file and then exit")("export-reversible-blocks", bpo::value<bfs::path>(),
-                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                        "export reversible block database in portable format into specified file and then exit")("snapshot", bpo::value<bfs::path>(), "File to read Snapshot State from");
+                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                        "export reversible block database in portable format into specified file and then exit")("snapshot", bpo::value<bfs::path>(), "File to read Snapshot State from")("snapshot-delta", bpo::value<vector<bfs::path>>()->composing(), "Delta snapshot to apply on top of --snapshot, may be specified multiple times to apply several deltas in order");
 }
 
 #define LOAD_VALUE_SET(options, name, container)                                          \
@@ -421,6 +444,18 @@ void chain_plugin::plugin_initialize(const variables_map &options)
          my->abi_serializer_max_time_ms = fc::microseconds(options.at("abi-serializer-max-time-ms").as<uint32_t>() * 1000);
 
       my->chain_config->blocks_dir = my->blocks_dir;
+      my->chain_config->blocks_log_stride = options.at("blocks-log-stride").as<uint32_t>();
+      my->chain_config->max_retained_block_files = options.at("max-retained-block-files").as<uint32_t>();
+      EOS_ASSERT(my->chain_config->max_retained_block_files > 0, plugin_config_exception,
+                 "max-retained-block-files must be at least 1, the newest split off file holds recent irreversible blocks peers still ask for");
+      if (options.count("blocks-archive-dir"))
+      {
+         auto bad = options.at("blocks-archive-dir").as<bfs::path>();
+         if (bad.empty() || bad.is_absolute())
+            my->chain_config->blocks_archive_dir = bad;
+         else
+            my->chain_config->blocks_archive_dir = my->blocks_dir / bad;
+      }
       my->chain_config->state_dir = app().data_dir() / config::default_state_dir_name;
       my->chain_config->read_only = my->readonly;
 
@@ -444,6 +479,11 @@ void chain_plugin::plugin_initialize(const variables_map &options)
                     "chain-threads ${num} must be greater than 0", ("num", my->chain_config->thread_pool_size));
       }
 
+      my->chain_config->wasm_cache_max_modules = options.at("wasm-cache-max-modules").as<uint32_t>();
+      my->chain_config->wasm_cache_max_size = options.at("wasm-cache-max-size-mb").as<uint64_t>() * 1024 * 1024;
+      my->chain_config->sig_cache_size = options.at("signature-cache-size").as<uint32_t>();
+      my->abi_cache.set_capacity(options.at("abi-serializer-cache-size").as<uint32_t>());
+
       my->chain_config->sig_cpu_bill_pct = options.at("signature-cpu-billable-pct").as<uint32_t>();
       EOS_ASSERT(my->chain_config->sig_cpu_bill_pct >= 0 && my->chain_config->sig_cpu_bill_pct <= 100, plugin_config_exception,
                  "signature-cpu-billable-pct must be 0 - 100, ${pct}", ("pct", my->chain_config->sig_cpu_bill_pct));
@@ -456,6 +496,7 @@ void chain_plugin::plugin_initialize(const variables_map &options)
       my->chain_config->disable_replay_opts = options.at("disable-replay-opts").as<bool>();
       my->chain_config->contracts_console = options.at("contracts-console").as<bool>();
       my->chain_config->allow_ram_billing_in_notify = options.at("disable-ram-billing-notify-checks").as<bool>();
+      my->chain_config->analyze_transaction_conflicts = options.at("analyze-transaction-conflicts").as<bool>();
 
       if (options.count("extract-genesis-json") || options.at("print-genesis-json").as<bool>())
       {
@@ -592,20 +633,30 @@ void chain_plugin::plugin_initialize(const variables_map &options)
          wlog("The --import-reversible-blocks option should be used by itself.");
       }
 
+      EOS_ASSERT(options.count("snapshot-delta") == 0 || options.count("snapshot"), plugin_config_exception,
+                 "--snapshot-delta requires the --snapshot it applies to");
+
       if (options.count("snapshot"))
       {
          my->snapshot_path = options.at("snapshot").as<bfs::path>();
          EOS_ASSERT(fc::exists(*my->snapshot_path), plugin_config_exception,
                     "Cannot load snapshot, ${name} does not exist", ("name", my->snapshot_path->generic_string()));
 
+         if (options.count("snapshot-delta"))
+         {
+            for (const auto &delta : options.at("snapshot-delta").as<vector<bfs::path>>())
+            {
+               my->snapshot_deltas.emplace_back(delta);
+            }
+         }
+
          // recover genesis information from the snapshot
-         auto infile = std::ifstream(my->snapshot_path->generic_string(), (std::ios::in | std::ios::binary));
-         auto reader = std::make_shared<istream_snapshot_reader>(infile);
+         std::vector<std::shared_ptr<std::istream>> snapshot_files;
+         auto reader = open_snapshot(*my->snapshot_path, my->snapshot_deltas, snapshot_files);
          reader->validate();
          reader->read_section<genesis_state>([this](auto &section) {
             section.read_row(my->chain_config->genesis);
          });
-         infile.close();
 
          EOS_ASSERT(options.count("genesis-json") == 0 && options.count("genesis-timestamp") == 0,
                     plugin_config_exception,
@@ -758,6 +809,8 @@ void chain_plugin::plugin_initialize(const variables_map &options)
 
       my->applied_transaction_connection = my->chain->applied_transaction.connect(
           [this](const transaction_trace_ptr &trace) {
+             if (!trace->except)
+                my->invalidate_abi_cache(trace->action_traces);
              my->applied_transaction_channel.publish(trace);
           });
 
@@ -780,11 +833,10 @@ void chain_plugin::plugin_startup()
          // 如果本地存在快照
          if (my->snapshot_path)
          {
-            auto infile = std::ifstream(my->snapshot_path->generic_string(), (std::ios::in | std::ios::binary));
-            auto reader = std::make_shared<istream_snapshot_reader>(infile);
+            std::vector<std::shared_ptr<std::istream>> snapshot_files;
+            auto reader = open_snapshot(*my->snapshot_path, my->snapshot_deltas, snapshot_files);
             // 启动链控制器(controller类)
             my->chain->startup(shutdown, reader);  
-            infile.close();
          }
          else
          {
@@ -826,8 +878,8 @@ void chain_plugin::plugin_shutdown()
    my->chain.reset();
 }
 
-chain_apis::read_write::read_write(controller &db, const fc::microseconds &abi_serializer_max_time)
-    : db(db), abi_serializer_max_time(abi_serializer_max_time)
+chain_apis::read_write::read_write(controller &db, const fc::microseconds &abi_serializer_max_time, abi_serializer_cache *abi_cache)
+    : db(db), abi_serializer_max_time(abi_serializer_max_time), abi_cache(abi_cache)
 {
 }
 
@@ -857,6 +909,24 @@ bool chain_plugin::block_is_on_preferred_chain(const block_id_type &block_id)
    return b && b->id() == block_id;
 }
 
+snapshot_reader_ptr chain_plugin::open_snapshot(const fc::path &snapshot, const std::vector<fc::path> &deltas,
+                                               std::vector<std::shared_ptr<std::istream>> &files)
+{
+   auto open = [&files](const fc::path &path) -> std::istream & {
+      EOS_ASSERT(fc::exists(path), plugin_config_exception,
+                 "Cannot load snapshot, ${name} does not exist", ("name", path.generic_string()));
+      files.emplace_back(std::make_shared<std::ifstream>(path.generic_string(), (std::ios::in | std::ios::binary)));
+      return *files.back();
+   };
+
+   snapshot_reader_ptr reader = std::make_shared<istream_snapshot_reader>(open(snapshot));
+   for (const auto &delta : deltas)
+   {
+      reader = std::make_shared<delta_snapshot_reader>(reader, open(delta));
+   }
+   return reader;
+}
+
 bool chain_plugin::recover_reversible_blocks(const fc::path &db_dir, uint32_t cache_size,
                                              optional<fc::path> new_db_dir, uint32_t truncate_at_block)
 {
@@ -1108,6 +1178,11 @@ fc::microseconds chain_plugin::get_abi_serializer_max_time() const
    return my->abi_serializer_max_time_ms;
 }
 
+abi_serializer_cache &chain_plugin::get_abi_serializer_cache() const
+{
+   return my->abi_cache;
+}
+
 void chain_plugin::log_guard_exception(const chain::guard_exception &e) const
 {
    if (e.code() == chain::database_guard_exception::code_value)
@@ -1334,10 +1409,21 @@ string get_table_type(const abi_def &abi, const name &table_name)
    EOS_ASSERT(false, chain::contract_table_query_exception, "Table ${table} is not specified in the ABI", ("table", table_name));
 }
 
-read_only::get_table_rows_result read_only::get_table_rows(const read_only::get_table_rows_params &p) const
+static abi_serializer_cache::entry_ptr get_abi_entry(abi_serializer_cache *cache, const database &d, const name &account, const fc::microseconds &max_serialization_time)
 {
-   const abi_def abi = eosio::chain_apis::get_abi(db, p.code);
+   if (cache)
+      return cache->get(d, account, max_serialization_time);
+   return abi_serializer_cache::make_entry(d, account, max_serialization_time);
+}
 
+abi_serializer_cache::entry_ptr read_only::get_abi_entry(const name &account) const
+{
+   return eosio::chain_apis::get_abi_entry(abi_cache, db.db(), account, abi_serializer_max_time);
+}
+
+template <typename RowFn>
+bool read_only::walk_table_rows(const read_only::get_table_rows_params &p, const abi_def &abi, RowFn &&row) const
+{
    bool primary = false;
    auto table_with_index = get_table_index_name(p, primary);
    if (primary)
@@ -1346,7 +1432,7 @@ read_only::get_table_rows_result read_only::get_table_rows(const read_only::get_
       auto table_type = get_table_type(abi, p.table);
       if (table_type == KEYi64 || p.key_type == "i64" || p.key_type == "name")
       {
-         return get_table_rows_ex<key_value_index>(p, abi);
+         return walk_table_rows_ex<key_value_index>(p, row);
       }
       EOS_ASSERT(false, chain::contract_table_query_exception, "Invalid table type ${type}", ("type", table_type)("abi", abi));
    }
@@ -1356,56 +1442,121 @@ read_only::get_table_rows_result read_only::get_table_rows(const read_only::get_
 
       if (p.key_type == chain_apis::i64 || p.key_type == "name")
       {
-         return get_table_rows_by_seckey<index64_index, uint64_t>(p, abi, [](uint64_t v) -> uint64_t {
+         return walk_table_rows_by_seckey<index64_index, uint64_t>(p, [](uint64_t v) -> uint64_t {
             return v;
-         });
+         }, row);
       }
       else if (p.key_type == chain_apis::i128)
       {
-         return get_table_rows_by_seckey<index128_index, uint128_t>(p, abi, [](uint128_t v) -> uint128_t {
+         return walk_table_rows_by_seckey<index128_index, uint128_t>(p, [](uint128_t v) -> uint128_t {
             return v;
-         });
+         }, row);
       }
       else if (p.key_type == chain_apis::i256)
       {
          if (p.encode_type == chain_apis::hex)
          {
             using conv = keytype_converter<chain_apis::sha256, chain_apis::hex>;
-            return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abi, conv::function());
+            return walk_table_rows_by_seckey<conv::index_type, conv::input_type>(p, conv::function(), row);
          }
          using conv = keytype_converter<chain_apis::i256>;
-         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abi, conv::function());
+         return walk_table_rows_by_seckey<conv::index_type, conv::input_type>(p, conv::function(), row);
       }
       else if (p.key_type == chain_apis::float64)
       {
-         return get_table_rows_by_seckey<index_double_index, double>(p, abi, [](double v) -> float64_t {
+         return walk_table_rows_by_seckey<index_double_index, double>(p, [](double v) -> float64_t {
             float64_t f = *(float64_t *)&v;
             return f;
-         });
+         }, row);
       }
       else if (p.key_type == chain_apis::float128)
       {
-         return get_table_rows_by_seckey<index_long_double_index, double>(p, abi, [](double v) -> float128_t {
+         return walk_table_rows_by_seckey<index_long_double_index, double>(p, [](double v) -> float128_t {
             float64_t f = *(float64_t *)&v;
             float128_t f128;
             f64_to_f128M(f, &f128);
             return f128;
-         });
+         }, row);
       }
       else if (p.key_type == chain_apis::sha256)
       {
          using conv = keytype_converter<chain_apis::sha256, chain_apis::hex>;
-         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abi, conv::function());
+         return walk_table_rows_by_seckey<conv::index_type, conv::input_type>(p, conv::function(), row);
       }
       else if (p.key_type == chain_apis::ripemd160)
       {
          using conv = keytype_converter<chain_apis::ripemd160, chain_apis::hex>;
-         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abi, conv::function());
+         return walk_table_rows_by_seckey<conv::index_type, conv::input_type>(p, conv::function(), row);
       }
       EOS_ASSERT(false, chain::contract_table_query_exception, "Unsupported secondary index type: ${t}", ("t", p.key_type));
    }
 }
 
+// the account must exist, a missing ABI has no tables
+static abi_serializer_cache::entry_ptr get_table_abi(const read_only &api, const database &d, const read_only::get_table_rows_params &p)
+{
+   EOS_ASSERT(d.find<account_object, by_name>(p.code) != nullptr, chain::account_query_exception, "Fail to retrieve account for ${account}", ("account", p.code));
+   auto cached = api.get_abi_entry(p.code);
+   EOS_ASSERT(cached, chain::contract_table_query_exception, "Table ${table} is not specified in the ABI", ("table", p.table));
+   return cached;
+}
+
+read_only::get_table_rows_result read_only::get_table_rows(const read_only::get_table_rows_params &p) const
+{
+   const auto cached = get_table_abi(*this, db.db(), p);
+   const abi_serializer &abis = cached->serializer;
+   const auto table_type = abis.get_table_type(p.table);
+
+   read_only::get_table_rows_result result;
+   result.more = walk_table_rows(p, cached->abi, [&](const vector<char> &data, const name &payer) {
+      fc::variant data_var;
+      if (p.json)
+      {
+         data_var = abis.binary_to_variant(table_type, data, abi_serializer_max_time, shorten_abi_errors);
+      }
+      else
+      {
+         data_var = fc::variant(data);
+      }
+
+      if (p.show_payer && *p.show_payer)
+      {
+         result.rows.emplace_back(fc::mutable_variant_object("data", std::move(data_var))("payer", payer));
+      }
+      else
+      {
+         result.rows.emplace_back(std::move(data_var));
+      }
+   });
+   return result;
+}
+
+void read_only::write_table_rows(const read_only::get_table_rows_params &p, std::ostream &out) const
+{
+   const auto cached = get_table_abi(*this, db.db(), p);
+   const abi_serializer &abis = cached->serializer;
+   const auto table_type = abis.get_table_type(p.table);
+   const bool show_payer = p.show_payer && *p.show_payer;
+
+   // the layout fc::json gives get_table_rows_result
+   out << "{\"rows\":[";
+   bool first_row = true;
+   const bool more = walk_table_rows(p, cached->abi, [&](const vector<char> &data, const name &payer) {
+      if (!first_row)
+         out << ',';
+      first_row = false;
+      if (show_payer)
+         out << "{\"data\":";
+      if (p.json)
+         abis.binary_to_json(table_type, data, out, abi_serializer_max_time, shorten_abi_errors);
+      else
+         fc::json::to_stream(out, fc::variant(data), fc::json::stringify_large_ints_and_doubles);
+      if (show_payer)
+         out << ",\"payer\":\"" << payer.to_string() << "\"}";
+   });
+   out << "],\"more\":" << (more ? "true" : "false") << '}';
+}
+
 read_only::get_table_by_scope_result read_only::get_table_by_scope(const read_only::get_table_by_scope_params &p) const
 {
    read_only::get_table_by_scope_result result;
@@ -1543,9 +1694,11 @@ fc::variant get_global_row(const database &db, const abi_def &abi, const abi_ser
 
 read_only::get_producers_result read_only::get_producers(const read_only::get_producers_params &p) const
 {
-   const abi_def abi = eosio::chain_apis::get_abi(db, config::system_account_name);
+   const auto cached = get_abi_entry(config::system_account_name);
+   EOS_ASSERT(cached, chain::contract_table_query_exception, "Table ${table} is not specified in the ABI", ("table", N(producers)));
+   const abi_def &abi = cached->abi;
    const auto table_type = get_table_type(abi, N(producers));
-   const abi_serializer abis{abi, abi_serializer_max_time};
+   const abi_serializer &abis = cached->serializer;
    EOS_ASSERT(table_type == KEYi64, chain::contract_table_query_exception, "Invalid table type ${type} for table producers", ("type", table_type));
 
    const auto &d = db.db();
@@ -1612,18 +1765,14 @@ struct resolver_factory
 {
    static auto make(const Api *api, const fc::microseconds &max_serialization_time)
    {
-      return [api, max_serialization_time](const account_name &name) -> optional<abi_serializer> {
-         const auto *accnt = api->db.db().template find<account_object, by_name>(name);
-         if (accnt != nullptr)
+      return [api, max_serialization_time](const account_name &name) -> std::shared_ptr<const abi_serializer> {
+         const auto cached = get_abi_entry(api->abi_cache, api->db.db(), name, max_serialization_time);
+         if (cached)
          {
-            abi_def abi;
-            if (abi_serializer::to_abi(accnt->abi, abi))
-            {
-               return abi_serializer(abi, max_serialization_time);
-            }
+            return std::shared_ptr<const abi_serializer>(cached, &cached->serializer);
          }
 
-         return optional<abi_serializer>();
+         return std::shared_ptr<const abi_serializer>();
       };
    }
 };
@@ -1932,6 +2081,26 @@ read_only::get_code_hash_results read_only::get_code_hash(const get_code_hash_pa
    return result;
 }
 
+read_only::get_wasm_cache_stats_results read_only::get_wasm_cache_stats(const get_wasm_cache_stats_params &) const
+{
+   return db.get_wasm_interface().get_cache_stats();
+}
+
+read_only::get_signature_cache_stats_results read_only::get_signature_cache_stats(const get_signature_cache_stats_params &) const
+{
+   return signature_recovery_cache::instance().get_stats();
+}
+
+read_only::get_authority_cache_stats_results read_only::get_authority_cache_stats(const get_authority_cache_stats_params &) const
+{
+   return db.get_authorization_manager().get_authority_cache_stats();
+}
+
+read_only::get_abi_cache_stats_results read_only::get_abi_cache_stats(const get_abi_cache_stats_params &) const
+{
+   return abi_cache ? abi_cache->get_stats() : get_abi_cache_stats_results();
+}
+
 read_only::get_raw_code_and_abi_results read_only::get_raw_code_and_abi(const get_raw_code_and_abi_params &params) const
 {
    get_raw_code_and_abi_results result;
@@ -2006,12 +2175,10 @@ read_only::get_account_results read_only::get_account(const get_account_params &
       ++perm;
    }
 
-   const auto &code_account = db.db().get<account_object, by_name>(config::system_account_name);
-
-   abi_def abi;
-   if (abi_serializer::to_abi(code_account.abi, abi))
+   const auto cached = get_abi_entry(config::system_account_name);
+   if (cached)
    {
-      abi_serializer abis(abi, abi_serializer_max_time);
+      const abi_serializer &abis = cached->serializer;
 
       const auto token_code = N(eosio.token);
 
@@ -2108,10 +2275,11 @@ read_only::abi_json_to_bin_result read_only::abi_json_to_bin(const read_only::ab
    const auto code_account = db.db().find<account_object, by_name>(params.code);
    EOS_ASSERT(code_account != nullptr, contract_query_exception, "Contract can't be found ${contract}", ("contract", params.code));
 
-   abi_def abi;
-   if (abi_serializer::to_abi(code_account->abi, abi))
+   const auto cached = get_abi_entry(params.code);
+   if (cached)
    {
-      abi_serializer abis(abi, abi_serializer_max_time);
+      const abi_def &abi = cached->abi;
+      const abi_serializer &abis = cached->serializer;
       auto action_type = abis.get_action_type(params.action);
       EOS_ASSERT(!action_type.empty(), action_validate_exception, "Unknown action ${action} in contract ${contract}", ("action", params.action)("contract", params.code));
       try
@@ -2134,11 +2302,11 @@ FC_RETHROW_EXCEPTIONS(warn, "code: ${code}, action: ${action}, args: ${args}",
 read_only::abi_bin_to_json_result read_only::abi_bin_to_json(const read_only::abi_bin_to_json_params &params) const
 {
    abi_bin_to_json_result result;
-   const auto &code_account = db.db().get<account_object, by_name>(params.code);
-   abi_def abi;
-   if (abi_serializer::to_abi(code_account.abi, abi))
+   db.db().get<account_object, by_name>(params.code);
+   const auto cached = get_abi_entry(params.code);
+   if (cached)
    {
-      abi_serializer abis(abi, abi_serializer_max_time);
+      const abi_serializer &abis = cached->serializer;
       result.args = abis.binary_to_variant(abis.get_action_type(params.action), params.binargs, abi_serializer_max_time, shorten_abi_errors);
    }
    else
@@ -2148,6 +2316,18 @@ read_only::abi_bin_to_json_result read_only::abi_bin_to_json(const read_only::ab
    return result;
 }
 
+void read_only::write_abi_bin_to_json(const read_only::abi_bin_to_json_params &params, std::ostream &out) const
+{
+   db.db().get<account_object, by_name>(params.code);
+   const auto cached = get_abi_entry(params.code);
+   EOS_ASSERT(cached, abi_not_found_exception, "No ABI found for ${contract}", ("contract", params.code));
+   const abi_serializer &abis = cached->serializer;
+   // the layout fc::json gives abi_bin_to_json_result
+   out << "{\"args\":";
+   abis.binary_to_json(abis.get_action_type(params.action), params.binargs, out, abi_serializer_max_time, shorten_abi_errors);
+   out << '}';
+}
+
 read_only::get_required_keys_result read_only::get_required_keys(const get_required_keys_params &params) const
 {
    transaction pretty_input;
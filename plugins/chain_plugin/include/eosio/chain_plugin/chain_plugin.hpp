@@ -12,7 +12,10 @@
 #include <eosio/chain/contract_table_objects.hpp>
 #include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/transaction.hpp>
+#include <eosio/chain/signature_recovery_cache.hpp>
+#include <eosio/chain/authorization_manager.hpp>
 #include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/abi_serializer_cache.hpp>
 #include <eosio/chain/plugin_interface.hpp>
 #include <eosio/chain/types.hpp>
 
@@ -42,6 +45,7 @@ namespace eosio {
    using chain::action_name;
    using chain::abi_def;
    using chain::abi_serializer;
+   using chain::abi_serializer_cache;
 
 namespace chain_apis {
 struct empty{};
@@ -72,13 +76,14 @@ double convert_to_type(const string& str, const string& desc);
 class read_only {
    const controller& db;
    const fc::microseconds abi_serializer_max_time;
+   abi_serializer_cache* abi_cache = nullptr;
    bool  shorten_abi_errors = true;
 
 public:
    static const string KEYi64;
 
-   read_only(const controller& db, const fc::microseconds& abi_serializer_max_time)
-      : db(db), abi_serializer_max_time(abi_serializer_max_time) {}
+   read_only(const controller& db, const fc::microseconds& abi_serializer_max_time, abi_serializer_cache* abi_cache = nullptr)
+      : db(db), abi_serializer_max_time(abi_serializer_max_time), abi_cache(abi_cache) {}
 
    void validate() const {}
 
@@ -207,6 +212,22 @@ public:
    get_raw_code_and_abi_results get_raw_code_and_abi( const get_raw_code_and_abi_params& params)const;
    get_raw_abi_results get_raw_abi( const get_raw_abi_params& params)const;
 
+   using get_wasm_cache_stats_params = empty;
+   using get_wasm_cache_stats_results = wasm_interface::cache_stats;
+   get_wasm_cache_stats_results get_wasm_cache_stats( const get_wasm_cache_stats_params& )const;
+
+   using get_signature_cache_stats_params = empty;
+   using get_signature_cache_stats_results = signature_recovery_cache::cache_stats;
+   get_signature_cache_stats_results get_signature_cache_stats( const get_signature_cache_stats_params& )const;
+
+   using get_authority_cache_stats_params = empty;
+   using get_authority_cache_stats_results = authorization_manager::authority_cache_stats;
+   get_authority_cache_stats_results get_authority_cache_stats( const get_authority_cache_stats_params& )const;
+
+   using get_abi_cache_stats_params = empty;
+   using get_abi_cache_stats_results = abi_serializer_cache::cache_stats;
+   get_abi_cache_stats_results get_abi_cache_stats( const get_abi_cache_stats_params& )const;
+
 
 
    struct abi_json_to_bin_params {
@@ -231,6 +252,8 @@ public:
    };
 
    abi_bin_to_json_result abi_bin_to_json( const abi_bin_to_json_params& params )const;
+   /// writes the JSON of abi_bin_to_json without building its args as a variant first
+   void write_abi_bin_to_json( const abi_bin_to_json_params& params, std::ostream& out )const;
 
 
    struct get_required_keys_params {
@@ -282,6 +305,8 @@ public:
    };
 
    get_table_rows_result get_table_rows( const get_table_rows_params& params )const;
+   /// writes the JSON of get_table_rows without building its rows as variants first
+   void write_table_rows( const get_table_rows_params& params, std::ostream& out )const;
 
    struct get_table_by_scope_params {
       name        code; // mandatory
@@ -391,15 +416,14 @@ public:
 
    static uint64_t get_table_index_name(const read_only::get_table_rows_params& p, bool& primary);
 
-   template <typename IndexType, typename SecKeyType, typename ConvFn>
-   read_only::get_table_rows_result get_table_rows_by_seckey( const read_only::get_table_rows_params& p, const abi_def& abi, ConvFn conv )const {
-      read_only::get_table_rows_result result;
+   /// calls row( data, payer ) for each row selected by p, returns whether more rows follow
+   template <typename IndexType, typename SecKeyType, typename ConvFn, typename RowFn>
+   bool walk_table_rows_by_seckey( const read_only::get_table_rows_params& p, ConvFn conv, RowFn&& row )const {
+      bool more = false;
       const auto& d = db.db();
 
       uint64_t scope = convert_to_type<uint64_t>(p.scope, "scope");
 
-      abi_serializer abis;
-      abis.set_abi(abi, abi_serializer_max_time);
       bool primary = false;
       const uint64_t table_with_index = get_table_index_name(p, primary);
       const auto* t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple(p.code, scope, p.table));
@@ -439,7 +463,7 @@ public:
          }
 
          if( upper_bound_lookup_tuple < lower_bound_lookup_tuple )
-            return result;
+            return more;
 
          auto walk_table_row_range = [&]( auto itr, auto end_itr ) {
             auto cur_time = fc::time_point::now();
@@ -449,24 +473,11 @@ public:
                const auto* itr2 = d.find<chain::key_value_object, chain::by_scope_primary>( boost::make_tuple(t_id->id, itr->primary_key) );
                if( itr2 == nullptr ) continue;
                copy_inline_row(*itr2, data);
-
-               fc::variant data_var;
-               if( p.json ) {
-                  data_var = abis.binary_to_variant( abis.get_table_type(p.table), data, abi_serializer_max_time, shorten_abi_errors );
-               } else {
-                  data_var = fc::variant( data );
-               }
-
-               if( p.show_payer && *p.show_payer ) {
-                  result.rows.emplace_back( fc::mutable_variant_object("data", std::move(data_var))("payer", itr->payer) );
-               } else {
-                  result.rows.emplace_back( std::move(data_var) );
-               }
-
+               row( data, itr->payer );
                ++count;
             }
             if( itr != end_itr ) {
-               result.more = true;
+               more = true;
             }
          };
 
@@ -478,18 +489,17 @@ public:
             walk_table_row_range( lower, upper );
          }
       }
-      return result;
+      return more;
    }
 
-   template <typename IndexType>
-   read_only::get_table_rows_result get_table_rows_ex( const read_only::get_table_rows_params& p, const abi_def& abi )const {
-      read_only::get_table_rows_result result;
+   /// calls row( data, payer ) for each row selected by p, returns whether more rows follow
+   template <typename IndexType, typename RowFn>
+   bool walk_table_rows_ex( const read_only::get_table_rows_params& p, RowFn&& row )const {
+      bool more = false;
       const auto& d = db.db();
 
       uint64_t scope = convert_to_type<uint64_t>(p.scope, "scope");
 
-      abi_serializer abis;
-      abis.set_abi(abi, abi_serializer_max_time);
       const auto* t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple(p.code, scope, p.table));
       if( t_id != nullptr ) {
          const auto& idx = d.get_index<IndexType, chain::by_scope_primary>();
@@ -517,7 +527,7 @@ public:
          }
 
          if( upper_bound_lookup_tuple < lower_bound_lookup_tuple  )
-            return result;
+            return more;
 
          auto walk_table_row_range = [&]( auto itr, auto end_itr ) {
             auto cur_time = fc::time_point::now();
@@ -525,22 +535,10 @@ public:
             vector<char> data;
             for( unsigned int count = 0; cur_time <= end_time && count < p.limit && itr != end_itr; ++count, ++itr, cur_time = fc::time_point::now() ) {
                copy_inline_row(*itr, data);
-
-               fc::variant data_var;
-               if( p.json ) {
-                  data_var = abis.binary_to_variant( abis.get_table_type(p.table), data, abi_serializer_max_time, shorten_abi_errors );
-               } else {
-                  data_var = fc::variant( data );
-               }
-
-               if( p.show_payer && *p.show_payer ) {
-                  result.rows.emplace_back( fc::mutable_variant_object("data", std::move(data_var))("payer", itr->payer) );
-               } else {
-                  result.rows.emplace_back( std::move(data_var) );
-               }
+               row( data, itr->payer );
             }
             if( itr != end_itr ) {
-               result.more = true;
+               more = true;
             }
          };
 
@@ -552,19 +550,27 @@ public:
             walk_table_row_range( lower, upper );
          }
       }
-      return result;
+      return more;
    }
 
+   /// dispatches p to the walker of its index, see walk_table_rows_ex
+   template <typename RowFn>
+   bool walk_table_rows( const read_only::get_table_rows_params& p, const abi_def& abi, RowFn&& row )const;
+
    chain::symbol extract_core_symbol()const;
 
+   /// the ABI of account with a ready serializer, nullptr if the account has none
+   abi_serializer_cache::entry_ptr get_abi_entry( const name& account )const;
+
    friend struct resolver_factory<read_only>;
 };
 
 class read_write {
    controller& db;
    const fc::microseconds abi_serializer_max_time;
+   abi_serializer_cache* abi_cache = nullptr;
 public:
-   read_write(controller& db, const fc::microseconds& abi_serializer_max_time);
+   read_write(controller& db, const fc::microseconds& abi_serializer_max_time, abi_serializer_cache* abi_cache = nullptr);
    void validate() const;
 
    using push_block_params = chain::signed_block;
@@ -659,8 +665,8 @@ public:
    void plugin_startup();
    void plugin_shutdown();
 
-   chain_apis::read_only get_read_only_api() const { return chain_apis::read_only(chain(), get_abi_serializer_max_time()); }
-   chain_apis::read_write get_read_write_api() { return chain_apis::read_write(chain(), get_abi_serializer_max_time()); }
+   chain_apis::read_only get_read_only_api() const { return chain_apis::read_only(chain(), get_abi_serializer_max_time(), &get_abi_serializer_cache()); }
+   chain_apis::read_write get_read_write_api() { return chain_apis::read_write(chain(), get_abi_serializer_max_time(), &get_abi_serializer_cache()); }
 
    void accept_block( const chain::signed_block_ptr& block );
    void accept_transaction(const chain::packed_transaction& trx, chain::plugin_interface::next_function<chain::transaction_trace_ptr> next);
@@ -668,6 +674,12 @@ public:
 
    bool block_is_on_preferred_chain(const chain::block_id_type& block_id);
 
+   /// reads the snapshot with the delta snapshots applied on top of it in order, files keeps the opened files
+   static chain::snapshot_reader_ptr open_snapshot( const fc::path& snapshot,
+                                                    const std::vector<fc::path>& deltas,
+                                                    std::vector<std::shared_ptr<std::istream>>& files
+                                                  );
+
    static bool recover_reversible_blocks( const fc::path& db_dir,
                                           uint32_t cache_size,
                                           optional<fc::path> new_db_dir = optional<fc::path>(),
@@ -690,6 +702,8 @@ public:
 
    chain::chain_id_type get_chain_id() const;
    fc::microseconds get_abi_serializer_max_time() const;
+   /// serializers of contract ABIs shared by all read and write API requests
+   chain::abi_serializer_cache& get_abi_serializer_cache() const;
 
    void handle_guard_exception(const chain::guard_exception& e) const;
 
@@ -87,9 +87,15 @@ void producer_api_plugin::plugin_startup() {
        CALL(producer, producer, set_whitelist_blacklist, 
             INVOKE_V_R(producer, set_whitelist_blacklist, producer_plugin::whitelist_blacklist), 201),   
        CALL(producer, producer, get_integrity_hash,
-            INVOKE_R_V(producer, get_integrity_hash), 201),
+            INVOKE_R_R(producer, get_integrity_hash, producer_plugin::integrity_hash_params), 201),
        CALL(producer, producer, create_snapshot,
             INVOKE_R_V(producer, create_snapshot), 201),
+       CALL(producer, producer, create_snapshot_deferred_write,
+            INVOKE_R_V(producer, create_snapshot_deferred_write), 201),
+       CALL(producer, producer, get_snapshot_status,
+            INVOKE_R_V(producer, get_snapshot_status), 201),
+       CALL(producer, producer, create_snapshot_delta,
+            INVOKE_R_R(producer, create_snapshot_delta, producer_plugin::snapshot_delta_params), 201),
    });
 }
 
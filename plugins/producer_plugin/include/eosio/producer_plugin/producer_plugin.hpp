@@ -41,9 +41,14 @@ public:
       std::vector<account_name> accounts;
    };
 
+   struct integrity_hash_params {
+      uint32_t version = 1;  ///< 1 hashes the whole state serially, 2 hashes its sections concurrently into a merkle root
+   };
+
    struct integrity_hash_information {
       chain::block_id_type head_block_id;
       chain::digest_type   integrity_hash;
+      uint32_t             version = 1;
    };
 
    struct snapshot_information {
@@ -51,6 +56,19 @@ public:
       std::string          snapshot_name;
    };
 
+   struct snapshot_status {
+      chain::block_id_type head_block_id;
+      std::string          snapshot_name;
+      std::string          state;   ///< "writing", "complete" or "failed"
+      std::string          error;
+      int64_t              capture_us = 0; ///< how long capturing the state held up the main thread
+   };
+
+   struct snapshot_delta_params {
+      std::string              base;    ///< file name of the full snapshot the delta is taken against, in the snapshots dir
+      std::vector<std::string> deltas;  ///< file names of the deltas already applied on top of base, in order
+   };
+
    producer_plugin();
    virtual ~producer_plugin();
 
@@ -79,8 +97,23 @@ public:
    whitelist_blacklist get_whitelist_blacklist() const;
    void set_whitelist_blacklist(const whitelist_blacklist& params);
 
-   integrity_hash_information get_integrity_hash() const;
+   integrity_hash_information get_integrity_hash(const integrity_hash_params& params = integrity_hash_params()) const;
    snapshot_information create_snapshot() const;
+   /**
+    *  Captures the state at the head block into memory on the main thread, then writes it to a file in the background.
+    *  The chain does not advance while the state is walked, it stalls about as long as for create_snapshot minus the
+    *  disk write; get_snapshot_status reports that stall as capture_us. Fails with snapshot_in_progress_exception
+    *  while a previous snapshot is still being written.
+    */
+   snapshot_information create_snapshot_deferred_write() const;
+   /// outcome of the most recent create_snapshot_deferred_write and create_snapshot_delta calls, oldest first
+   std::vector<snapshot_status> get_snapshot_status() const;
+   /**
+    *  Captures the state like create_snapshot_deferred_write, then writes it in the background as a delta against
+    *  base and deltas, which are read and diffed there; get_snapshot_status reports its outcome. Creating a delta
+    *  takes as long as creating a full snapshot, only the file written is smaller.
+    */
+   snapshot_information create_snapshot_delta(const snapshot_delta_params& params) const;
 
    signal<void(const chain::producer_confirmation&)> confirmed_block;
 private:
@@ -92,6 +125,9 @@ private:
 FC_REFLECT(eosio::producer_plugin::runtime_options, (max_transaction_time)(max_irreversible_block_age)(produce_time_offset_us)(last_block_time_offset_us)(subjective_cpu_leeway_us)(incoming_defer_ratio));
 FC_REFLECT(eosio::producer_plugin::greylist_params, (accounts));
 FC_REFLECT(eosio::producer_plugin::whitelist_blacklist, (actor_whitelist)(actor_blacklist)(contract_whitelist)(contract_blacklist)(action_blacklist)(key_blacklist) )
-FC_REFLECT(eosio::producer_plugin::integrity_hash_information, (head_block_id)(integrity_hash))
+FC_REFLECT(eosio::producer_plugin::integrity_hash_params, (version))
+FC_REFLECT(eosio::producer_plugin::integrity_hash_information, (head_block_id)(integrity_hash)(version))
 FC_REFLECT(eosio::producer_plugin::snapshot_information, (head_block_id)(snapshot_name))
+FC_REFLECT(eosio::producer_plugin::snapshot_status, (head_block_id)(snapshot_name)(state)(error)(capture_us))
+FC_REFLECT(eosio::producer_plugin::snapshot_delta_params, (base)(deltas))
 
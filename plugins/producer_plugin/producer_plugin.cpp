@@ -18,6 +18,8 @@
 
 #include <iostream>
 #include <algorithm>
+#include <functional>
+#include <mutex>
 #include <boost/algorithm/string.hpp>
 #include <boost/range/adaptor/map.hpp>
 #include <boost/function_output_iterator.hpp>
@@ -194,6 +196,108 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
    // path to write the snapshots to
    bfs::path _snapshots_dir;
 
+   // snapshots captured by create_snapshot_deferred_write and create_snapshot_delta are written out by a thread of their own, one at a time
+   fc::optional<boost::asio::thread_pool> _snapshot_thread_pool;
+   std::mutex _snapshot_status_mutex;
+   std::vector<producer_plugin::snapshot_status> _snapshot_status; ///< oldest first
+   static const size_t max_snapshot_status = 32;                 ///< finished entries beyond this are forgotten
+
+   bool writing_snapshot()
+   {
+      std::lock_guard<std::mutex> g(_snapshot_status_mutex);
+      return std::any_of(_snapshot_status.begin(), _snapshot_status.end(), [](const auto &s) {
+         return s.state == "writing";
+      });
+   }
+
+   void add_snapshot_status(producer_plugin::snapshot_status status)
+   {
+      std::lock_guard<std::mutex> g(_snapshot_status_mutex);
+      _snapshot_status.push_back(std::move(status));
+      for (auto itr = _snapshot_status.begin(); _snapshot_status.size() > max_snapshot_status && itr != _snapshot_status.end();)
+      {
+         if (itr->state != "writing")
+            itr = _snapshot_status.erase(itr);
+         else
+            ++itr;
+      }
+   }
+
+   std::string snapshot_path(const chain::block_id_type &head_id, const std::string &extension = "bin")
+   {
+      auto path = (_snapshots_dir / fc::format_string("snapshot-${id}.${ext}", fc::mutable_variant_object()("id", head_id)("ext", extension))).generic_string();
+
+      bool writing = false;
+      {
+         std::lock_guard<std::mutex> g(_snapshot_status_mutex);
+         writing = std::any_of(_snapshot_status.begin(), _snapshot_status.end(), [&path](const auto &s) {
+            return s.snapshot_name == path && s.state == "writing";
+         });
+      }
+
+      EOS_ASSERT(!writing && !fc::is_regular_file(path), snapshot_exists_exception,
+                 "snapshot named ${name} already exists", ("name", path));
+      return path;
+   }
+
+   static void log_snapshot_sections(const ostream_snapshot_writer &writer)
+   {
+      for (const auto &section : writer.section_stats())
+      {
+         ilog("snapshot section ${name}: ${rows} rows, ${size} bytes, serialized in ${ms} ms",
+              ("name", section.name)("rows", section.rows)("size", section.size)("ms", section.elapsed.count() / 1000));
+      }
+   }
+
+   /**
+    *  Writes a captured snapshot to path with write, through a temporary file so that a snapshot under the final name
+    *  is always complete, and records the outcome for get_snapshot_status
+    */
+   void write_captured_snapshot(const std::string &path, const std::function<void(std::ostream &)> &write)
+   {
+      const std::string pending_path = path + ".pending";
+      std::string error;
+      try
+      {
+         {
+            std::ofstream snap_out;
+            snap_out.exceptions(std::ios::failbit | std::ios::badbit);
+            snap_out.open(pending_path, (std::ios::out | std::ios::binary));
+            write(snap_out);
+            snap_out.flush();
+            snap_out.close();
+         }
+         bfs::rename(pending_path, path);
+         ilog("snapshot ${name} written", ("name", path));
+      }
+      catch (const fc::exception &e)
+      {
+         error = e.to_detail_string();
+      }
+      catch (const std::exception &e)
+      {
+         error = e.what();
+      }
+
+      if (!error.empty())
+      {
+         elog("failed to write snapshot ${name}: ${e}", ("name", path)("e", error));
+         boost::system::error_code ec;
+         bfs::remove(pending_path, ec);
+      }
+
+      std::lock_guard<std::mutex> g(_snapshot_status_mutex);
+      for (auto &s : _snapshot_status)
+      {
+         if (s.snapshot_name == path && s.state == "writing")
+         {
+            s.state = error.empty() ? "complete" : "failed";
+            s.error = std::move(error);
+            break;
+         }
+      }
+   }
+
    // 收到一个新的区块之后开始检验，没看到对交易合法性的验证？
    void on_block(const block_state_ptr &bsp)
    {
@@ -816,6 +920,7 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
       EOS_ASSERT(thread_pool_size > 0, plugin_config_exception,
                  "producer-threads ${num} must be greater than 0", ("num", thread_pool_size));
       my->_thread_pool.emplace(thread_pool_size);
+      my->_snapshot_thread_pool.emplace(1);
 
       if (options.count("snapshots-dir"))
       {
@@ -952,6 +1057,12 @@ void producer_plugin::plugin_shutdown()
       my->_thread_pool->join();
       my->_thread_pool->stop();
    }
+   // let snapshots being written finish rather than leave them behind half written
+   if (my->_snapshot_thread_pool)
+   {
+      my->_snapshot_thread_pool->join();
+      my->_snapshot_thread_pool->stop();
+   }
    my->_accepted_block_connection.reset();
    my->_irreversible_block_connection.reset();
 }
@@ -1099,7 +1210,7 @@ void producer_plugin::set_whitelist_blacklist(const producer_plugin::whitelist_b
       chain.set_key_blacklist(*params.key_blacklist);
 }
 
-producer_plugin::integrity_hash_information producer_plugin::get_integrity_hash() const
+producer_plugin::integrity_hash_information producer_plugin::get_integrity_hash(const integrity_hash_params &params) const
 {
    chain::controller &chain = my->chain_plug->chain();
 
@@ -1117,7 +1228,7 @@ producer_plugin::integrity_hash_information producer_plugin::get_integrity_hash(
       reschedule.cancel();
    }
 
-   return {chain.head_block_id(), chain.calculate_integrity_hash()};
+   return {chain.head_block_id(), chain.calculate_integrity_hash(params.version), params.version};
 }
 
 producer_plugin::snapshot_information producer_plugin::create_snapshot() const
@@ -1139,10 +1250,7 @@ producer_plugin::snapshot_information producer_plugin::create_snapshot() const
    }
 
    auto head_id = chain.head_block_id();
-   std::string snapshot_path = (my->_snapshots_dir / fc::format_string("snapshot-${id}.bin", fc::mutable_variant_object()("id", head_id))).generic_string();
-
-   EOS_ASSERT(!fc::is_regular_file(snapshot_path), snapshot_exists_exception,
-              "snapshot named ${name} already exists", ("name", snapshot_path));
+   std::string snapshot_path = my->snapshot_path(head_id);
 
    auto snap_out = std::ofstream(snapshot_path, (std::ios::out | std::ios::binary));
    auto writer = std::make_shared<ostream_snapshot_writer>(snap_out);
@@ -1151,6 +1259,132 @@ producer_plugin::snapshot_information producer_plugin::create_snapshot() const
    snap_out.flush();
    snap_out.close();
 
+   my->log_snapshot_sections(*writer);
+
+   return {head_id, snapshot_path};
+}
+
+producer_plugin::snapshot_information producer_plugin::create_snapshot_deferred_write() const
+{
+   chain::controller &chain = my->chain_plug->chain();
+
+   // every captured snapshot is held in memory until it is written, so only one may be pending at a time
+   EOS_ASSERT(!my->writing_snapshot(), snapshot_in_progress_exception,
+              "a snapshot is still being written, see get_snapshot_status");
+
+   auto reschedule = fc::make_scoped_exit([this]() {
+      my->schedule_production_loop();
+   });
+
+   if (chain.pending_block_state())
+   {
+      // abort the pending block
+      chain.abort_block();
+   }
+   else
+   {
+      reschedule.cancel();
+   }
+
+   auto head_id = chain.head_block_id();
+   std::string snapshot_path = my->snapshot_path(head_id);
+
+   // the chain is held up for the whole capture, only the disk write overlaps with block processing
+   auto start = fc::time_point::now();
+   auto captured = std::make_shared<buffered_snapshot_writer>();
+   chain.write_snapshot(captured);
+   const auto capture_us = (fc::time_point::now() - start).count();
+   ilog("captured snapshot ${name} in ${ms} ms on the main thread, writing ${size} bytes in the background",
+        ("name", snapshot_path)("ms", capture_us / 1000)("size", captured->size()));
+
+   my->add_snapshot_status({head_id, snapshot_path, "writing", std::string(), capture_us});
+
+   boost::asio::post(*my->_snapshot_thread_pool, [impl = my, captured, snapshot_path]() {
+      impl->write_captured_snapshot(snapshot_path, [&](std::ostream &out) {
+         ostream_snapshot_writer writer(out);
+         captured->write_to(writer);
+         writer.finalize();
+         impl->log_snapshot_sections(writer);
+      });
+   });
+
+   return {head_id, snapshot_path};
+}
+
+std::vector<producer_plugin::snapshot_status> producer_plugin::get_snapshot_status() const
+{
+   std::lock_guard<std::mutex> g(my->_snapshot_status_mutex);
+   return my->_snapshot_status;
+}
+
+producer_plugin::snapshot_information producer_plugin::create_snapshot_delta(const snapshot_delta_params &params) const
+{
+   chain::controller &chain = my->chain_plug->chain();
+
+   // the base and deltas are named by the request, only files directly in the snapshots dir may be read
+   auto resolve = [this](const std::string &name) {
+      bfs::path path(name);
+      EOS_ASSERT(!name.empty() && name != "." && name != ".." && path == path.filename(), invalid_snapshot_request_exception,
+                 "${name} is not the name of a file in the snapshots directory", ("name", name));
+      auto resolved = my->_snapshots_dir / path;
+      EOS_ASSERT(fc::is_regular_file(resolved), invalid_snapshot_request_exception,
+                 "snapshot ${name} does not exist", ("name", resolved.generic_string()));
+      return fc::path(resolved);
+   };
+
+   const auto base_path = resolve(params.base);
+   std::vector<fc::path> deltas;
+   for (const auto &delta : params.deltas)
+   {
+      deltas.push_back(resolve(delta));
+   }
+
+   // the captured state is held in memory until the delta is written, so only one may be pending at a time
+   EOS_ASSERT(!my->writing_snapshot(), snapshot_in_progress_exception,
+              "a snapshot is still being written, see get_snapshot_status");
+
+   auto reschedule = fc::make_scoped_exit([this]() {
+      my->schedule_production_loop();
+   });
+
+   if (chain.pending_block_state())
+   {
+      // abort the pending block
+      chain.abort_block();
+   }
+   else
+   {
+      reschedule.cancel();
+   }
+
+   auto head_id = chain.head_block_id();
+   std::string snapshot_path = my->snapshot_path(head_id, "delta");
+
+   // the state is captured as for a full snapshot; reading the base and diffing against it happen on the snapshot
+   // thread, so the chain is held up no longer than by create_snapshot_deferred_write
+   auto start = fc::time_point::now();
+   auto captured = std::make_shared<buffered_snapshot_writer>();
+   chain.write_snapshot(captured);
+   const auto capture_us = (fc::time_point::now() - start).count();
+   ilog("captured snapshot ${name} in ${ms} ms on the main thread, writing it as a delta in the background",
+        ("name", snapshot_path)("ms", capture_us / 1000));
+
+   my->add_snapshot_status({head_id, snapshot_path, "writing", std::string(), capture_us});
+
+   boost::asio::post(*my->_snapshot_thread_pool, [impl = my, captured, snapshot_path, base_path, deltas]() {
+      impl->write_captured_snapshot(snapshot_path, [&](std::ostream &out) {
+         std::vector<std::shared_ptr<std::istream>> base_files;
+         auto base = chain_plugin::open_snapshot(base_path, deltas, base_files);
+         base->validate();
+
+         delta_snapshot_writer writer(base, out);
+         captured->write_to(writer);
+         writer.finalize();
+         ilog("snapshot delta ${name}: ${copied} rows copied from the base, ${inserted} rows written",
+              ("name", snapshot_path)("copied", writer.copied_rows())("inserted", writer.inserted_rows()));
+      });
+   });
+
    return {head_id, snapshot_path};
 }
 
@@ -4,6 +4,7 @@
  */
 #include <eosio/chain/abi_serializer.hpp>
 #include <eosio/chain/block_log.hpp>
+#include <eosio/chain/compressed_block_log.hpp>
 #include <eosio/chain/config.hpp>
 #include <eosio/chain/reversible_block_object.hpp>
 
@@ -16,6 +17,10 @@
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/path.hpp>
 
+#include <algorithm>
+#include <numeric>
+#include <random>
+
 using namespace eosio::chain;
 namespace bfs = boost::filesystem;
 namespace bpo = boost::program_options;
@@ -27,11 +32,16 @@ struct blocklog {
    {}
 
    void read_log();
+   void compress_log();
+   void decompress_log();
+   void benchmark_compressed_log();
    void set_program_options(options_description& cli);
    void initialize(const variables_map& options);
 
    bfs::path                        blocks_dir;
    bfs::path                        output_file;
+   bfs::path                        compressed_file;
+   uint32_t                         blocks_per_chunk;
    uint32_t                         first_block;
    uint32_t                         last_block;
    bool                             no_pretty_print;
@@ -130,6 +140,50 @@ void blocklog::read_log() {
       *out << "]";
 }
 
+void blocklog::compress_log() {
+   auto start = fc::time_point::now();
+   compressed_block_log::construct(blocks_dir, compressed_file, blocks_per_chunk);
+   ilog( "wrote compressed block log ${f} in ${s} seconds",
+         ("f", compressed_file.generic_string())("s", (fc::time_point::now() - start).count() / 1000000) );
+}
+
+void blocklog::decompress_log() {
+   compressed_block_log::extract(compressed_file, blocks_dir);
+   ilog( "recreated block log in ${d} from ${f}", ("d", blocks_dir.generic_string())("f", compressed_file.generic_string()) );
+}
+
+void blocklog::benchmark_compressed_log() {
+   block_log plain(blocks_dir);
+   compressed_block_log compressed(compressed_file);
+
+   const uint64_t plain_size = bfs::file_size(blocks_dir / "blocks.log") + bfs::file_size(blocks_dir / "blocks.index");
+   const uint64_t compressed_size = bfs::file_size(compressed_file);
+   ilog( "bytes on disk: block log ${p}, compressed ${c} (${r}%)",
+         ("p", plain_size)("c", compressed_size)("r", compressed_size * 100 / std::max<uint64_t>(plain_size, 1)) );
+
+   const uint32_t first = std::max(first_block, compressed.first_block_num());
+   const uint32_t last = std::min(last_block, compressed.last_block_num());
+   EOS_ASSERT( first <= last, block_log_exception, "No blocks to read in range [${f}, ${l}]", ("f", first_block)("l", last_block) );
+
+   vector<uint32_t> sequential(last - first + 1);
+   std::iota(sequential.begin(), sequential.end(), first);
+   vector<uint32_t> random = sequential;
+   std::shuffle(random.begin(), random.end(), std::mt19937(0));
+   random.resize(std::min<size_t>(random.size(), 100000));
+
+   auto measure = [](const char* name, const vector<uint32_t>& nums, auto&& read) {
+      auto start = fc::time_point::now();
+      for( auto num : nums )
+         EOS_ASSERT( read(num), block_log_exception, "Block ${n} not found", ("n", num) );
+      auto us = std::max<int64_t>((fc::time_point::now() - start).count(), 1);
+      ilog( "${name}: ${n} blocks in ${ms} ms, ${r} blocks/s", ("name", name)("n", nums.size())("ms", us / 1000)("r", nums.size() * 1000000 / us) );
+   };
+   measure("block log sequential", sequential, [&](uint32_t n) { return plain.read_block_by_num(n); });
+   measure("compressed sequential", sequential, [&](uint32_t n) { return compressed.read_block_by_num(n); });
+   measure("block log random", random, [&](uint32_t n) { return plain.read_block_by_num(n); });
+   measure("compressed random", random, [&](uint32_t n) { return compressed.read_block_by_num(n); });
+}
+
 void blocklog::set_program_options(options_description& cli)
 {
    cli.add_options()
@@ -145,6 +199,14 @@ void blocklog::set_program_options(options_description& cli)
           "Do not pretty print the output.  Useful if piping to jq to improve performance.")
          ("as-json-array", bpo::bool_switch(&as_json_array)->default_value(false),
           "Print out json blocks wrapped in json array (otherwise the output is free-standing json objects).")
+         ("compress-to", bpo::value<bfs::path>(),
+          "write a compressed, seekable copy of the block log to this file instead of printing blocks")
+         ("decompress-from", bpo::value<bfs::path>(),
+          "recreate the block log in blocks-dir from this compressed block log instead of printing blocks")
+         ("benchmark-compressed", bpo::value<bfs::path>(),
+          "compare bytes on disk and sequential/random read throughput of the block log against this compressed block log")
+         ("blocks-per-chunk", bpo::value<uint32_t>(&blocks_per_chunk)->default_value(compressed_block_log::default_blocks_per_chunk),
+          "number of blocks compressed together by --compress-to")
          ("help", "Print this help message and exit.")
          ;
 
@@ -165,6 +227,16 @@ void blocklog::initialize(const variables_map& options) {
          else
             output_file = bld;
       }
+
+      for( const char* opt : {"compress-to", "decompress-from", "benchmark-compressed"} ) {
+         if (options.count( opt )) {
+            bld = options.at( opt ).as<bfs::path>();
+            if( bld.is_relative())
+               compressed_file = bfs::current_path() / bld;
+            else
+               compressed_file = bld;
+         }
+      }
    } FC_LOG_AND_RETHROW()
 
 }
@@ -185,7 +257,14 @@ int main(int argc, char** argv)
         return 0;
       }
       blog.initialize(vmap);
-      blog.read_log();
+      if (vmap.count("compress-to"))
+         blog.compress_log();
+      else if (vmap.count("decompress-from"))
+         blog.decompress_log();
+      else if (vmap.count("benchmark-compressed"))
+         blog.benchmark_compressed_log();
+      else
+         blog.read_log();
    } catch( const fc::exception& e ) {
       elog( "${e}", ("e", e.to_detail_string()));
       return -1;
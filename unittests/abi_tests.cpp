@@ -6,6 +6,7 @@
 #include <vector>
 #include <iterator>
 #include <cstdlib>
+#include <sstream>
 
 #include <boost/test/unit_test.hpp>
 
@@ -17,6 +18,7 @@
 
 #include <eosio/chain/contract_types.hpp>
 #include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/abi_serializer_cache.hpp>
 #include <eosio/chain/eosio_contract.hpp>
 #include <eosio/testing/tester.hpp>
 
@@ -2698,4 +2700,155 @@ BOOST_AUTO_TEST_CASE(abi_deserialize_detailed_error_messages)
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE(abi_binary_to_json)
+{ try {
+   const char* abi_str = R"=====(
+   {
+      "version": "eosio::abi/1.1",
+      "structs": [
+         {"name": "base", "base": "", "fields": [
+            {"name": "id", "type": "uint64"},
+            {"name": "flag", "type": "bool"}
+         ]},
+         {"name": "row", "base": "base", "fields": [
+            {"name": "owner", "type": "name"},
+            {"name": "small", "type": "int8"},
+            {"name": "neg", "type": "int64"},
+            {"name": "big", "type": "uint64"},
+            {"name": "balance", "type": "asset"},
+            {"name": "memo", "type": "string"},
+            {"name": "opt", "type": "uint32?"},
+            {"name": "list", "type": "int16[]"},
+            {"name": "choice", "type": "v"},
+            {"name": "ext", "type": "uint32$"}
+         ]},
+         {"name": "shadow", "base": "base", "fields": [
+            {"name": "id", "type": "string"}
+         ]}
+      ],
+      "variants": [
+         {"name": "v", "types": ["int8", "string", "base"]}
+      ]
+   }
+   )=====";
+   abi_serializer abis( fc::json::from_string(abi_str).as<abi_def>(), max_serialization_time );
+
+   auto verify = [&]( const type_name& type, const char* json ) {
+      const auto bin = abis.variant_to_binary( type, fc::json::from_string(json), max_serialization_time );
+      std::ostringstream out;
+      abis.binary_to_json( type, bin, out, max_serialization_time );
+      BOOST_CHECK_EQUAL( out.str(), fc::json::to_string( abis.binary_to_variant( type, bin, max_serialization_time ) ) );
+   };
+
+   verify( "row", R"=====({"id":"18446744073709551615","flag":1,"owner":"alice","small":-5,"neg":"-9000000000","big":"4294967296",
+                          "balance":"1.0000 EOS","memo":"a \"quoted\" \\ memo","opt":null,"list":[1,-2,3],
+                          "choice":["base",{"id":7,"flag":0}]})=====" );
+   verify( "row", R"=====({"id":4294967295,"flag":0,"owner":"","small":127,"neg":-1,"big":0,
+                          "balance":"-0.0001 SYS","memo":"","opt":42,"list":[],"choice":["string","x"],"ext":9})=====" );
+   // a field named like one of its base's keeps a single key, as in a variant object
+   verify( "shadow", R"=====({"id":"5","flag":1})=====" );
+   verify( "v", R"=====(["int8",-128])=====" );
+
+   // errors match those of binary_to_variant
+   std::ostringstream out;
+   BOOST_CHECK_THROW( abis.binary_to_json( "row", bytes(4), out, max_serialization_time ), unpack_exception );
+   BOOST_CHECK_THROW( abis.binary_to_json( "v", bytes{char(7)}, out, max_serialization_time ), unpack_exception );
+
+} FC_LOG_AND_RETHROW() }
+
+// Times building an fc::variant and converting it to JSON against writing the JSON straight from the binary,
+// every direct conversion must match the variant output byte for byte
+BOOST_AUTO_TEST_CASE(abi_binary_to_json_benchmark)
+{ try {
+   auto bench = []( const char* label, const abi_def& abi, const type_name& type, const bytes& bin, uint32_t iterations ) {
+      abi_serializer abis( abi, max_serialization_time );
+      // warm the plan so neither loop pays for compiling it
+      const string via_variant = fc::json::to_string( abis.binary_to_variant( type, bin, max_serialization_time ) );
+      BOOST_REQUIRE( !via_variant.empty() );
+
+      auto start = fc::time_point::now();
+      for( uint32_t i = 0; i < iterations; ++i )
+         BOOST_REQUIRE( fc::json::to_string( abis.binary_to_variant( type, bin, max_serialization_time ) ) == via_variant );
+      const auto variant_us = (fc::time_point::now() - start).count();
+
+      string direct;
+      start = fc::time_point::now();
+      for( uint32_t i = 0; i < iterations; ++i ) {
+         std::ostringstream out;
+         abis.binary_to_json( type, bin, out, max_serialization_time );
+         direct = out.str();
+         BOOST_REQUIRE( direct == via_variant );
+      }
+      const auto direct_us = (fc::time_point::now() - start).count();
+
+      ilog( "${l}: ${n} conversions to ${s} bytes of JSON in ${v} us through a variant, ${d} us written directly",
+            ("l", label)("n", iterations)("s", direct.size())("v", variant_us)("d", direct_us) );
+   };
+
+   const auto system_abi = eosio_contract_abi(abi_def());
+   updateauth ua;
+   ua.account = N(updauth.acct);
+   ua.permission = N(updauth.prm);
+   ua.parent = N(updauth.prnt);
+   ua.auth.threshold = 2;
+   for( uint32_t i = 0; i < 32; ++i )
+      ua.auth.accounts.push_back( permission_level_weight{ permission_level{ name(N(prm.acct) + i), N(active) }, uint16_t(i + 1) } );
+   bench( "updateauth", system_abi, "updateauth", fc::raw::pack( ua ), 2000 );
+
+   // s8 of large_nested.abi nests 3^8 int64 leaves eight structs deep
+   const auto nested_abi = fc::json::from_string( large_nested_abi ).as<abi_def>();
+   bench( "large_nested s8", nested_abi, "s8", bytes( 6561 * sizeof(int64_t) ), 20 );
+
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(abi_serializer_cache_test)
+{ try {
+   const char* abi_v1 = R"=====({"version":"eosio::abi/1.0","structs":[{"name":"act","base":"","fields":[{"name":"a","type":"uint8"}]}],"actions":[{"name":"act","type":"act","ricardian_contract":""}]})=====";
+   const char* abi_v2 = R"=====({"version":"eosio::abi/1.0","structs":[{"name":"act","base":"","fields":[{"name":"a","type":"uint16"}]}],"actions":[{"name":"act","type":"act","ricardian_contract":""}]})=====";
+
+   testing::tester chain;
+   chain.create_accounts( {N(abicache), N(abicache2)} );
+   const auto& db = chain.control->db();
+
+   abi_serializer_cache cache( 1 );
+   BOOST_CHECK( !cache.get( db, N(abicache), max_serialization_time ) );
+   BOOST_CHECK( !cache.get( db, N(nosuchacct), max_serialization_time ) );
+
+   chain.set_abi( N(abicache), abi_v1 );
+   const auto first = cache.get( db, N(abicache), max_serialization_time );
+   BOOST_REQUIRE( first );
+   BOOST_CHECK( cache.get( db, N(abicache), max_serialization_time ) == first );
+   BOOST_CHECK_EQUAL( first->serializer.get_action_type( N(act) ), "act" );
+
+   // setabi bumps abi_sequence, so the entry of the replaced ABI is not returned anymore
+   chain.set_abi( N(abicache), abi_v2 );
+   const auto second = cache.get( db, N(abicache), max_serialization_time );
+   BOOST_REQUIRE( second );
+   BOOST_CHECK( second != first );
+   BOOST_CHECK_EQUAL( second->abi.structs[0].fields[0].type, "uint16" );
+   // while whoever still holds the old entry can keep using it
+   BOOST_CHECK_EQUAL( first->abi.structs[0].fields[0].type, "uint8" );
+
+   chain.set_abi( N(abicache2), abi_v1 );
+   BOOST_REQUIRE( cache.get( db, N(abicache2), max_serialization_time ) );
+   auto stats = cache.get_stats();
+   BOOST_CHECK_EQUAL( stats.hits, 1u );
+   BOOST_CHECK_EQUAL( stats.misses, 4u );
+   BOOST_CHECK_EQUAL( stats.evictions, 1u );
+   BOOST_CHECK_EQUAL( stats.entries, 1u );
+   BOOST_CHECK( stats.memory_size > 0 );
+
+   cache.invalidate( N(abicache2) );
+   stats = cache.get_stats();
+   BOOST_CHECK_EQUAL( stats.invalidations, 1u );
+   BOOST_CHECK_EQUAL( stats.entries, 0u );
+   BOOST_CHECK_EQUAL( stats.memory_size, 0u );
+
+   // a capacity of 0 still builds serializers but keeps none of them
+   cache.set_capacity( 0 );
+   BOOST_CHECK( cache.get( db, N(abicache), max_serialization_time ) );
+   BOOST_CHECK_EQUAL( cache.get_stats().entries, 0u );
+
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
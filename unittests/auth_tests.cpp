@@ -34,6 +34,40 @@ BOOST_FIXTURE_TEST_CASE( missing_sigs, TESTER ) { try {
 
 } FC_LOG_AND_RETHROW() } /// missing_sigs
 
+BOOST_FIXTURE_TEST_CASE( authority_cache, TESTER ) { try {
+   create_accounts( {N(alice)} );
+   produce_block();
+   const auto& authorization = control->get_authorization_manager();
+
+   push_dummy( N(alice), "first" );
+   auto stats = authorization.get_authority_cache_stats();
+   const auto hits = stats.hits;
+   const auto misses = stats.misses;
+   BOOST_CHECK_GT( stats.entries, 0u );
+
+   // same permission, keys and delay within the same block
+   push_dummy( N(alice), "second" );
+   stats = authorization.get_authority_cache_stats();
+   BOOST_CHECK_EQUAL( stats.hits, hits + 1 );
+   BOOST_CHECK_EQUAL( stats.misses, misses );
+
+   // permission changes forget the memoized checks
+   const auto invalidations = stats.invalidations;
+   set_authority( N(alice), N(trading), authority( get_public_key( N(alice), "trading" ) ), config::active_name );
+   stats = authorization.get_authority_cache_stats();
+   BOOST_CHECK_GT( stats.invalidations, invalidations );
+   push_dummy( N(alice), "third" );
+   BOOST_CHECK_EQUAL( authorization.get_authority_cache_stats().misses, stats.misses + 1 );
+
+   // only satisfied checks are remembered
+   BOOST_REQUIRE_THROW( push_reqauth( N(alice), {permission_level{N(alice), config::active_name}}, {} ), unsatisfied_authorization );
+   BOOST_REQUIRE_THROW( push_reqauth( N(alice), {permission_level{N(alice), config::active_name}}, {} ), unsatisfied_authorization );
+
+   produce_block();
+   BOOST_CHECK_EQUAL( authorization.get_authority_cache_stats().entries, 0u );
+
+} FC_LOG_AND_RETHROW() } /// authority_cache
+
 BOOST_FIXTURE_TEST_CASE( missing_multi_sigs, TESTER ) { try {
     produce_block();
     create_account(N(alice), config::system_account_name, true);
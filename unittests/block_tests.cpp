@@ -5,6 +5,13 @@
 
 #include <boost/test/unit_test.hpp>
 #include <eosio/testing/tester.hpp>
+#include <eosio/chain/block_log.hpp>
+#include <eosio/chain/compressed_block_log.hpp>
+
+#include <fc/scoped_exit.hpp>
+
+#include <atomic>
+#include <thread>
 
 using namespace eosio;
 using namespace testing;
@@ -164,4 +171,226 @@ BOOST_AUTO_TEST_CASE(untrusted_producer_test)
    }) ;
 }
 
+/**
+ * Read the block log from several threads while blocks are being appended to it
+ */
+BOOST_AUTO_TEST_CASE(block_log_concurrent_read_test)
+{
+   tester main;
+   main.produce_blocks(200);
+
+   vector<signed_block_ptr> blocks;
+   for( uint32_t num = 1; num <= main.control->last_irreversible_block_num(); ++num )
+      blocks.push_back( main.control->fetch_block_by_number(num) );
+   BOOST_REQUIRE_GT( blocks.size(), 100u );
+
+   fc::temp_directory tempdir;
+   block_log log( tempdir.path() );
+   log.reset( main.get_config().genesis, blocks.front() );
+
+   std::atomic<bool> done{false};
+   std::atomic<uint32_t> mismatches{0};
+   vector<std::thread> readers;
+   for( uint32_t t = 0; t < 4; ++t ) {
+      readers.emplace_back( [&, t]() {
+         uint32_t num = t + 1;
+         while( !done ) {
+            num = num % blocks.size() + 1;
+            auto b = log.read_block_by_num( num );
+            if( b && b->id() != blocks[num - 1]->id() )
+               ++mismatches;
+         }
+      } );
+   }
+
+   for( size_t i = 1; i < blocks.size(); ++i )
+      log.append( blocks[i] );
+   done = true;
+   for( auto& r : readers )
+      r.join();
+
+   BOOST_CHECK_EQUAL( mismatches, 0u );
+   for( const auto& b : blocks )
+      BOOST_CHECK_EQUAL( log.read_block_by_num( b->block_num() )->id(), b->id() );
+   BOOST_CHECK_EQUAL( log.read_head()->id(), blocks.back()->id() );
+}
+
+/**
+ * Rebuild a missing block log index and check it against the blocks that were written
+ */
+BOOST_AUTO_TEST_CASE(block_log_index_reconstruction_test)
+{
+   tester main;
+   main.produce_blocks(50);
+
+   vector<signed_block_ptr> blocks;
+   for( uint32_t num = 1; num <= main.control->last_irreversible_block_num(); ++num )
+      blocks.push_back( main.control->fetch_block_by_number(num) );
+
+   fc::temp_directory tempdir;
+   {
+      block_log log( tempdir.path() );
+      log.reset( main.get_config().genesis, blocks.front() );
+      for( size_t i = 1; i < blocks.size(); ++i )
+         log.append( blocks[i] );
+   }
+   const auto index_size = fc::file_size( tempdir.path() / "blocks.index" );
+   fc::remove( tempdir.path() / "blocks.index" );
+
+   block_log log( tempdir.path() );
+   BOOST_CHECK_EQUAL( fc::file_size( tempdir.path() / "blocks.index" ), index_size );
+   for( const auto& b : blocks )
+      BOOST_CHECK_EQUAL( log.read_block_by_num( b->block_num() )->id(), b->id() );
+}
+
+/**
+ * Rebuild the index from several scanned chunks, then again after corrupting the trailer of a block that straddles
+ * a chunk boundary so the stitched result is rejected and the sequential fallback has to produce it
+ */
+BOOST_AUTO_TEST_CASE(block_log_chunked_index_reconstruction_test)
+{
+   tester main;
+   main.produce_blocks(50);
+
+   vector<signed_block_ptr> blocks;
+   for( uint32_t num = 1; num <= main.control->last_irreversible_block_num(); ++num )
+      blocks.push_back( main.control->fetch_block_by_number(num) );
+
+   fc::temp_directory tempdir;
+   const auto block_file = tempdir.path() / "blocks.log";
+   const auto index_file = tempdir.path() / "blocks.index";
+   {
+      block_log log( tempdir.path() );
+      log.reset( main.get_config().genesis, blocks.front() );
+      for( size_t i = 1; i < blocks.size(); ++i )
+         log.append( blocks[i] );
+   }
+
+   vector<uint64_t> positions( blocks.size() );
+   {
+      std::ifstream index( index_file.generic_string(), std::ios::binary );
+      index.read( (char*)positions.data(), positions.size() * sizeof(uint64_t) );
+   }
+   const uint64_t chunk_size = (fc::file_size( block_file ) - positions.front()) / 5;
+   BOOST_REQUIRE( chunk_size > 0 );
+
+   const auto default_chunk_size = block_log::index_scan_chunk_size;
+   auto restore = fc::make_scoped_exit( [&]() { block_log::index_scan_chunk_size = default_chunk_size; } );
+   block_log::index_scan_chunk_size = chunk_size;
+
+   auto check_rebuilt_index = [&]() {
+      fc::remove( index_file );
+      block_log log( tempdir.path() );
+      vector<uint64_t> rebuilt( positions.size() );
+      std::ifstream index( index_file.generic_string(), std::ios::binary );
+      index.read( (char*)rebuilt.data(), rebuilt.size() * sizeof(uint64_t) );
+      BOOST_CHECK_EQUAL( fc::file_size( index_file ), positions.size() * sizeof(uint64_t) );
+      BOOST_CHECK( rebuilt == positions );
+      for( const auto& b : blocks )
+         BOOST_CHECK_EQUAL( log.read_block_by_num( b->block_num() )->id(), b->id() );
+   };
+
+   check_rebuilt_index();
+
+   // the block starting before the boundary between the second and third chunk and ending after it
+   const uint64_t boundary = positions.front() + 2 * chunk_size;
+   size_t straddling = 0;
+   while( straddling + 1 < positions.size() && positions[straddling + 1] - sizeof(uint64_t) < boundary )
+      ++straddling;
+   BOOST_REQUIRE( straddling + 1 < positions.size() );
+   {
+      std::fstream log( block_file.generic_string(), std::ios::in | std::ios::out | std::ios::binary );
+      const uint64_t garbage = positions[straddling] ^ 0x5a5a5a5a5a5a5a5aull;
+      log.seekp( positions[straddling + 1] - sizeof(uint64_t) );
+      log.write( (const char*)&garbage, sizeof(garbage) );
+   }
+
+   check_rebuilt_index();
+}
+
+BOOST_AUTO_TEST_CASE(block_log_split_test)
+{
+   tester main;
+   main.produce_blocks(50);
+
+   vector<signed_block_ptr> blocks;
+   for( uint32_t num = 1; num <= main.control->last_irreversible_block_num(); ++num )
+      blocks.push_back( main.control->fetch_block_by_number(num) );
+
+   fc::temp_directory tempdir;
+   const auto blocks_dir = tempdir.path() / "blocks";
+   const auto archive_dir = tempdir.path() / "archive";
+   const uint32_t stride = 10;
+   const uint32_t retained = 2;
+   const uint32_t first_retained = (blocks.back()->block_num() / stride - retained) * stride + 1;
+
+   auto check_log = [&]( const block_log& log ) {
+      BOOST_CHECK_EQUAL( log.first_block_num(), first_retained );
+      BOOST_CHECK_EQUAL( log.read_head()->id(), blocks.back()->id() );
+      for( const auto& b : blocks ) {
+         if( b->block_num() < first_retained ) {
+            BOOST_CHECK( !log.read_block_by_num( b->block_num() ) );
+            BOOST_CHECK_EQUAL( log.get_block_pos( b->block_num() ), block_log::npos );
+         } else {
+            BOOST_CHECK_EQUAL( log.read_block_by_num( b->block_num() )->id(), b->id() );
+            BOOST_CHECK_NE( log.get_block_pos( b->block_num() ), block_log::npos );
+         }
+      }
+   };
+
+   {
+      block_log log( blocks_dir, stride, retained, archive_dir );
+      log.reset( main.get_config().genesis, blocks.front() );
+      for( size_t i = 1; i < blocks.size(); ++i )
+         log.append( blocks[i] );
+      check_log( log );
+   }
+   BOOST_CHECK( fc::exists( archive_dir / "blocks-1-10.log" ) );
+   BOOST_CHECK( fc::exists( blocks_dir / ("blocks-" + std::to_string(first_retained) + "-" + std::to_string(first_retained + stride - 1) + ".log") ) );
+
+   // a split off index is rebuilt like the index of the main file
+   fc::remove( blocks_dir / ("blocks-" + std::to_string(first_retained) + "-" + std::to_string(first_retained + stride - 1) + ".index") );
+   block_log log( blocks_dir, stride, retained, archive_dir );
+   check_log( log );
+}
+
+BOOST_AUTO_TEST_CASE(compressed_block_log_test)
+{
+   tester main;
+   main.produce_blocks(50);
+
+   vector<signed_block_ptr> blocks;
+   for( uint32_t num = 1; num <= main.control->last_irreversible_block_num(); ++num )
+      blocks.push_back( main.control->fetch_block_by_number(num) );
+
+   fc::temp_directory tempdir;
+   const auto source_dir = tempdir.path() / "source";
+   const auto extracted_dir = tempdir.path() / "extracted";
+   const auto archive = tempdir.path() / "blocks.archive";
+   {
+      block_log log( source_dir );
+      log.reset( main.get_config().genesis, blocks.front() );
+      for( size_t i = 1; i < blocks.size(); ++i )
+         log.append( blocks[i] );
+   }
+
+   // a chunk size that does not divide the block count leaves a partial last chunk
+   compressed_block_log::construct( source_dir, archive, 16 );
+   BOOST_CHECK( !fc::exists( archive.generic_string() + ".tmp" ) );
+   {
+      compressed_block_log compressed( archive );
+      BOOST_CHECK_EQUAL( compressed.first_block_num(), 1u );
+      BOOST_CHECK_EQUAL( compressed.last_block_num(), blocks.back()->block_num() );
+      BOOST_CHECK( !compressed.read_block_by_num( blocks.back()->block_num() + 1 ) );
+      for( auto it = blocks.rbegin(); it != blocks.rend(); ++it )
+         BOOST_CHECK_EQUAL( compressed.read_block_by_num( (*it)->block_num() )->id(), (*it)->id() );
+   }
+
+   compressed_block_log::extract( archive, extracted_dir );
+   BOOST_CHECK_EQUAL( fc::file_size( extracted_dir / "blocks.log" ), fc::file_size( source_dir / "blocks.log" ) );
+   block_log log( extracted_dir );
+   for( const auto& b : blocks )
+      BOOST_CHECK_EQUAL( log.read_block_by_num( b->block_num() )->id(), b->id() );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -633,3 +633,30 @@ static const char memory_growth_memset_test[] = R"=====(
  )
 )
 )=====";
+
+static const char memory_image_reset_wast[] = R"=====(
+(module
+ (export "apply" (func $apply))
+ (import "env" "eosio_assert" (func $eosio_assert (param i32 i32)))
+ (memory $0 2)
+ (data (i32.const 80000) "abc")
+ (func $apply (param $0 i64)(param $1 i64)(param $2 i64)
+   (call $eosio_assert
+     (i32.eq
+       (i32.load8_u offset=80000 (i32.const 0))
+       (i32.const 97)
+     )
+     (i32.const 0)
+   )
+   (call $eosio_assert
+     (i32.eq
+       (i32.load8_u offset=120000 (i32.const 0))
+       (i32.const 0)
+     )
+     (i32.const 0)
+   )
+   (i32.store8 offset=80000 (i32.const 0) (i32.const 0))
+   (i32.store8 offset=120000 (i32.const 0) (i32.const 1))
+ )
+)
+)=====";
@@ -5,6 +5,7 @@
 
 #include <eosio/testing/tester.hpp>
 #include <eosio/chain/global_property_object.hpp>
+#include <eosio/chain/transaction_object.hpp>
 #include <fc/crypto/digest.hpp>
 
 #include <boost/test/unit_test.hpp>
@@ -100,5 +101,89 @@ BOOST_AUTO_TEST_SUITE(database_tests)
       } FC_LOG_AND_RETHROW()
    }
 
+   // Transactions expire once the block time is past their expiration, whole expiration seconds at a time
+   BOOST_AUTO_TEST_CASE(dedupe_expiry) {
+      try {
+         TESTER test;
+         eosio::chain::database& db = const_cast<eosio::chain::database&>( test.control->db() );
+         auto ses = db.start_undo_session(true);
+
+         const fc::time_point_sec base = test.control->head_block_time() + fc::seconds(60);
+         for (uint32_t i = 0; i < 4; ++i) {
+            db.create<transaction_object>([&](transaction_object& t) {
+               t.trx_id = fc::sha256::hash(std::to_string(i));
+               t.expiration = base + i / 2;
+            });
+         }
+         BOOST_REQUIRE_THROW(db.create<transaction_object>([&](transaction_object& t) {
+            t.trx_id = fc::sha256::hash(std::to_string(0));
+            t.expiration = base;
+         }), std::exception);
+
+         BOOST_TEST(remove_expired_transactions(db, base) == 0u);
+         BOOST_TEST(test.control->is_known_unexpired_transaction(fc::sha256::hash(std::to_string(0))));
+
+         BOOST_TEST(remove_expired_transactions(db, fc::time_point(base) + fc::milliseconds(500)) == 2u);
+         BOOST_TEST(!test.control->is_known_unexpired_transaction(fc::sha256::hash(std::to_string(1))));
+         BOOST_TEST(test.control->is_known_unexpired_transaction(fc::sha256::hash(std::to_string(2))));
+
+         BOOST_TEST(remove_expired_transactions(db, fc::time_point(base + 1)) == 0u);
+         BOOST_TEST(remove_expired_transactions(db, fc::time_point(base + 2)) == 2u);
+         BOOST_TEST(db.get_index<transaction_multi_index>().indices().empty());
+
+         ses.undo();
+      } FC_LOG_AND_RETHROW()
+   }
+
+   // The dedupe index under a steady 5k TPS load: every half second block drops the expired transactions, then
+   // checks and records 2500 new ones expiring 30 to 60 seconds later
+   BOOST_AUTO_TEST_CASE(dedupe_steady_load) {
+      try {
+         TESTER test;
+         eosio::chain::database& db = const_cast<eosio::chain::database&>( test.control->db() );
+         auto ses = db.start_undo_session(true);
+
+         const uint32_t trx_per_block = 2500;
+         const uint32_t blocks = 240;
+         const auto& dedupe_index = db.get_index<transaction_multi_index, by_expiration>();
+         fc::time_point now = test.control->head_block_time();
+         size_t removed = 0;
+
+         for (uint32_t b = 0; b < blocks; ++b) {
+            now += fc::milliseconds(config::block_interval_ms);
+            auto block_ses = db.start_undo_session(true);
+
+            // only expired transactions go, and all of them
+            const auto before = dedupe_index.size();
+            const auto expired = remove_expired_transactions(db, now);
+            BOOST_REQUIRE_EQUAL(dedupe_index.size(), before - expired);
+            BOOST_REQUIRE(dedupe_index.empty() || fc::time_point(dedupe_index.begin()->expiration) >= now);
+            removed += expired;
+
+            for (uint32_t i = 0; i < trx_per_block; ++i) {
+               auto id = fc::sha256::hash(uint64_t(b) * trx_per_block + i);
+               BOOST_REQUIRE(!test.control->is_known_unexpired_transaction(id));
+               db.create<transaction_object>([&](transaction_object& t) {
+                  t.trx_id = id;
+                  t.expiration = fc::time_point_sec(now) + 30 + i % 30;
+               });
+            }
+
+            // what the previous block recorded expires no sooner than 29.5 seconds later
+            if (b > 0) {
+               BOOST_REQUIRE(test.control->is_known_unexpired_transaction(fc::sha256::hash(uint64_t(b - 1) * trx_per_block)));
+            }
+
+            block_ses.squash();
+         }
+
+         // after 120 seconds every transaction of the first minute has expired
+         BOOST_TEST(removed + dedupe_index.size() == size_t(blocks) * trx_per_block);
+         BOOST_TEST(removed >= size_t(blocks / 2) * trx_per_block);
+         BOOST_TEST(fc::time_point(dedupe_index.begin()->expiration) >= now);
+
+         ses.undo();
+      } FC_LOG_AND_RETHROW()
+   }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -347,6 +347,45 @@ BOOST_AUTO_TEST_CASE( prune_remove_branch ) try {
 } FC_LOG_AND_RETHROW() 
 
 
+BOOST_AUTO_TEST_CASE( fork_db_journal ) try {
+   tester c;
+   c.produce_blocks(10);
+   c.create_accounts( {N(dan),N(sam),N(pam),N(scott)} );
+   c.set_producers( {N(dan),N(sam),N(pam),N(scott)} );
+   c.produce_blocks(50);
+   BOOST_REQUIRE_LT( c.control->last_irreversible_block_num() + 1, c.control->head_block_num() );
+
+   // a copy of the journal taken while the chain is running is what a crash leaves behind
+   fc::temp_directory tempdir;
+   const auto journal = tempdir.path() / config::forkdb_journal_filename;
+   fc::copy( c.get_config().state_dir / config::forkdb_journal_filename, journal );
+
+   auto check_recovered = [&]() {
+      fork_database fdb( tempdir.path() );
+      BOOST_REQUIRE( fdb.head() );
+      BOOST_CHECK_EQUAL( fdb.head()->id, c.control->fork_db_head_block_id() );
+      for( uint32_t n = c.control->last_irreversible_block_num() + 1; n <= c.control->head_block_num(); ++n ) {
+         auto s = fdb.get_block_in_current_chain_by_num( n );
+         BOOST_REQUIRE( s );
+         BOOST_CHECK_EQUAL( s->id, c.control->fetch_block_by_number( n )->id() );
+         BOOST_CHECK( s->validated );
+      }
+   };
+   check_recovered();
+
+   // a record torn by the crash is dropped
+   const auto valid_size = fc::file_size( journal );
+   {
+      std::ofstream out( journal.generic_string().c_str(), std::ios::out | std::ios::binary | std::ios::app );
+      const char torn[] = { 100, 0, 0, 0, 1, 2, 3 };
+      out.write( torn, sizeof(torn) );
+   }
+   check_recovered();
+   BOOST_CHECK_EQUAL( fc::file_size( journal ), valid_size );
+
+} FC_LOG_AND_RETHROW()
+
+
 BOOST_AUTO_TEST_CASE( read_modes ) try {
    tester c;
    c.produce_block();
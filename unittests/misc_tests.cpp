@@ -5,8 +5,14 @@
 #include <eosio/chain/chain_config.hpp>
 #include <eosio/chain/authority_checker.hpp>
 #include <eosio/chain/authority.hpp>
+#include <eosio/chain/flat_authority.hpp>
 #include <eosio/chain/types.hpp>
 #include <eosio/chain/asset.hpp>
+#include <eosio/chain/transaction_access_set.hpp>
+#include <eosio/chain/merkle.hpp>
+#include <eosio/chain/signature_recovery_cache.hpp>
+#include <eosio/chain/transaction_metadata.hpp>
+#include <boost/asio/thread_pool.hpp>
 #include <eosio/testing/tester.hpp>
 
 #include <fc/io/json.hpp>
@@ -498,6 +504,56 @@ BOOST_AUTO_TEST_CASE(authority_checker)
    }
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE(flat_authority_checker)
+{ try {
+   vector<public_key_type> keys;
+   for( const char* role : { "k0", "k1", "k2", "k3", "k4", "k5" } )
+      keys.push_back( base_tester::get_public_key( N(msig), role ) );
+
+   // 3 of 5 keys, a cosigner account and a one hour wait, with unequal weights so that the order matters
+   auto msig = authority( 3, { key_weight{keys[0], 1}, key_weight{keys[1], 2}, key_weight{keys[2], 1},
+                               key_weight{keys[3], 1}, key_weight{keys[4], 1} },
+                          { permission_level_weight{{N(cosigner), config::active_name}, 2} },
+                          { wait_weight{3600, 1} } );
+   auto cosigner = authority( 1, { key_weight{keys[5], 1} } );
+
+   auto get_authority = [&]( const permission_level& p ) {
+      return p.actor == N(cosigner) ? cosigner : msig;
+   };
+   std::map<permission_level, flat_authority> flat{ { {N(msig), config::active_name}, flat_authority(msig) },
+                                                    { {N(cosigner), config::active_name}, flat_authority(cosigner) } };
+   auto get_flat_authority = [&]( const permission_level& p ) -> const flat_authority& {
+      return flat.at( p );
+   };
+
+   // every subset of the keys, with and without the delay, must give the same outcome and use the same keys
+   const permission_level level{N(msig), config::active_name};
+   for( uint32_t subset = 0; subset < (1u << keys.size()); ++subset ) {
+      flat_set<public_key_type> provided;
+      for( size_t i = 0; i < keys.size(); ++i )
+         if( subset & (1u << i) ) provided.insert( keys[i] );
+      for( auto delay : { fc::microseconds(0), fc::seconds(3600) } ) {
+         auto checker = make_auth_checker( get_authority, 2, provided, {}, delay );
+         auto flat_checker = make_auth_checker( get_flat_authority, 2, provided, {}, delay );
+         BOOST_CHECK_EQUAL( checker.satisfied( level ), flat_checker.satisfied( level ) );
+         BOOST_CHECK( checker.used_keys() == flat_checker.used_keys() );
+      }
+   }
+
+   // benchmark
+   const flat_set<public_key_type> provided{ keys[0], keys[2], keys[5] };
+   const uint32_t checks = 20000;
+   auto measure = [&]( auto&& get ) {
+      auto start = fc::time_point::now();
+      for( uint32_t i = 0; i < checks; ++i )
+         BOOST_REQUIRE( make_auth_checker( get, 2, provided ).satisfied( level ) );
+      return checks * 1000000.0 / std::max<int64_t>( (fc::time_point::now() - start).count(), 1 );
+   };
+   ilog( "multisig authority checks per second: authority ${a}, flat_authority ${f}",
+         ("a", uint64_t(measure( get_authority )))("f", uint64_t(measure( get_flat_authority ))) );
+
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE(alphabetic_sort)
 { try {
 
@@ -606,6 +662,175 @@ BOOST_AUTO_TEST_CASE(transaction_test) { try {
 
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE(transaction_access_waves) { try {
+   auto reader = []( name code, name scope, name table ) {
+      transaction_access_set s; s.add_read( code, scope, table ); return s;
+   };
+   auto writer = []( name code, name scope, name table ) {
+      transaction_access_set s; s.add_write( code, scope, table ); return s;
+   };
+
+   vector<transaction_access_set> sets;
+   sets.push_back( writer( N(token), N(alice), N(accounts) ) ); // 0
+   sets.push_back( writer( N(token), N(bob), N(accounts) ) );   // 0, disjoint
+   sets.push_back( reader( N(token), N(alice), N(accounts) ) ); // 1, reads what the first wrote
+   sets.push_back( reader( N(token), N(alice), N(accounts) ) ); // 1, readers do not conflict
+   sets.push_back( writer( N(token), N(alice), N(accounts) ) ); // 2, must follow the readers
+   sets.emplace_back();
+   sets.back().exclusive = true;                                // 3, conflicts with everything
+   sets.push_back( writer( N(token), N(bob), N(accounts) ) );   // 4, not before the exclusive one
+
+   BOOST_CHECK( sets[0].conflicts_with( sets[2] ) );
+   BOOST_CHECK( !sets[0].conflicts_with( sets[1] ) );
+   BOOST_CHECK( !sets[2].conflicts_with( sets[3] ) );
+
+   auto waves = schedule_access_waves( sets );
+   BOOST_CHECK( waves == vector<uint32_t>({0, 0, 1, 1, 2, 3, 4}) );
+
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(merkle_batched) { try {
+   // the pairwise loop merkle() used before it hashed levels in batches
+   auto reference = []( vector<digest_type> ids ) {
+      if( ids.empty() ) return digest_type();
+      while( ids.size() > 1 ) {
+         if( ids.size() % 2 )
+            ids.push_back( ids.back() );
+         for( size_t i = 0; i < ids.size() / 2; ++i )
+            ids[i] = digest_type::hash( make_canonical_pair( ids[2*i], ids[2*i+1] ) );
+         ids.resize( ids.size() / 2 );
+      }
+      return ids.front();
+   };
+   auto leaves = []( size_t n ) {
+      vector<digest_type> ids;
+      ids.reserve( n );
+      for( uint64_t i = 0; i < n; ++i )
+         ids.emplace_back( digest_type::hash( i ) );
+      return ids;
+   };
+
+   boost::asio::thread_pool pool( 4 );
+   for( size_t n = 0; n < 70; ++n ) {
+      auto ids = leaves( n );
+      BOOST_CHECK_EQUAL( merkle( ids ), reference( ids ) );
+      BOOST_CHECK_EQUAL( merkle( ids, pool ), reference( ids ) );
+   }
+
+   // benchmark, levels of at least 8192 pairs are split across the pool
+   for( size_t n : { 1000, 10000, 16385, 100000 } ) {
+      auto ids = leaves( n );
+      auto start = fc::time_point::now();
+      const auto expected = reference( ids );
+      auto sequential = fc::time_point::now();
+      const auto batched = merkle( ids );
+      auto batch = fc::time_point::now();
+      const auto pooled = merkle( ids, pool );
+      auto end = fc::time_point::now();
+      BOOST_CHECK_EQUAL( batched, expected );
+      BOOST_CHECK_EQUAL( pooled, expected );
+      ilog( "merkle of ${n} leaves: pairwise ${p}us, batched ${b}us, thread pool ${t}us",
+            ("n", n)("p", (sequential - start).count())("b", (batch - sequential).count())("t", (end - batch).count()) );
+   }
+   pool.join();
+
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(signature_cache) { try {
+   const auto key = base_tester::get_private_key( N(alice), "active" );
+   const auto pub = key.get_public_key();
+   const auto trx_a = digest_type::hash( string("a") );
+   const auto trx_b = digest_type::hash( string("b") );
+
+   vector<signature_type> sigs;
+   for( uint64_t i = 0; i < 4 * signature_recovery_cache::shard_count; ++i )
+      sigs.push_back( key.sign( digest_type::hash( i ) ) );
+
+   signature_recovery_cache cache( 2 * signature_recovery_cache::shard_count );
+   public_key_type found;
+   fc::microseconds cpu;
+   BOOST_CHECK( !cache.find( sigs[0], trx_a, found, cpu ) );
+   cache.insert( sigs[0], trx_a, pub, fc::microseconds(7) );
+   BOOST_REQUIRE( cache.find( sigs[0], trx_a, found, cpu ) );
+   BOOST_CHECK( found == pub );
+   BOOST_CHECK_EQUAL( cpu.count(), 7 );
+   // only a hit for the transaction the key was recovered for
+   BOOST_CHECK( !cache.find( sigs[0], trx_b, found, cpu ) );
+   cache.insert( sigs[0], trx_b, pub, fc::microseconds(9) );
+   BOOST_CHECK( cache.find( sigs[0], trx_b, found, cpu ) );
+   BOOST_CHECK_EQUAL( cpu.count(), 9 );
+
+   for( const auto& sig : sigs )
+      cache.insert( sig, trx_a, pub, fc::microseconds(1) );
+   auto stats = cache.get_stats();
+   BOOST_CHECK_EQUAL( stats.hits, 2u );
+   BOOST_CHECK_EQUAL( stats.misses, 2u );
+   BOOST_CHECK_EQUAL( stats.capacity, 2 * signature_recovery_cache::shard_count );
+   BOOST_CHECK_LE( stats.entries, stats.capacity );
+   BOOST_CHECK_EQUAL( stats.entries + stats.evictions, sigs.size() );
+
+   cache.set_capacity( 0 );
+   stats = cache.get_stats();
+   BOOST_CHECK_EQUAL( stats.entries, 0u );
+   BOOST_CHECK_EQUAL( stats.evictions, sigs.size() );
+
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(recover_keys_batch) { try {
+   const chain_id_type chain_id = digest_type::hash( string("chain") );
+   vector<private_key_type> keys{ base_tester::get_private_key( N(alice), "active" ),
+                                  base_tester::get_private_key( N(bob), "active" ) };
+   vector<packed_transaction_ptr> packed;
+   for( uint32_t i = 0; i < 2000; ++i ) {
+      signed_transaction trx;
+      trx.expiration = fc::time_point_sec( i );
+      trx.sign( keys[0], chain_id );
+      if( i % 3 == 0 )
+         trx.sign( keys[1], chain_id ); // uneven signature counts
+      packed.push_back( std::make_shared<packed_transaction>( trx ) );
+   }
+   auto make_metadata = [&]() {
+      vector<transaction_metadata_ptr> trxs;
+      for( const auto& p : packed )
+         trxs.push_back( std::make_shared<transaction_metadata>( p ) );
+      return trxs;
+   };
+
+   // measure recovery, not cache hits
+   signature_recovery_cache::instance().set_capacity( 0 );
+   boost::asio::thread_pool pool( 4 );
+
+   auto per_trx = make_metadata();
+   auto start = fc::time_point::now();
+   for( const auto& mtrx : per_trx )
+      transaction_metadata::create_signing_keys_future( mtrx, pool, chain_id, fc::microseconds::maximum() );
+   for( const auto& mtrx : per_trx )
+      mtrx->recover_keys( chain_id );
+   auto futures_done = fc::time_point::now();
+
+   auto batched = make_metadata();
+   transaction_metadata::recover_keys_batch( batched, pool, 4, chain_id, fc::microseconds::maximum() );
+   auto batch_done = fc::time_point::now();
+   ilog( "recovered keys of ${n} transactions: per transaction futures ${f}us, batch ${b}us",
+         ("n", packed.size())("f", (futures_done - start).count())("b", (batch_done - futures_done).count()) );
+
+   for( size_t i = 0; i < batched.size(); ++i ) {
+      BOOST_REQUIRE( batched[i]->signing_keys.valid() );
+      BOOST_CHECK( batched[i]->signing_keys->first == chain_id );
+      BOOST_CHECK( batched[i]->signing_keys->second == per_trx[i]->recover_keys( chain_id ) );
+      BOOST_CHECK_EQUAL( batched[i]->signing_keys->second.size(), i % 3 == 0 ? 2u : 1u );
+   }
+
+   // only transactions without keys are recovered again
+   batched[0]->signing_keys.reset();
+   transaction_metadata::recover_keys_batch( batched, pool, 4, chain_id, fc::microseconds::maximum() );
+   BOOST_CHECK( batched[0]->signing_keys->second == per_trx[0]->recover_keys( chain_id ) );
+
+   pool.join();
+   signature_recovery_cache::instance().set_capacity( config::default_sig_cache_size );
+
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace eosio
@@ -1,5 +1,6 @@
 #include <boost/test/unit_test.hpp>
 #include <eosio/chain/resource_limits.hpp>
+#include <eosio/chain/resource_limits_private.hpp>
 #include <eosio/chain/config.hpp>
 #include <eosio/testing/chainbase_fixture.hpp>
 
@@ -27,6 +28,10 @@ class resource_limits_fixture: private chainbase_fixture<512*1024>, public resou
       chainbase::database::session start_session() {
          return chainbase_fixture::_db->start_undo_session(true);
       }
+
+      const resource_usage_object& get_usage_object( const account_name& account ) {
+         return chainbase_fixture::_db->get<resource_usage_object, by_owner>( account );
+      }
 };
 
 constexpr uint64_t expected_elastic_iterations(uint64_t from, uint64_t to, uint64_t rate_num, uint64_t rate_den ) {
@@ -238,6 +243,71 @@ BOOST_AUTO_TEST_SUITE(resource_limits_test)
 
    } FC_LOG_AND_RETHROW();
 
+   /**
+    * usage billed during a block stays in memory, honours usage sessions and reaches chainbase unchanged
+    */
+   BOOST_FIXTURE_TEST_CASE(pending_usage_accumulator, resource_limits_fixture) try {
+      const account_name alice(1);
+      const account_name bob(2);
+      for( const auto& a : {alice, bob} ) {
+         initialize_account(a);
+         set_account_limits(a, -1, 1, 1);
+      }
+      process_account_limit_updates();
+
+      const uint32_t cpu_window = config::account_cpu_usage_average_window_ms / config::block_interval_ms;
+      const uint32_t net_window = config::account_net_usage_average_window_ms / config::block_interval_ms;
+      usage_accumulator alice_cpu, alice_net, bob_cpu, bob_net;
+
+      add_transaction_usage({alice, bob}, 100, 200, 1);
+      alice_cpu.add(100, 1, cpu_window); alice_net.add(200, 1, net_window);
+      bob_cpu.add(100, 1, cpu_window);   bob_net.add(200, 1, net_window);
+
+      {  // a failed transaction leaves no trace
+         auto s = start_usage_session();
+         update_account_usage({alice}, 2);
+         add_transaction_usage({alice}, 5000, 5000, 2);
+         s.undo();
+      }
+
+      {
+         auto s = start_usage_session();
+         update_account_usage({bob}, 3);
+         add_transaction_usage({bob}, 300, 400, 3);
+         s.squash();
+      }
+      bob_cpu.add(0, 3, cpu_window);   bob_net.add(0, 3, net_window);
+      bob_cpu.add(300, 3, cpu_window); bob_net.add(400, 3, net_window);
+
+      {  // destroying an active session rolls it back as well
+         auto s = start_usage_session();
+         add_transaction_usage({bob}, 700, 700, 4);
+      }
+
+      // nothing has been written to chainbase yet, but every accessor already sees the usage
+      BOOST_REQUIRE_EQUAL(get_usage_object(alice).cpu_usage.value_ex, 0u);
+      BOOST_REQUIRE_EQUAL(get_usage_object(bob).net_usage.value_ex, 0u);
+      BOOST_REQUIRE_EQUAL(get_block_cpu_limit(), config::default_max_block_cpu_usage - 400);
+      BOOST_REQUIRE_EQUAL(get_block_net_limit(), config::default_max_block_net_usage - 600);
+      BOOST_REQUIRE_EQUAL(get_account_cpu_limit_ex(alice).used, (int64_t)((alice_cpu.value_ex * cpu_window + config::rate_limiting_precision - 1) / config::rate_limiting_precision));
+      BOOST_REQUIRE_EQUAL(get_account_net_limit_ex(bob).used, (int64_t)((bob_net.value_ex * net_window + config::rate_limiting_precision - 1) / config::rate_limiting_precision));
+
+      process_block_usage(1);
+
+      const auto check = [](const usage_accumulator& actual, const usage_accumulator& expected) {
+         BOOST_REQUIRE_EQUAL(actual.last_ordinal, expected.last_ordinal);
+         BOOST_REQUIRE_EQUAL(actual.value_ex, expected.value_ex);
+         BOOST_REQUIRE_EQUAL(actual.consumed, expected.consumed);
+      };
+      check(get_usage_object(alice).cpu_usage, alice_cpu);
+      check(get_usage_object(alice).net_usage, alice_net);
+      check(get_usage_object(bob).cpu_usage, bob_cpu);
+      check(get_usage_object(bob).net_usage, bob_net);
+
+      BOOST_REQUIRE_EQUAL(get_block_cpu_limit(), config::default_max_block_cpu_usage);
+      BOOST_REQUIRE_EQUAL(get_block_net_limit(), config::default_max_block_net_usage);
+   } FC_LOG_AND_RETHROW();
+
    BOOST_FIXTURE_TEST_CASE(enforce_account_ram_limit, resource_limits_fixture) try {
       const uint64_t limit = 1000;
       const uint64_t increment = 77;
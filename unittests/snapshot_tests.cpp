@@ -254,4 +254,400 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(test_replay_over_snapshot, SNAPSHOT_SUITE, snapsho
    BOOST_REQUIRE_EQUAL(expected_post_integrity_hash.str(), snap_chain.control->calculate_integrity_hash().str());
 }
 
+BOOST_AUTO_TEST_CASE_TEMPLATE(test_snapshot_sections, SNAPSHOT_SUITE, snapshot_suites)
+{
+   tester chain;
+   const auto& db = chain.control->db();
+   boost::asio::thread_pool pool(2);
+
+   std::vector<std::string> names;
+   for (uint64_t i = 0; i < 6; i++) {
+      names.emplace_back("section." + std::to_string(i));
+   }
+
+   // section i holds i rows, written around a section that is not buffered
+   auto writer = SNAPSHOT_SUITE::get_writer();
+   writer->write_section("first", [&db](auto& section) {
+      section.add_row(uint64_t(42), db);
+   });
+   writer->write_sections(names, [&db](size_t i, auto& section) {
+      for (uint64_t row = 0; row < i; row++) {
+         section.add_row(uint64_t(i * 100 + row), db);
+      }
+   }, pool, 2);
+   writer->write_section("last", [&db](auto& section) {
+      section.add_row(uint64_t(43), db);
+   });
+   auto snapshot = SNAPSHOT_SUITE::finalize(writer);
+
+   auto reader = SNAPSHOT_SUITE::get_reader(snapshot);
+   reader->validate();
+   BOOST_REQUIRE(reader->has_section("last"));
+   BOOST_REQUIRE(!reader->has_section("section.6"));
+
+   uint64_t value = 0;
+   reader->read_section("last", [&value](auto& section) {
+      section.read_row(value);
+   });
+   BOOST_REQUIRE_EQUAL(value, 43u);
+
+   size_t applied = 0;
+   reader->read_sections(names, [](size_t, auto& section) {
+      std::vector<uint64_t> rows;
+      bool more = !section.empty();
+      while (more) {
+         rows.emplace_back();
+         more = section.read_row(rows.back());
+      }
+      return rows;
+   }, [&applied](size_t i, std::vector<uint64_t> rows) {
+      BOOST_REQUIRE_EQUAL(i, applied++);
+      BOOST_REQUIRE_EQUAL(rows.size(), i);
+      for (uint64_t row = 0; row < i; row++) {
+         BOOST_REQUIRE_EQUAL(rows[row], i * 100 + row);
+      }
+   }, pool, 2);
+   BOOST_REQUIRE_EQUAL(applied, names.size());
+
+   reader->read_section("first", [&value](auto& section) {
+      section.read_row(value);
+   });
+   BOOST_REQUIRE_EQUAL(value, 42u);
+}
+
+BOOST_AUTO_TEST_CASE(test_binary_section_stats)
+{
+   tester chain;
+   const auto& db = chain.control->db();
+   boost::asio::thread_pool pool(2);
+
+   auto writer = buffered_snapshot_suite::get_writer();
+   writer->write_section("first", [&db](auto& section) {
+      section.add_row(uint64_t(42), db);
+   });
+   writer->write_sections({"second", "third"}, [&db](size_t i, auto& section) {
+      for (uint64_t row = 0; row <= i; row++) {
+         section.add_row(row, db);
+      }
+   }, pool, 2);
+   buffered_snapshot_suite::finalize(writer);
+
+   // sections are found at their offsets whether serialized in place or buffered
+   const auto& stats = writer->section_stats();
+   BOOST_REQUIRE_EQUAL(stats.size(), 3u);
+   BOOST_REQUIRE_EQUAL(stats[0].name, "first");
+   BOOST_REQUIRE_EQUAL(stats[1].name, "second");
+   BOOST_REQUIRE_EQUAL(stats[2].name, "third");
+   BOOST_REQUIRE_EQUAL(stats[1].rows, 1u);
+   BOOST_REQUIRE_EQUAL(stats[2].rows, 2u);
+   BOOST_REQUIRE_EQUAL(stats[1].offset, stats[0].offset + stats[0].size);
+   BOOST_REQUIRE_EQUAL(stats[2].offset, stats[1].offset + stats[1].size);
+   BOOST_REQUIRE_EQUAL(stats[2].size, 4 * sizeof(uint64_t) + strlen("third") + 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_captured_snapshot)
+{
+   tester chain;
+
+   chain.create_account(N(snapshot));
+   chain.produce_blocks(1);
+   chain.set_code(N(snapshot), snapshot_test_wast);
+   chain.set_abi(N(snapshot), snapshot_test_abi);
+   chain.push_action(N(snapshot), N(increment), N(snapshot), mutable_variant_object()
+      ( "value", 1 )
+   );
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+
+   auto writer = buffered_snapshot_suite::get_writer();
+   chain.control->write_snapshot(writer);
+   auto expected = buffered_snapshot_suite::finalize(writer);
+
+   // capture the state, let the chain move on, then write what was captured
+   auto captured = std::make_shared<buffered_snapshot_writer>();
+   chain.control->write_snapshot(captured);
+   BOOST_REQUIRE_GT(captured->size(), 0u);
+   auto expected_integrity_hash = chain.control->calculate_integrity_hash();
+
+   chain.push_action(N(snapshot), N(increment), N(snapshot), mutable_variant_object()
+      ( "value", 1 )
+   );
+   chain.produce_blocks(1);
+
+   auto captured_writer = buffered_snapshot_suite::get_writer();
+   captured->write_to(*captured_writer);
+   auto snapshot = buffered_snapshot_suite::finalize(captured_writer);
+   BOOST_REQUIRE(snapshot == expected);
+
+   snapshotted_tester snap_chain(chain.get_config(), buffered_snapshot_suite::get_reader(snapshot), 1);
+   BOOST_REQUIRE_EQUAL(expected_integrity_hash.str(), snap_chain.control->calculate_integrity_hash().str());
+}
+
+BOOST_AUTO_TEST_CASE(test_delta_snapshot)
+{
+   tester chain;
+
+   chain.create_account(N(snapshot));
+   chain.produce_blocks(1);
+   chain.set_code(N(snapshot), snapshot_test_wast);
+   chain.set_abi(N(snapshot), snapshot_test_abi);
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+
+   auto base_writer = buffered_snapshot_suite::get_writer();
+   chain.control->write_snapshot(base_writer);
+   auto base = buffered_snapshot_suite::finalize(base_writer);
+
+   chain.push_action(N(snapshot), N(increment), N(snapshot), mutable_variant_object()
+      ( "value", 1 )
+   );
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+
+   auto full_writer = buffered_snapshot_suite::get_writer();
+   chain.control->write_snapshot(full_writer);
+   auto full = buffered_snapshot_suite::finalize(full_writer);
+
+   std::ostringstream delta_out;
+   auto delta_writer = std::make_shared<delta_snapshot_writer>(buffered_snapshot_suite::get_reader(base), delta_out);
+   chain.control->write_snapshot(delta_writer);
+   delta_writer->finalize();
+   auto delta = delta_out.str();
+
+   // most of the state did not change and is copied from the base
+   BOOST_REQUIRE_GT(delta_writer->copied_rows(), delta_writer->inserted_rows());
+   BOOST_REQUIRE_LT(delta.size(), full.size());
+
+   std::istringstream delta_in(delta);
+   auto reader = std::make_shared<delta_snapshot_reader>(buffered_snapshot_suite::get_reader(base), delta_in);
+   reader->validate();
+   snapshotted_tester snap_chain(chain.get_config(), reader, 1);
+   BOOST_REQUIRE_EQUAL(chain.control->calculate_integrity_hash().str(), snap_chain.control->calculate_integrity_hash().str());
+
+   // a delta only applies to the state it was taken against
+   std::istringstream wrong_delta_in(delta);
+   auto wrong_base = std::make_shared<delta_snapshot_reader>(buffered_snapshot_suite::get_reader(full), wrong_delta_in);
+   BOOST_REQUIRE_THROW(wrong_base->validate(), snapshot_exception);
+
+   // nor does a delta whose rows no longer rebuild the state it claims
+   auto corrupted = delta;
+   corrupted[corrupted.size() / 2] ^= 0x5a;
+   std::istringstream corrupted_in(corrupted);
+   auto corrupted_reader = std::make_shared<delta_snapshot_reader>(buffered_snapshot_suite::get_reader(base), corrupted_in);
+   BOOST_REQUIRE_THROW(corrupted_reader->validate(), snapshot_exception);
+
+   // deltas stack, each layer applying to the state of the one below it
+   chain.push_action(N(snapshot), N(increment), N(snapshot), mutable_variant_object()
+      ( "value", 1 )
+   );
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+
+   std::istringstream first_in(delta);
+   std::ostringstream second_out;
+   auto second_writer = std::make_shared<delta_snapshot_writer>(
+      std::make_shared<delta_snapshot_reader>(buffered_snapshot_suite::get_reader(base), first_in), second_out);
+   chain.control->write_snapshot(second_writer);
+   second_writer->finalize();
+   auto second = second_out.str();
+
+   std::istringstream first_again_in(delta), second_in(second);
+   auto stacked = std::make_shared<delta_snapshot_reader>(
+      std::make_shared<delta_snapshot_reader>(buffered_snapshot_suite::get_reader(base), first_again_in), second_in);
+   stacked->validate();
+   snapshotted_tester stacked_chain(chain.get_config(), stacked, 2);
+   BOOST_REQUIRE_EQUAL(chain.control->calculate_integrity_hash().str(), stacked_chain.control->calculate_integrity_hash().str());
+
+   // skipping a layer breaks the chain of states
+   std::istringstream skipped_in(second);
+   auto skipped = std::make_shared<delta_snapshot_reader>(buffered_snapshot_suite::get_reader(base), skipped_in);
+   BOOST_REQUIRE_THROW(skipped->validate(), snapshot_exception);
+}
+
+BOOST_AUTO_TEST_CASE(test_delta_snapshot_moved_rows)
+{
+   tester chain;
+   const auto& db = chain.control->db();
+
+   auto write_numbered = [&db]( const snapshot_writer_ptr& writer, const std::vector<std::vector<uint64_t>>& sections ) {
+      for (size_t i = 0; i < sections.size(); ++i) {
+         writer->write_section("rows." + std::to_string(i), [&]( auto& section ) {
+            for (auto v : sections[i])
+               section.add_row(v, db);
+         });
+      }
+   };
+
+   std::vector<uint64_t> first, second, third;
+   for (uint64_t v = 0; v < 100; ++v)
+      (v < 50 ? first : second).push_back(v);
+   auto base_writer = buffered_snapshot_suite::get_writer();
+   write_numbered(base_writer, {first, second});
+   auto base = buffered_snapshot_suite::finalize(base_writer);
+
+   // the boundary between the sections moves and a new section takes over the tail, as with contract table shards
+   std::vector<std::vector<uint64_t>> moved = {
+      std::vector<uint64_t>(first.begin(), first.begin() + 40),
+      std::vector<uint64_t>(first.begin() + 40, first.end()),
+      second
+   };
+   moved[1].insert(moved[1].end(), second.begin(), second.begin() + 20);
+   moved[2].erase(moved[2].begin(), moved[2].begin() + 20);
+
+   // every row is copied from the base and read back in the section it moved to
+   auto check_delta = [&]( const std::string& base, const std::vector<std::vector<uint64_t>>& sections, uint64_t rows ) {
+      std::ostringstream delta_out;
+      auto delta_writer = std::make_shared<delta_snapshot_writer>(buffered_snapshot_suite::get_reader(base), delta_out);
+      write_numbered(delta_writer, sections);
+      delta_writer->finalize();
+      BOOST_REQUIRE_EQUAL(delta_writer->inserted_rows(), 0u);
+      BOOST_REQUIRE_EQUAL(delta_writer->copied_rows(), rows);
+
+      std::istringstream delta_in(delta_out.str());
+      auto reader = std::make_shared<delta_snapshot_reader>(buffered_snapshot_suite::get_reader(base), delta_in);
+      reader->validate();
+      for (size_t i = 0; i < sections.size(); ++i) {
+         std::vector<uint64_t> read;
+         reader->read_section("rows." + std::to_string(i), [&read]( auto& section ) {
+            bool more = !section.empty();
+            while (more) {
+               read.emplace_back();
+               more = section.read_row(read.back());
+            }
+         });
+         BOOST_REQUIRE(read == sections[i]);
+      }
+   };
+
+   check_delta(base, moved, 100);
+
+   // dropping the head of the state shifts every row several sections down
+   std::vector<std::vector<uint64_t>> five(5);
+   for (uint64_t v = 0; v < 100; ++v)
+      five[v / 20].push_back(v);
+   auto five_writer = buffered_snapshot_suite::get_writer();
+   write_numbered(five_writer, five);
+   auto five_base = buffered_snapshot_suite::finalize(five_writer);
+
+   std::vector<std::vector<uint64_t>> shifted(3);
+   for (uint64_t v = 50; v < 100; ++v)
+      shifted[(v - 50) / 20].push_back(v);
+   check_delta(five_base, shifted, 50);
+}
+
+BOOST_AUTO_TEST_CASE(test_integrity_tree_hash)
+{
+   tester chain;
+
+   chain.create_account(N(snapshot));
+   chain.produce_blocks(1);
+   chain.set_code(N(snapshot), snapshot_test_wast);
+   chain.set_abi(N(snapshot), snapshot_test_abi);
+   chain.push_action(N(snapshot), N(increment), N(snapshot), mutable_variant_object()
+      ( "value", 1 )
+   );
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+
+   auto tree_hash = chain.control->calculate_integrity_hash(2);
+   BOOST_REQUIRE_EQUAL(tree_hash.str(), chain.control->calculate_integrity_hash(2).str());
+   BOOST_REQUIRE_NE(tree_hash.str(), chain.control->calculate_integrity_hash(1).str());
+   BOOST_REQUIRE_THROW(chain.control->calculate_integrity_hash(3), unsupported_feature);
+
+   // a node restored from a snapshot arrives at the same hash
+   auto writer = buffered_snapshot_suite::get_writer();
+   chain.control->write_snapshot(writer);
+   auto snapshot = buffered_snapshot_suite::finalize(writer);
+   snapshotted_tester snap_chain(chain.get_config(), buffered_snapshot_suite::get_reader(snapshot), 1);
+   BOOST_REQUIRE_EQUAL(tree_hash.str(), snap_chain.control->calculate_integrity_hash(2).str());
+
+   // and any change to the state changes it
+   chain.push_action(N(snapshot), N(increment), N(snapshot), mutable_variant_object()
+      ( "value", 1 )
+   );
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+   BOOST_REQUIRE_NE(tree_hash.str(), chain.control->calculate_integrity_hash(2).str());
+}
+
+BOOST_AUTO_TEST_CASE(test_index_snapshot_parts)
+{
+   tester chain;
+   chain.create_accounts({N(parts1), N(parts2), N(parts3)});
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+
+   const auto& db = chain.control->db();
+   const uint64_t accounts = db.get_index<account_index>().indices().size();
+   const auto section_name = detail::snapshot_section_traits<account_object>::section_name();
+
+   // section names and the rows of all sections, in order
+   auto write_parts = [&db]( uint64_t rows_per_part ) {
+      std::vector<snapshot_part> parts;
+      add_index_snapshot_parts<index_utils<account_index>>(db, rows_per_part, parts);
+
+      fc::mutable_variant_object snapshot;
+      auto writer = std::make_shared<variant_snapshot_writer>(snapshot);
+      for (const auto& part : parts)
+         part(writer);
+      writer->finalize();
+
+      std::vector<std::string> names;
+      fc::variants rows;
+      for (const auto& section : snapshot["sections"].get_array()) {
+         names.emplace_back(section["name"].as_string());
+         for (const auto& row : section["rows"].get_array())
+            rows.emplace_back(row);
+      }
+      return std::make_pair(names, rows);
+   };
+
+   const auto whole = write_parts(accounts);
+   BOOST_REQUIRE_EQUAL(whole.first.size(), 1u);
+   BOOST_REQUIRE_EQUAL(whole.first[0], section_name);
+   BOOST_REQUIRE_EQUAL(whole.second.size(), accounts);
+
+   // a large index is cut into numbered sections holding the same rows in the same order
+   const auto split = write_parts(2);
+   BOOST_REQUIRE_EQUAL(split.first.size(), (accounts + 1) / 2);
+   BOOST_REQUIRE_EQUAL(split.first.front(), section_name + ".0");
+   BOOST_REQUIRE_EQUAL(fc::json::to_string(split.second), fc::json::to_string(whole.second));
+}
+
+BOOST_AUTO_TEST_CASE(test_version_1_binary_snapshot)
+{
+   // a version 1 binary snapshot has no section directory and is scanned instead
+   std::ostringstream out;
+   auto write_u64 = [&out](uint64_t v) { out.write((const char*)&v, sizeof(v)); };
+   uint32_t magic = ostream_snapshot_writer::magic_number;
+   uint32_t version = 1;
+   out.write((const char*)&magic, sizeof(magic));
+   out.write((const char*)&version, sizeof(version));
+   for (uint64_t value : {7u, 8u}) {
+      std::string name = "section." + std::to_string(value);
+      write_u64(sizeof(uint64_t) + name.size() + 1 + sizeof(value));
+      write_u64(1);
+      out.write(name.c_str(), name.size() + 1);
+      write_u64(value);
+   }
+   write_u64(std::numeric_limits<uint64_t>::max());
+
+   auto reader = buffered_snapshot_suite::get_reader(out.str());
+   reader->validate();
+   BOOST_REQUIRE(reader->has_section("section.7"));
+   BOOST_REQUIRE(!reader->has_section("section.9"));
+
+   uint64_t value = 0;
+   reader->read_section("section.8", [&value](auto& section) {
+      section.read_row(value);
+   });
+   BOOST_REQUIRE_EQUAL(value, 8u);
+
+   // the same bytes claiming version 2 lack the directory that version requires
+   version = 2;
+   auto v2 = out.str();
+   memcpy(&v2[sizeof(magic)], &version, sizeof(version));
+   BOOST_REQUIRE_THROW(buffered_snapshot_suite::get_reader(v2)->validate(), snapshot_exception);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
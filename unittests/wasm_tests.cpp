@@ -27,6 +27,7 @@
 #include "test_softfloat_wasts.hpp"
 
 #include <array>
+#include <fstream>
 #include <utility>
 
 #include "incbin.h"
@@ -161,6 +162,84 @@ BOOST_FIXTURE_TEST_CASE( prove_mem_reset, TESTER ) try {
 
 } FC_LOG_AND_RETHROW() /// prove_mem_reset
 
+/**
+ * Prove the instantiation cache evicts the least recently used module and contracts still execute correctly
+ * after their module was evicted
+ */
+BOOST_AUTO_TEST_CASE( wasm_cache_eviction ) try {
+   tester chain;
+   chain.close();
+   auto cfg = chain.get_config();
+   cfg.wasm_cache_max_modules = 2;
+   chain.init(cfg);
+
+   chain.create_accounts( {N(asserter), N(noop), N(grower)} );
+   chain.produce_block();
+   chain.set_code(N(asserter), asserter_wast);
+   chain.set_code(N(noop), noop_wast);
+   chain.set_code(N(grower), memory_growth_memset_test);
+   chain.produce_block();
+
+   auto code_id = [&]( account_name a ) { return chain.control->get_account(a).code_version; };
+   auto run = [&]( account_name a ) {
+      signed_transaction trx;
+      if( a == N(asserter) )
+         trx.actions.emplace_back( vector<permission_level>{{a,config::active_name}}, provereset {} );
+      else
+         trx.actions.emplace_back( vector<permission_level>{{a,config::active_name}}, a, N(anyaction), bytes{} );
+      chain.set_transaction_headers(trx);
+      trx.sign( chain.get_private_key( a, "active" ), chain.control->get_chain_id() );
+      auto result = chain.push_transaction( trx );
+      BOOST_CHECK_EQUAL(result->receipt->status, transaction_receipt::executed);
+      chain.produce_block();
+   };
+   const auto& wasmif = chain.control->get_wasm_interface();
+
+   run( N(asserter) );
+   run( N(noop) );
+   BOOST_CHECK( wasmif.cached_modules() == vector<digest_type>({code_id(N(asserter)), code_id(N(noop))}) );
+
+   // a hit moves asserter to the back, so noop is the one evicted for grower
+   run( N(asserter) );
+   run( N(grower) );
+   BOOST_CHECK( wasmif.cached_modules() == vector<digest_type>({code_id(N(asserter)), code_id(N(grower))}) );
+
+   // noop is instantiated again and takes the place of asserter
+   run( N(noop) );
+   BOOST_CHECK( wasmif.cached_modules() == vector<digest_type>({code_id(N(grower)), code_id(N(noop))}) );
+
+   const auto stats = wasmif.get_cache_stats();
+   BOOST_CHECK_EQUAL(stats.modules, 2u);
+   BOOST_CHECK_EQUAL(stats.hits, 1u);
+   BOOST_CHECK_EQUAL(stats.misses, 4u);
+   BOOST_CHECK_EQUAL(stats.evictions, 2u);
+
+} FC_LOG_AND_RETHROW() /// wasm_cache_eviction
+
+/**
+ * Prove newly deployed code is prepared in the background before its first execution
+ */
+BOOST_FIXTURE_TEST_CASE( wasm_background_preparation, TESTER ) try {
+   create_accounts( {N(noop)} );
+   produce_block();
+   set_code(N(noop), noop_wast);
+   produce_block();
+
+   signed_transaction trx;
+   trx.actions.emplace_back( vector<permission_level>{{N(noop),config::active_name}},
+                             N(noop), N(anyaction), fc::raw::pack(string("first run")) );
+   set_transaction_headers(trx);
+   trx.sign( get_private_key( N(noop), "active" ), control->get_chain_id() );
+   push_transaction( trx );
+   produce_block();
+
+   const auto stats = control->get_wasm_interface().get_cache_stats();
+   BOOST_CHECK_GE(stats.prepared_ahead, 1u);
+   BOOST_CHECK_GE(stats.background_prepares, stats.prepared_ahead);
+   BOOST_CHECK_LE(stats.prepare_waits, stats.prepared_ahead);
+
+} FC_LOG_AND_RETHROW() /// wasm_background_preparation
+
 /**
  * Prove the modifications to global variables are wiped between runs
  */
@@ -1631,6 +1710,45 @@ BOOST_FIXTURE_TEST_CASE( mem_growth_memset, TESTER ) try {
    }
 } FC_LOG_AND_RETHROW()
 
+/**
+ * Prove the initial memory image is restored for every action and never leaks into another module's memory,
+ * and report the action rate of a contract with a large initial memory image (run with --log_level=message)
+ */
+BOOST_FIXTURE_TEST_CASE( memory_image_reset, TESTER ) try {
+   produce_blocks(2);
+
+   create_accounts( {N(imager), N(grower)} );
+   produce_block();
+
+   set_code(N(imager), memory_image_reset_wast);
+   set_code(N(grower), memory_growth_memset_test);
+   produce_blocks(1);
+
+   const uint32_t trx_count = 100;
+   const uint32_t actions_per_trx = 20;
+   auto start = fc::time_point::now();
+   for( uint32_t i = 0; i < trx_count; ++i ) {
+      signed_transaction trx;
+      for( uint32_t j = 0; j < actions_per_trx; ++j ) {
+         trx.actions.emplace_back( vector<permission_level>{{N(imager),config::active_name}},
+                                   N(imager), N(), fc::raw::pack(i * actions_per_trx + j) );
+      }
+      // runs on the same linear memory right after the image was mapped
+      trx.actions.emplace_back( vector<permission_level>{{N(grower),config::active_name}},
+                                N(grower), N(), bytes{} );
+      set_transaction_headers(trx);
+      trx.sign( get_private_key( N(imager), "active" ), control->get_chain_id() );
+      trx.sign( get_private_key( N(grower), "active" ), control->get_chain_id() );
+      push_transaction( trx );
+      if( i % 10 == 9 )
+         produce_block();
+   }
+   auto elapsed = fc::time_point::now() - start;
+   BOOST_TEST_MESSAGE( "memory_image_reset: " << (trx_count * (actions_per_trx + 1) * 1000000.0 / elapsed.count()) << " actions/s" );
+
+   produce_block();
+} FC_LOG_AND_RETHROW()
+
 INCBIN(fuzz1, "fuzz1.wasm");
 INCBIN(fuzz2, "fuzz2.wasm");
 INCBIN(fuzz3, "fuzz3.wasm");